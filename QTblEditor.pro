@@ -11,10 +11,19 @@ greaterThan(QT_MAJOR_VERSION, 4): {
     DEFINES += IS_QT5
     IS_QT5 = 1
 
-    QT += widgets
+    QT += widgets concurrent
     *-clang*: cache()
 }
 
+# compressed tables use the same zlib as Qt: system one or the copy bundled into QtCore
+contains(QT_CONFIG, system-zlib): {
+    unix: LIBS += -lz
+    else: LIBS += -lzlib
+} else {
+    greaterThan(QT_MAJOR_VERSION, 4): DEFINES += QTBLEDITOR_QT_ZLIB
+    else: INCLUDEPATH += $$[QT_INSTALL_PREFIX]/src/3rdparty/zlib
+}
+
 CONFIG(release, debug|release): {
     IS_RELEASE_BUILD = 1
     DEFINES += QT_NO_DEBUG_OUTPUT \
@@ -30,7 +39,28 @@ HEADERS += editstringcell.h \
            gotorowdialog.h \
            tablepanelwidget.h \
            d2stringtablewidget.h \
+           d2stringtabledelegate.h \
+           tableedithistory.h \
+           rowheaderview.h \
+           tablemimedata.h \
+           coloredtext.h \
+           tablefile.h \
+           texttablecache.h \
+           gzipdevice.h \
+           mpqarchive.h \
+           batchreplace.h \
+           batchreplacedialog.h \
+           tablekeyindex.h \
+           tablelint.h \
+           tablerowview.h \
+           stringpool.h \
+           tableuploader.h \
+           selftests.h \
+           tablejournal.h \
+           timing.h \
+           tableviewstatestore.h \
            tablesdifferenceswidget.h \
+           hashcollisionswidget.h \
            editcolorsdialog.h \
            editorssplitterhandle.h
 
@@ -38,9 +68,11 @@ FORMS += editstringcell.ui \
          qtbleditor.ui \
          editstringcelldialog.ui \
          findreplacedialog.ui \
+         batchreplacedialog.ui \
          gotorowdialog.ui \
          tablepanelwidget.ui \
          tablesdifferenceswidget.ui \
+         hashcollisionswidget.ui \
          editcolorsdialog.ui
 
 SOURCES += editstringcell.cpp \
@@ -52,7 +84,28 @@ SOURCES += editstringcell.cpp \
            gotorowdialog.cpp \
            tablepanelwidget.cpp \
            d2stringtablewidget.cpp \
+           d2stringtabledelegate.cpp \
+           tableedithistory.cpp \
+           rowheaderview.cpp \
+           tablemimedata.cpp \
+           coloredtext.cpp \
+           tablefile.cpp \
+           texttablecache.cpp \
+           gzipdevice.cpp \
+           mpqarchive.cpp \
+           batchreplace.cpp \
+           batchreplacedialog.cpp \
+           tablekeyindex.cpp \
+           tablelint.cpp \
+           tablerowview.cpp \
+           stringpool.cpp \
+           tableuploader.cpp \
+           selftests.cpp \
+           tablejournal.cpp \
+           timing.cpp \
+           tableviewstatestore.cpp \
            tablesdifferenceswidget.cpp \
+           hashcollisionswidget.cpp \
            editcolorsdialog.cpp \
            colors.cpp \
            editorssplitterhandle.cpp
@@ -0,0 +1,182 @@
+#include "batchreplace.h"
+#include "mpqarchive.h"
+#include "timing.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QDir>
+#include <QRegExp>
+#include <QtConcurrentMap>
+
+
+// exact match of a regular expression means the whole text, so it's anchored instead of checked separately
+static QRegExp specRegExp(const BatchReplaceSpec &spec)
+{
+    QString pattern = spec.IsExactMatch ? QString("^(?:%1)$").arg(spec.Query) : spec.Query;
+    return QRegExp(pattern, spec.IsCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+}
+
+QFuture<BatchReplaceResult> BatchReplace::start(const QStringList &fileNames, const BatchReplaceSpec &spec)
+{
+    return QtConcurrent::mapped(fileNames, BatchReplace(spec));
+}
+
+bool BatchReplace::isSpecValid(const BatchReplaceSpec &spec, QString *errorString)
+{
+    if (spec.Query.isEmpty())
+    {
+        *errorString = QCoreApplication::translate("BatchReplace", "Nothing to find");
+        return false;
+    }
+    QRegExp regExp = specRegExp(spec);
+    if (spec.IsRegExp && !regExp.isValid())
+    {
+        *errorString = QCoreApplication::translate("BatchReplace", "Wrong regular expression: %1").arg(regExp.errorString());
+        return false;
+    }
+    return true;
+}
+
+BatchReplaceResult BatchReplace::operator()(const QString &fileName) const
+{
+    TimingSpan span("replace in file");
+    BatchReplaceResult result;
+    result.FileName = fileName;
+
+    // found out before reading, there's no sense in showing the changes that can't be saved
+    QString archiveFileName, archivedFileName, extension = tableFileExtension(fileName);
+    if (MpqArchive::splitPath(fileName, &archiveFileName, &archivedFileName))
+    {
+        result.ErrorString = QCoreApplication::translate("BatchReplace", "Tables in MPQ archives are read-only");
+        return result;
+    }
+    if (extension != ".tbl" && extension != ".txt" && extension != ".csv")
+    {
+        result.ErrorString = QCoreApplication::translate("BatchReplace", "Format can't be determined by extension");
+        return result;
+    }
+    result.IsRead = readTableFile(fileName, &result.Entries, &result.ErrorString);
+    if (!result.IsRead)
+        return result;
+
+    QRegExp regExp = specRegExp(_spec); // every thread needs its own copy
+    for (int i = 0; i < result.Entries.size(); i++)
+    {
+        KeyValuePair &entry = result.Entries[i];
+        int occurrencesCount = replaceIn(_spec.IsInKeys ? &entry.first : &entry.second, &regExp);
+        if (occurrencesCount)
+        {
+            result.ChangedRowsCount++;
+            result.OccurrencesCount += occurrencesCount;
+        }
+    }
+    if (!result.ChangedRowsCount)
+        result.Entries.clear(); // there will be many results in memory at once
+    return result;
+}
+
+int BatchReplace::replaceIn(QString *text, QRegExp *regExp) const
+{
+    if (_spec.IsRegExp)
+    {
+        int occurrencesCount = 0;
+        for (int position = 0; (position = regExp->indexIn(*text, position)) != -1; occurrencesCount++)
+            position += qMax(regExp->matchedLength(), 1);
+        if (occurrencesCount)
+            text->replace(*regExp, _spec.Replacement);
+        return occurrencesCount;
+    }
+
+    Qt::CaseSensitivity cs = _spec.IsCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (_spec.IsExactMatch)
+    {
+        if (text->compare(_spec.Query, cs))
+            return 0;
+        *text = _spec.Replacement;
+        return 1;
+    }
+    int occurrencesCount = text->count(_spec.Query, cs);
+    if (occurrencesCount)
+        text->replace(_spec.Query, _spec.Replacement, cs);
+    return occurrencesCount;
+}
+
+bool BatchReplace::writeResults(const QList<BatchReplaceResult> &results, const TableFormatOptions &options, QString *errorString)
+{
+    TimingSpan span("write replaced files");
+    QStringList fileNames, temporaryFileNames;
+    bool areWritten = true;
+    foreach (const BatchReplaceResult &result, results)
+    {
+        if (!result.IsRead || !result.ChangedRowsCount)
+            continue;
+
+        QFileInfo info(result.FileName);
+        QString temporaryFileName = info.absolutePath() + "/.~" + info.fileName(); // keeps the extension that defines the format
+        QByteArray bytes;
+        temporaryFileNames += temporaryFileName;
+        fileNames += result.FileName;
+        if (!tableFileBytes(result.Entries, result.FileName, options, &bytes, errorString) || !writeTableFile(temporaryFileName, bytes, errorString))
+        {
+            areWritten = false;
+            break;
+        }
+    }
+    if (!areWritten)
+    {
+        foreach (const QString &temporaryFileName, temporaryFileNames)
+            QFile::remove(temporaryFileName);
+        return false;
+    }
+
+    // originals are moved aside and deleted only when all new files are in place, so any failure is rolled back
+    QStringList backupFileNames;
+    foreach (const QString &fileName, fileNames)
+    {
+        QFileInfo info(fileName);
+        backupFileNames += info.absolutePath() + "/.~backup." + info.fileName();
+    }
+
+    int movedCount = 0, replacedCount = 0, n = fileNames.size();
+    for (; movedCount < n; movedCount++)
+    {
+        QFile::remove(backupFileNames.at(movedCount)); // left after a crash, rename doesn't overwrite
+        if (!QFile::rename(fileNames.at(movedCount), backupFileNames.at(movedCount)))
+        {
+            *errorString = QCoreApplication::translate("BatchReplace", "Couldn't move file \"%1\" to \"%2\"")
+                           .arg(QDir::toNativeSeparators(fileNames.at(movedCount)), QDir::toNativeSeparators(backupFileNames.at(movedCount)));
+            areWritten = false;
+            break;
+        }
+    }
+    for (; areWritten && replacedCount < n; replacedCount++)
+    {
+        if (!QFile::rename(temporaryFileNames.at(replacedCount), fileNames.at(replacedCount)))
+        {
+            *errorString = QCoreApplication::translate("BatchReplace", "Couldn't move file \"%1\" to \"%2\"")
+                           .arg(QDir::toNativeSeparators(temporaryFileNames.at(replacedCount)), QDir::toNativeSeparators(fileNames.at(replacedCount)));
+            areWritten = false;
+            break;
+        }
+    }
+
+    if (areWritten)
+    {
+        foreach (const QString &backupFileName, backupFileNames)
+            QFile::remove(backupFileName);
+        return true;
+    }
+
+    // rollback in reverse order: new files are deleted and originals get their names back
+    for (int i = replacedCount - 1; i >= 0; i--)
+        QFile::remove(fileNames.at(i));
+    for (int i = movedCount - 1; i >= 0; i--)
+    {
+        if (!QFile::rename(backupFileNames.at(i), fileNames.at(i)))
+            *errorString += "\n" + QCoreApplication::translate("BatchReplace", "Original contents of \"%1\" are in \"%2\"")
+                                    .arg(QDir::toNativeSeparators(fileNames.at(i)), QDir::toNativeSeparators(backupFileNames.at(i)));
+    }
+    foreach (const QString &temporaryFileName, temporaryFileNames)
+        QFile::remove(temporaryFileName);
+    return false;
+}
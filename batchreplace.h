@@ -0,0 +1,52 @@
+#ifndef BATCHREPLACE_H
+#define BATCHREPLACE_H
+
+#include "tablefile.h"
+
+#include <QStringList>
+#include <QFuture>
+
+
+class QRegExp;
+
+// the same find/replace as in FindReplaceDialog, but over whole files that aren't opened
+struct BatchReplaceSpec
+{
+    QString Query, Replacement;
+    bool IsRegExp, IsCaseSensitive, IsExactMatch, IsInKeys; // values are changed unless IsInKeys
+
+    BatchReplaceSpec() : IsRegExp(false), IsCaseSensitive(false), IsExactMatch(false), IsInKeys(false) {}
+};
+
+struct BatchReplaceResult
+{
+    QString FileName, ErrorString;
+    KeyValuePairList Entries; // with replacements, empty if nothing was changed
+    int ChangedRowsCount, OccurrencesCount;
+    bool IsRead;
+
+    BatchReplaceResult() : ChangedRowsCount(0), OccurrencesCount(0), IsRead(false) {}
+};
+
+// files are read and changed in memory on the thread pool, so the results are a dry run that can be written afterwards
+class BatchReplace
+{
+public:
+    typedef BatchReplaceResult result_type; // for QtConcurrent
+
+    explicit BatchReplace(const BatchReplaceSpec &spec) : _spec(spec) {}
+    BatchReplaceResult operator()(const QString &fileName) const;
+
+    static QFuture<BatchReplaceResult> start(const QStringList &fileNames, const BatchReplaceSpec &spec);
+    static bool isSpecValid(const BatchReplaceSpec &spec, QString *errorString);
+    // new contents go to temporary files first and replace the originals only if all of them were written.
+    // Either all files are replaced or, if anything fails, all originals are restored
+    static bool writeResults(const QList<BatchReplaceResult> &results, const TableFormatOptions &options, QString *errorString);
+
+private:
+    BatchReplaceSpec _spec;
+
+    int replaceIn(QString *text, QRegExp *regExp) const; // returns number of occurrences
+};
+
+#endif // BATCHREPLACE_H
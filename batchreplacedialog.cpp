@@ -0,0 +1,207 @@
+#include "batchreplacedialog.h"
+
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QCloseEvent>
+#include <QSettings>
+#include <QDir>
+#include <QFileInfo>
+
+
+BatchReplaceDialog::BatchReplaceDialog(QWidget *parent, const QStringList &openedFileNames, const QString &lastPath) : QDialog(parent),
+    _openedFileNames(openedFileNames), _lastPath(lastPath), _previewWatcher(new QFutureWatcher<BatchReplaceResult>(this))
+{
+    ui.setupUi(this);
+    setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
+    setAttribute(Qt::WA_DeleteOnClose);
+    ui.addOpenedButton->setEnabled(!_openedFileNames.isEmpty());
+    ui.progressBar->hide();
+
+    connect(ui.addFilesButton, SIGNAL(clicked()), SLOT(addFiles()));
+    connect(ui.addOpenedButton, SIGNAL(clicked()), SLOT(addOpenedFiles()));
+    connect(ui.removeFilesButton, SIGNAL(clicked()), SLOT(removeFiles()));
+    connect(ui.previewButton, SIGNAL(clicked()), SLOT(preview()));
+    connect(ui.replaceButton, SIGNAL(clicked()), SLOT(replace()));
+
+    // any change makes the preview obsolete
+    connect(ui.findLineEdit, SIGNAL(textChanged(QString)), SLOT(invalidatePreview()));
+    connect(ui.replaceLineEdit, SIGNAL(textChanged(QString)), SLOT(invalidatePreview()));
+    connect(ui.caseSensitiveCheckBox, SIGNAL(toggled(bool)), SLOT(invalidatePreview()));
+    connect(ui.exactMatchCheckBox, SIGNAL(toggled(bool)), SLOT(invalidatePreview()));
+    connect(ui.regExpCheckBox, SIGNAL(toggled(bool)), SLOT(invalidatePreview()));
+    connect(ui.columnComboBox, SIGNAL(currentIndexChanged(int)), SLOT(invalidatePreview()));
+
+    connect(_previewWatcher, SIGNAL(progressRangeChanged(int, int)), ui.progressBar, SLOT(setRange(int, int)));
+    connect(_previewWatcher, SIGNAL(progressValueChanged(int)), ui.progressBar, SLOT(setValue(int)));
+    connect(_previewWatcher, SIGNAL(finished()), SLOT(previewFinished()));
+
+    readSettings();
+}
+
+void BatchReplaceDialog::readSettings()
+{
+    QSettings s;
+    s.beginGroup("batchReplaceDialog");
+    addFileNames(s.value("fileNames").toStringList());
+    ui.findLineEdit->setText(s.value("lastFindString").toString());
+    ui.replaceLineEdit->setText(s.value("lastReplaceString").toString());
+    ui.caseSensitiveCheckBox->setChecked(s.value("isCaseSensitive").toBool());
+    ui.exactMatchCheckBox->setChecked(s.value("isExactMatch").toBool());
+    ui.regExpCheckBox->setChecked(s.value("isRegExp").toBool());
+    ui.columnComboBox->setCurrentIndex(s.value("isInKeys").toBool() ? 1 : 0);
+    s.endGroup();
+}
+
+void BatchReplaceDialog::writeSettings()
+{
+    QSettings s;
+    s.beginGroup("batchReplaceDialog");
+    s.setValue("fileNames", fileNames());
+    s.setValue("lastFindString", ui.findLineEdit->text());
+    s.setValue("lastReplaceString", ui.replaceLineEdit->text());
+    s.setValue("isCaseSensitive", ui.caseSensitiveCheckBox->isChecked());
+    s.setValue("isExactMatch", ui.exactMatchCheckBox->isChecked());
+    s.setValue("isRegExp", ui.regExpCheckBox->isChecked());
+    s.setValue("isInKeys", ui.columnComboBox->currentIndex() == 1);
+    s.endGroup();
+}
+
+void BatchReplaceDialog::closeEvent(QCloseEvent *e)
+{
+    _previewWatcher->cancel();
+    _previewWatcher->waitForFinished();
+    writeSettings();
+    e->accept();
+}
+
+BatchReplaceSpec BatchReplaceDialog::spec() const
+{
+    BatchReplaceSpec spec;
+    spec.Query = ui.findLineEdit->text();
+    spec.Replacement = ui.replaceLineEdit->text();
+    spec.IsCaseSensitive = ui.caseSensitiveCheckBox->isChecked();
+    spec.IsExactMatch = ui.exactMatchCheckBox->isChecked();
+    spec.IsRegExp = ui.regExpCheckBox->isChecked();
+    spec.IsInKeys = ui.columnComboBox->currentIndex() == 1;
+    return spec;
+}
+
+QStringList BatchReplaceDialog::fileNames() const
+{
+    QStringList fileNames;
+    for (int i = 0; i < ui.filesListWidget->count(); i++)
+        fileNames += QDir::fromNativeSeparators(ui.filesListWidget->item(i)->text());
+    return fileNames;
+}
+
+void BatchReplaceDialog::addFileNames(const QStringList &fileNames)
+{
+    QStringList existingFileNames = this->fileNames();
+    foreach (const QString &fileName, fileNames)
+        if (!existingFileNames.contains(fileName))
+            ui.filesListWidget->addItem(QDir::toNativeSeparators(fileName));
+    invalidatePreview();
+}
+
+void BatchReplaceDialog::addFiles()
+{
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, tr("Add tables"), _lastPath,
+        tr("All supported formats (*.tbl *.txt *.csv *.tbl.gz *.txt.gz *.csv.gz);;All files (*)"));
+    if (!fileNames.isEmpty())
+    {
+        _lastPath = QFileInfo(fileNames.at(0)).absolutePath();
+        addFileNames(fileNames);
+    }
+}
+
+void BatchReplaceDialog::addOpenedFiles()
+{
+    addFileNames(_openedFileNames);
+}
+
+void BatchReplaceDialog::removeFiles()
+{
+    qDeleteAll(ui.filesListWidget->selectedItems());
+    invalidatePreview();
+}
+
+void BatchReplaceDialog::invalidatePreview()
+{
+    _previewWatcher->cancel();
+    _results.clear();
+    ui.previewTreeWidget->clear();
+    ui.replaceButton->setEnabled(false);
+}
+
+void BatchReplaceDialog::preview()
+{
+    QString errorString;
+    BatchReplaceSpec spec = this->spec();
+    if (!BatchReplace::isSpecValid(spec, &errorString))
+    {
+        QMessageBox::warning(this, windowTitle(), errorString);
+        return;
+    }
+    QStringList fileNames = this->fileNames();
+    if (fileNames.isEmpty())
+        return;
+
+    invalidatePreview();
+    _previewWatcher->waitForFinished(); // a cancelled preview can still be running
+    ui.previewButton->setEnabled(false);
+    ui.progressBar->show();
+    _previewWatcher->setFuture(BatchReplace::start(fileNames, spec));
+}
+
+void BatchReplaceDialog::previewFinished()
+{
+    ui.previewButton->setEnabled(true);
+    ui.progressBar->hide();
+    if (_previewWatcher->isCanceled())
+        return;
+
+    _results = _previewWatcher->future().results();
+    int changedFilesCount = 0;
+    foreach (const BatchReplaceResult &result, _results)
+    {
+        QTreeWidgetItem *item = new QTreeWidgetItem(ui.previewTreeWidget);
+        item->setText(0, QDir::toNativeSeparators(result.FileName));
+        if (!result.ErrorString.isEmpty())
+        {
+            item->setText(1, result.ErrorString);
+            item->setForeground(1, Qt::red);
+            continue;
+        }
+        item->setText(1, QString::number(result.ChangedRowsCount));
+        item->setText(2, QString::number(result.OccurrencesCount));
+        if (result.ChangedRowsCount)
+            changedFilesCount++;
+    }
+    ui.previewTreeWidget->resizeColumnToContents(0);
+    ui.replaceButton->setEnabled(changedFilesCount);
+    if (!changedFilesCount)
+        QMessageBox::information(this, windowTitle(), tr("String \"%1\" not found").arg(ui.findLineEdit->text()));
+}
+
+void BatchReplaceDialog::replace()
+{
+    int changedFilesCount = 0, occurrencesCount = 0;
+    foreach (const BatchReplaceResult &result, _results)
+    {
+        if (result.ChangedRowsCount)
+            changedFilesCount++;
+        occurrencesCount += result.OccurrencesCount;
+    }
+    if (QMessageBox::question(this, windowTitle(), tr("Replace %n occurrence(s)", 0, occurrencesCount) + ' ' + tr("in %n file(s)?", 0, changedFilesCount),
+                              QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
+        return;
+
+    QString errorString;
+    if (BatchReplace::writeResults(_results, TableFormatOptions::fromSettings(), &errorString))
+    {
+        invalidatePreview();
+        QMessageBox::information(this, windowTitle(), tr("%n file(s) changed", 0, changedFilesCount)); // opened tables are merged by the file watcher
+    }
+    else
+        QMessageBox::critical(this, windowTitle(), errorString);
+}
@@ -0,0 +1,46 @@
+#ifndef BATCHREPLACEDIALOG_H
+#define BATCHREPLACEDIALOG_H
+
+#include "ui_batchreplacedialog.h"
+#include "batchreplace.h"
+
+#include <QFutureWatcher>
+
+
+class QCloseEvent;
+
+// replacing is previewed first: counts are shown and nothing is written until user confirms
+class BatchReplaceDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    BatchReplaceDialog(QWidget *parent, const QStringList &openedFileNames, const QString &lastPath);
+
+protected:
+    void closeEvent(QCloseEvent *e);
+
+private slots:
+    void addFiles();
+    void addOpenedFiles();
+    void removeFiles();
+    void preview();
+    void previewFinished();
+    void replace();
+    void invalidatePreview();
+
+private:
+    Ui::BatchReplaceDialog ui;
+    QStringList _openedFileNames;
+    QString _lastPath;
+    QFutureWatcher<BatchReplaceResult> *_previewWatcher;
+    QList<BatchReplaceResult> _results;
+
+    BatchReplaceSpec spec() const;
+    QStringList fileNames() const;
+    void addFileNames(const QStringList &fileNames);
+    void readSettings();
+    void writeSettings();
+};
+
+#endif // BATCHREPLACEDIALOG_H
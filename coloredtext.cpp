@@ -0,0 +1,100 @@
+#include "coloredtext.h"
+
+#include <QStringList>
+
+
+extern QStringList colorStrings;
+
+// returns index in colors list of the color string at position or -1
+static int colorIndexAt(const QString &text, int position)
+{
+    for (int i = 1; i < colorStrings.size(); i++)
+    {
+        const QString &colorString = colorStrings.at(i);
+        if (text.midRef(position, colorString.length()) == colorString)
+            return i - 1;
+    }
+    return -1;
+}
+
+ColoredTextRuns splitIntoColoredRuns(const QString &text)
+{
+    ColoredTextRuns runs;
+    int currentColorIndex = 0, runStart = 0;
+    for (int i = text.indexOf('\\'); i != -1; i = text.indexOf('\\', i))
+    {
+        int colorIndex = colorIndexAt(text, i);
+        if (colorIndex == -1)
+        {
+            i++;
+            continue;
+        }
+
+        if (i > runStart)
+            runs += ColoredTextRun(currentColorIndex, text.mid(runStart, i - runStart));
+        currentColorIndex = colorIndex;
+        i += colorStrings.at(colorIndex + 1).length();
+        runStart = i;
+    }
+    if (runStart < text.length())
+        runs += ColoredTextRun(currentColorIndex, text.mid(runStart));
+    return runs;
+}
+
+int coloredTextLength(const QString &text)
+{
+    int length = text.length();
+    for (int i = text.indexOf('\\'); i != -1; i = text.indexOf('\\', i))
+    {
+        int colorIndex = colorIndexAt(text, i);
+        if (colorIndex == -1)
+        {
+            i++;
+            continue;
+        }
+
+        int colorStringLength = colorStrings.at(colorIndex + 1).length();
+        length -= colorStringLength;
+        i += colorStringLength;
+    }
+    return length;
+}
+
+int coloredTextLength(const ColoredTextRuns &runs)
+{
+    int length = 0;
+    foreach (const ColoredTextRun &run, runs)
+        length += run.Text.length();
+    return length;
+}
+
+QList<int> colorIndexes(const QString &text)
+{
+    QList<int> indexes;
+    for (int i = text.indexOf('\\'); i != -1; i = text.indexOf('\\', i))
+    {
+        int colorIndex = colorIndexAt(text, i);
+        if (colorIndex == -1)
+        {
+            i++;
+            continue;
+        }
+
+        indexes += colorIndex;
+        i += colorStrings.at(colorIndex + 1).length();
+    }
+    return indexes;
+}
+
+
+const char kGenderTags[kGenderTagsNumber][kGenderTagLength + 1] = {"[ms]", "[fs]", "[ns]", "[nl]", "[pl]", "[mp]", "[fp]"};
+
+bool isGenderTagAt(const QString &text, int position)
+{
+    if (position + kGenderTagLength > text.length() || text.at(position) != '[')
+        return false;
+    for (int i = 0; i < kGenderTagsNumber; i++)
+        if (text.midRef(position, kGenderTagLength) == QLatin1String(kGenderTags[i]))
+            return true;
+    return false;
+}
@@ -0,0 +1,43 @@
+#ifndef COLOREDTEXT_H
+#define COLOREDTEXT_H
+
+#include <QList>
+#include <QString>
+
+
+struct ColoredTextRun // text between two color strings
+{
+    int ColorIndex; // index in colors list
+    QString Text;
+
+    ColoredTextRun() : ColorIndex(0) {}
+    ColoredTextRun(int colorIndex, const QString &text) : ColorIndex(colorIndex), Text(text) {}
+
+    bool operator ==(const ColoredTextRun &other) const { return ColorIndex == other.ColorIndex && Text == other.Text; }
+    bool operator !=(const ColoredTextRun &other) const { return !(*this == other); }
+};
+
+typedef QList<ColoredTextRun> ColoredTextRuns;
+
+
+const int kMaxLengthPatch110 = 255; // longer strings are truncated by the game
+
+
+// splits text into runs in one pass, color strings aren't included in runs' text; text is white by default
+ColoredTextRuns splitIntoColoredRuns(const QString &text);
+
+// number of characters displayed in game (color strings are skipped), doesn't allocate memory
+int coloredTextLength(const QString &text);
+int coloredTextLength(const ColoredTextRuns &runs);
+
+// indexes in colors list of all color strings in order of appearance, including the trailing ones that color nothing
+QList<int> colorIndexes(const QString &text);
+
+
+// gender and number tags that translators put before words, e.g. "[ms]Schild[fs]Axt", in order of the editor's menu
+const int kGenderTagsNumber = 7, kGenderTagLength = 4;
+extern const char kGenderTags[kGenderTagsNumber][kGenderTagLength + 1];
+
+bool isGenderTagAt(const QString &text, int position);
+
+#endif // COLOREDTEXT_H
@@ -1,5 +1,6 @@
 int colorHeaderSize = 2; // const
 int colorsNum = 13; // const
+int colorsRevision = 0; // increased when custom colors change
 
 #include <QColor>
 // first bytes of color code: symbols in Unicode - U+00FF, U+0063
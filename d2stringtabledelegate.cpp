@@ -0,0 +1,75 @@
+#include "d2stringtabledelegate.h"
+#include "d2stringtablewidget.h"
+
+#include <QPainter>
+#include <QApplication>
+
+
+extern QList<QColor> colors;
+
+D2StringTableDelegate::D2StringTableDelegate(D2StringTableWidget *parent) : QStyledItemDelegate(parent), _tableWidget(parent)
+{
+}
+
+void D2StringTableDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    bool isModified = _tableWidget->isCellModified(index.row(), index.column());
+    bool isTooLong = index.column() == 1 && _tableWidget->isRowTooLong(index.row());
+    bool isConflicting = _tableWidget->isRowConflicting(index.row());
+    if (index.column() == 1 && _tableWidget->isColoredTextShown())
+    {
+        D2StringTableItem *item = dynamic_cast<D2StringTableItem *>(_tableWidget->item(index.row(), index.column()));
+        if (item)
+        {
+            // game text is displayed on black background
+            QColor background = isTooLong ? QColor(96, 0, 0) : (isConflicting ? QColor(112, 64, 0) : (isModified ? QColor(0, 80, 0) : QColor(Qt::black)));
+            paintColoredText(painter, option, index, item->coloredRuns(), background);
+            return;
+        }
+    }
+
+    // modified cells aren't stored in items any more, so their background is painted here
+    if (isTooLong)
+        painter->fillRect(option.rect, QColor(255, 128, 128));
+    else if (isConflicting)
+        painter->fillRect(option.rect, QColor(255, 176, 64));
+    else if (isModified)
+        painter->fillRect(option.rect, Qt::green);
+    QStyledItemDelegate::paint(painter, option, index);
+}
+
+void D2StringTableDelegate::paintColoredText(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index, const ColoredTextRuns &runs, const QColor &background) const
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QStyleOptionViewItem opt(option);
+#else
+    QStyleOptionViewItemV4 opt(option);
+#endif
+    initStyleOption(&opt, index);
+    opt.text = QString();
+    QStyle *style = opt.widget ? opt.widget->style() : QApplication::style();
+
+    if (!(opt.state & QStyle::State_Selected))
+        painter->fillRect(opt.rect, background);
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, opt.widget);
+
+    QRect textRect = style->subElementRect(QStyle::SE_ItemViewItemText, &opt, opt.widget);
+    QFontMetrics fm(opt.font);
+    int x = textRect.left(), baseline = textRect.top() + (textRect.height() + fm.ascent() - fm.descent()) / 2;
+
+    painter->save();
+    painter->setFont(opt.font);
+    painter->setClipRect(textRect);
+    foreach (const ColoredTextRun &run, runs)
+    {
+        if (x > textRect.right())
+            break;
+
+        QString runText = run.Text;
+        runText.replace('\n', QChar(0x21B5)); // everything is drawn in one line
+        painter->setPen(colors.at(run.ColorIndex));
+        painter->drawText(x, baseline, runText);
+        x += fm.width(runText);
+    }
+    painter->restore();
+}
@@ -0,0 +1,25 @@
+#ifndef D2STRINGTABLEDELEGATE_H
+#define D2STRINGTABLEDELEGATE_H
+
+#include "coloredtext.h"
+
+#include <QStyledItemDelegate>
+
+
+class D2StringTableWidget;
+
+class D2StringTableDelegate : public QStyledItemDelegate
+{
+public:
+    explicit D2StringTableDelegate(D2StringTableWidget *parent);
+    virtual ~D2StringTableDelegate() {}
+
+    virtual void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+private:
+    D2StringTableWidget *_tableWidget;
+
+    void paintColoredText(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index, const ColoredTextRuns &runs, const QColor &background) const;
+};
+
+#endif // D2STRINGTABLEDELEGATE_H
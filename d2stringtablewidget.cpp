@@ -1,18 +1,88 @@
 #include "d2stringtablewidget.h"
+#include "d2stringtabledelegate.h"
+#include "tableedithistory.h"
+#include "tablejournal.h"
+#include "rowheaderview.h"
+#include "stringpool.h"
+#include "tablefile.h"
 
 #include <QProgressDialog>
 #include <QKeyEvent>
 #include <QListWidgetItem>
 #include <QAction>
+#include <QTimer>
+#include <QSet>
+
+#include <cstring>
 
 #ifndef QT_NO_DEBUG
 #include <QDebug>
 #endif
 
 
-D2StringTableWidget::D2StringTableWidget(QWidget *parent) : QTableWidget(parent), _displayRowHex(false), _addToRowValue(true)
+extern int colorsRevision;
+
+static const DWORD kNoKeyHash = 0xFFFFFFFF; // real hash values fit in 28 bits
+
+// rows without modifications are skipped a word at a time: an ordered index of modified rows would have to be
+// renumbered on every row insertion or removal, while this scan touches only n / 8 words of a sparse bitmap
+static int firstNonZeroByte(const quint8 *bytes, int from, int to)
+{
+    int i = from;
+    for (quint64 word; i + int(sizeof(word)) <= to; i += sizeof(word))
+    {
+        memcpy(&word, bytes + i, sizeof(word));
+        if (word)
+            break;
+    }
+    for (; i < to; ++i)
+        if (bytes[i])
+            return i;
+    return -1;
+}
+
+void D2StringTableItem::setData(int role, const QVariant &value)
+{
+    if (role != Qt::DisplayRole && role != Qt::EditRole)
+    {
+        QTableWidgetItem::setData(role, value);
+        return;
+    }
+
+    QString oldText = text();
+    QTableWidgetItem::setData(role, value);
+    if (text() != oldText)
+    {
+        _coloredRunsRevision = -1;
+        _coloredRuns.clear();
+
+        if (D2StringTableWidget *w = qobject_cast<D2StringTableWidget *>(tableWidget()))
+            w->itemTextChanged(this, oldText);
+    }
+}
+
+const ColoredTextRuns &D2StringTableItem::coloredRuns() const
+{
+    if (_coloredRunsRevision != colorsRevision)
+    {
+        _coloredRuns = splitIntoColoredRuns(text());
+        _coloredRunsRevision = colorsRevision;
+    }
+    return _coloredRuns;
+}
+
+
+D2StringTableWidget::D2StringTableWidget(QWidget *parent) : QTableWidget(parent), _modifiedRowsCount(0), _isColoredTextShown(false), _tooLongRowsCount(0), _validationStartRow(-1)
 {
+    setVerticalHeader(new RowHeaderView(this));
     setStyleSheet("QTableWidget::item:!active { selection-background-color: #999999 }");
+    setItemDelegate(new D2StringTableDelegate(this));
+    setItemPrototype(new D2StringTableItem);
+    _editHistory = new TableEditHistory(this);
+    _journal = new TableJournal(this);
+    _rowView = new TableRowView(this);
+    _validationTimer = new QTimer(this);
+    _validationTimer->setInterval(0); // rows are validated in chunks when event loop is idle
     horizontalHeader()->
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
         setSectionsClickable
@@ -20,6 +90,10 @@ D2StringTableWidget::D2StringTableWidget(QWidget *parent) : QTableWidget(parent)
         setClickable
 #endif
         (false);
+
+    connect(model(), SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(rowsWereInserted(QModelIndex, int, int)));
+    connect(model(), SIGNAL(rowsRemoved(QModelIndex, int, int)),  SLOT(rowsWereRemoved(QModelIndex, int, int)));
+    connect(_validationTimer, SIGNAL(timeout()), SLOT(validateNextRows()));
 }
 
 void D2StringTableWidget::keyPressEvent(QKeyEvent *keyEvent)
@@ -57,59 +131,115 @@ void D2StringTableWidget::keyPressEvent(QKeyEvent *keyEvent)
 
 void D2StringTableWidget::deleteItems(bool isClear)
 {
+    // when rows are sorted or filtered, selection consists of many ranges in any order and may cover hidden rows
     QList<QTableWidgetSelectionRange> ranges(selectedRanges());
-    int elementsToDelete = 0;
-    for (int i = 0; i < ranges.size(); i++)
-        elementsToDelete += ranges.at(i).rowCount();
+    if (isClear) // Only Delete pressed, clears selected items
+    {
+        _editHistory->beginGroup();
+        foreach (const QTableWidgetSelectionRange &range, ranges)
+            for (int j = range.topRow(); j <= range.bottomRow(); ++j)
+                if (!isRowHidden(j))
+                    for (int k = range.leftColumn(); k <= range.rightColumn(); ++k)
+                        item(j, k)->setText(QString());
+        _editHistory->endGroup();
+        return;
+    }
+
+    // Shift+Delete pressed, removes selected rows from the last one, so that other rows keep their indices
+    QList<int> rowsToDelete;
+    foreach (const QTableWidgetSelectionRange &range, ranges)
+        for (int j = range.topRow(); j <= range.bottomRow(); ++j)
+            if (!isRowHidden(j))
+                rowsToDelete += j;
+    qSort(rowsToDelete.begin(), rowsToDelete.end(), qGreater<int>());
 
     // deleting rows is a long process, so progress dialog is shown
-    QProgressDialog progress(tr("Deleting selected rows..."), tr("Cancel"), 0, elementsToDelete, this);
+    QProgressDialog progress(tr("Deleting selected rows..."), tr("Cancel"), 0, rowsToDelete.size(), this);
     progress.setWindowModality(Qt::WindowModal);
-    for (int i = 0, rowShift = 0; i < ranges.size(); ++i)
+    _editHistory->beginGroup();
+    for (int i = 0; i < rowsToDelete.size(); ++i)
     {
-        const QTableWidgetSelectionRange &range = ranges.at(i);
-        if (isClear) // Only Delete pressed, clears selected items
-        {
-            for (int j = range.topRow(); j <= range.bottomRow(); ++j)
-                for (int k = range.leftColumn(); k <= range.rightColumn(); ++k)
-                    item(j, k)->setText(QString());
-        }
-        else // Shift+Delete pressed, removes selected rows
-        {
-            for (int k = 0; k < range.rowCount(); ++k)
-            {
-                progress.setValue((i + 1) * k);
-                if (progress.wasCanceled())
-                    return;
-
-                int row = range.topRow() - rowShift;
-                removeRow(row);
-                _editedItems.remove(qMakePair<int, int>(row, 0));
-                _editedItems.remove(qMakePair<int, int>(row, 1));
-            }
-            rowShift += range.rowCount();
-            emit currentCellChanged(currentRow(), 0, 0, 0);
-        }
+        progress.setValue(i);
+        if (progress.wasCanceled())
+            break;
+        removeRow(rowsToDelete.at(i));
     }
-    progress.setValue(elementsToDelete);
-
-    if (!isClear)
-        changeRowHeaderDisplay();
+    _editHistory->endGroup();
+    emit currentCellChanged(currentRow(), 0, 0, 0);
+    progress.setValue(rowsToDelete.size());
 }
 
 void D2StringTableWidget::createRowAt(int row)
 {
     insertRow(row);
-    setItem(row, 0, new QTableWidgetItem);
-    setItem(row, 1, new QTableWidgetItem);
+    setItem(row, 0, new D2StringTableItem);
+    setItem(row, 1, new D2StringTableItem);
     setCurrentCell(row, 0, QItemSelectionModel::ClearAndSelect);
     emit currentCellChanged(row, 0, 0, 0);
 }
 
+void D2StringTableWidget::insertEntries(int row, const KeyValuePairList &entries)
+{
+    // all rows are inserted at once, which is much faster than creating them one by one
+    model()->insertRows(row, entries.size());
+    for (int i = 0; i < entries.size(); ++i)
+        createNewEntry(row + i, entries.at(i).first, entries.at(i).second);
+}
+
+static QString normalizedText(const QString &text) { return text.isEmpty() || text == "\"" ? QString() : text; }
+
 void D2StringTableWidget::createNewEntry(int row, const QString &key, const QString &val)
 {
-    setItem(row, 0, new QTableWidgetItem(key.isEmpty() || key == "\"" ? QString() : key));
-    setItem(row, 1, new QTableWidgetItem(val.isEmpty() || val == "\"" ? QString() : val));
+    setEntry(row, normalizedText(key), normalizedText(val));
+}
+
+void D2StringTableWidget::setEntry(int row, const QString &key, const QString &val)
+{
+    // translations of a table mostly have the same keys and many equal values, so they share memory
+    setItem(row, 0, new D2StringTableItem(StringPool::intern(key)));
+    setItem(row, 1, new D2StringTableItem(StringPool::intern(val)));
+}
+
+KeyValuePair D2StringTableWidget::entry(int row) const
+{
+    QTableWidgetItem *keyItem = item(row, 0), *valItem = item(row, 1);
+    return KeyValuePair(keyItem ? keyItem->text() : QString(), valItem ? valItem->text() : QString());
+}
+
+KeyValuePairList D2StringTableWidget::entries() const
+{
+    KeyValuePairList result;
+    result.reserve(rowCount());
+    for (int i = 0, n = rowCount(); i < n; ++i)
+        result += entry(i);
+    return result;
+}
+
+void D2StringTableWidget::clearContents()
+{
+    _editHistory->setEnabled(false);
+    _journal->close();
+    QTableWidget::clearContents();
+    clearModifiedCells();
+
+    _rawKeyHashes.fill(kNoKeyHash);
+    _tooLongRows.fill(false);
+    _tooLongRowsCount = 0;
+    _validationStartRow = -1;
+    _validationTimer->stop();
+    emit tooLongRowsChanged();
+    _rowView->reset();
+}
+
+void D2StringTableWidget::itemTextChanged(QTableWidgetItem *item, const QString &oldText)
+{
+    _editHistory->textChanged(item->row(), item->column(), oldText, item->text());
+    if (isRowConflicting(item->row())) // user has resolved it
+        setRowConflicting(item->row(), false);
+    if (item->column() == 0 && item->row() < _rawKeyHashes.size())
+        _rawKeyHashes[item->row()] = kNoKeyHash;
+    if (item->column() == 1 && item->row() < _tooLongRows.size() && validateRow(item->row()))
+        emit tooLongRowsChanged();
 }
 
 void D2StringTableWidget::mousePressEvent(QMouseEvent *mouseEvent)
@@ -121,15 +251,282 @@ void D2StringTableWidget::mousePressEvent(QMouseEvent *mouseEvent)
         editInPlace();
 }
 
-void D2StringTableWidget::clearBackground()
+void D2StringTableWidget::setCellModified(int row, int column)
+{
+    quint8 &rowBits = _modifiedCells[row];
+    if (!rowBits)
+        _modifiedRowsCount++;
+    rowBits |= 1 << column;
+    viewport()->update(visualRect(model()->index(row, column)));
+}
+
+void D2StringTableWidget::clearModifiedCells()
+{
+    _modifiedCells.fill(0);
+    _modifiedRowsCount = 0;
+    viewport()->update();
+}
+
+void D2StringTableWidget::setRowConflicting(int row, bool isConflicting)
 {
-    // without blocking cells will become green again immediately
-    blockSignals(true);
-    foreach (QTableWidgetItem *item, _editedItems)
-        item->setBackground(QBrush(Qt::white));
-    blockSignals(false);
+    quint8 &rowBits = _modifiedCells[row];
+    bool wasModified = rowBits != 0;
+    if (isConflicting)
+        rowBits |= kConflictBit;
+    else
+        rowBits &= ~kConflictBit;
+
+    if (wasModified != (rowBits != 0))
+        _modifiedRowsCount += rowBits ? 1 : -1;
+    viewport()->update();
+}
 
-    _editedItems.clear();
+// an entry is identified by its key and the number of entries with the same key above it
+typedef QPair<QString, int> EntryId;
+
+static QHash<EntryId, int> entryIndices(const KeyValuePairList &entries)
+{
+    QHash<QString, int> keyOccurrences;
+    QHash<EntryId, int> indices;
+    indices.reserve(entries.size());
+    for (int i = 0; i < entries.size(); ++i)
+        indices.insert(EntryId(entries.at(i).first, keyOccurrences[entries.at(i).first]++), i);
+    return indices;
+}
+
+struct RowsChange // insertion or removal of one row, applied from the bottom
+{
+    int Row, FileIndex; // FileIndex is -1 for removals
+    bool operator <(const RowsChange &other) const
+    {
+        // removal at the same row goes first to remove the row that is there now. Rows inserted at the same place are
+        // inserted in reverse file order, because each of them pushes the previous ones down
+        if (Row != other.Row)
+            return Row > other.Row;
+        if ((FileIndex == -1) != (other.FileIndex == -1))
+            return FileIndex == -1;
+        return FileIndex > other.FileIndex;
+    }
+};
+
+int D2StringTableWidget::mergeEntries(const KeyValuePairList &fileEntries, int *changedRowsCount)
+{
+    KeyValuePairList newEntries;
+    newEntries.reserve(fileEntries.size());
+    foreach (const KeyValuePair &entry, fileEntries)
+        newEntries += KeyValuePair(StringPool::intern(normalizedText(entry.first)), StringPool::intern(normalizedText(entry.second)));
+
+    // three-way merge: file changes since the last load or save are applied only to rows that user hasn't changed
+    QHash<EntryId, int> savedIndices = entryIndices(_savedEntries), newIndices = entryIndices(newEntries), rows = entryIndices(entries());
+    QList<RowsChange> rowsChanges;
+    int conflictsCount = 0;
+    *changedRowsCount = 0;
+
+    // merge is undone as a whole, like any other command
+    _editHistory->beginGroup();
+    QHash<QString, int> keyOccurrences;
+    int anchorRow = -1; // row of the last entry from the file that is present in the table
+    for (int i = 0; i < newEntries.size(); ++i)
+    {
+        const KeyValuePair &newEntry = newEntries.at(i);
+        EntryId id(newEntry.first, keyOccurrences[newEntry.first]++);
+        int row = rows.value(id, -1);
+        if (row != -1)
+            anchorRow = row;
+
+        int savedIndex = savedIndices.value(id, -1);
+        if (savedIndex == -1) // added to the file
+        {
+            if (row == -1)
+            {
+                RowsChange change = {anchorRow + 1, i};
+                rowsChanges += change;
+            }
+            else if (item(row, 1)->text() != newEntry.second) // user has added the same key
+            {
+                setRowConflicting(row, true);
+                conflictsCount++;
+            }
+            continue;
+        }
+
+        const QString &savedText = _savedEntries.at(savedIndex).second;
+        if (savedText == newEntry.second)
+            continue;
+        if (row == -1) // user has removed the entry or changed its key
+        {
+            conflictsCount++;
+            continue;
+        }
+
+        QString text = item(row, 1)->text();
+        if (text == savedText)
+        {
+            item(row, 1)->setText(newEntry.second);
+            (*changedRowsCount)++;
+        }
+        else if (text != newEntry.second)
+        {
+            setRowConflicting(row, true);
+            conflictsCount++;
+        }
+    }
+
+    for (QHash<EntryId, int>::const_iterator it = savedIndices.constBegin(); it != savedIndices.constEnd(); ++it)
+    {
+        if (newIndices.contains(it.key())) // still in the file
+            continue;
+
+        int row = rows.value(it.key(), -1);
+        if (row == -1)
+            continue; // removed by user too
+        if (item(row, 1)->text() == _savedEntries.at(it.value()).second)
+        {
+            RowsChange change = {row, -1};
+            rowsChanges += change;
+        }
+        else
+        {
+            setRowConflicting(row, true);
+            conflictsCount++;
+        }
+    }
+
+    qSort(rowsChanges);
+    foreach (const RowsChange &change, rowsChanges)
+    {
+        if (change.FileIndex == -1)
+            model()->removeRows(change.Row, 1);
+        else
+            insertEntries(change.Row, KeyValuePairList() << newEntries.at(change.FileIndex));
+        (*changedRowsCount)++;
+    }
+    _editHistory->endGroup();
+
+    _savedEntries = newEntries;
+    return conflictsCount;
+}
+
+int D2StringTableWidget::nextModifiedRow(int row) const
+{
+    if (!_modifiedRowsCount)
+        return -1;
+
+    // search after the given row first and wrap around to the beginning
+    const quint8 *bits = _modifiedCells.constData();
+    int next = firstNonZeroByte(bits, row + 1, _modifiedCells.size());
+    return next != -1 ? next : firstNonZeroByte(bits, 0, qMin(row + 1, _modifiedCells.size()));
+}
+
+DWORD D2StringTableWidget::rawKeyHash(int row) const
+{
+    DWORD &hash = _rawKeyHashes[row];
+    if (hash == kNoKeyHash)
+    {
+        QTableWidgetItem *keyItem = item(row, 0);
+        hash = TblStructure::rawHashValue(keyItem ? TblStructure::encodeKey(keyItem->text()).constData() : "");
+    }
+    return hash;
+}
+
+void D2StringTableWidget::keyHashTablePlacement(QVector<int> *buckets, QVector<int> *probes) const
+{
+    QVector<DWORD> hashIndices(rowCount());
+    for (int i = 0; i < hashIndices.size(); ++i)
+        hashIndices[i] = keyHash(i); // uses cached key hashes
+    tblHashTablePlacement(hashIndices, buckets, probes);
+}
+
+QList<int> D2StringTableWidget::tooLongRows() const
+{
+    QList<int> rows;
+    if (_tooLongRowsCount)
+        for (int i = 0, n = _tooLongRows.size(); i < n; ++i)
+            if (_tooLongRows.at(i))
+                rows += i;
+    return rows;
+}
+
+void D2StringTableWidget::rowsWereInserted(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    _modifiedCells.insert(first, last - first + 1, 0);
+    _rawKeyHashes.insert(first, last - first + 1, kNoKeyHash);
+    _tooLongRows.insert(first, last - first + 1, false);
+    // items are set after rows are inserted, so new keys and strings can be processed only later
+    scheduleValidationFrom(first);
+}
+
+void D2StringTableWidget::rowsWereRemoved(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    for (int i = first; i <= last; ++i)
+        if (_modifiedCells.at(i))
+            _modifiedRowsCount--;
+    _modifiedCells.remove(first, last - first + 1);
+    _rawKeyHashes.remove(first, last - first + 1);
+
+    int removedTooLongRows = 0;
+    for (int i = first; i <= last; ++i)
+        if (_tooLongRows.at(i))
+            removedTooLongRows++;
+    _tooLongRows.remove(first, last - first + 1);
+    if (removedTooLongRows)
+    {
+        _tooLongRowsCount -= removedTooLongRows;
+        emit tooLongRowsChanged();
+    }
+    if (_validationStartRow > first)
+        _validationStartRow = qMax(first, _validationStartRow - (last - first + 1));
+}
+
+void D2StringTableWidget::scheduleValidationFrom(int row)
+{
+    if (_validationStartRow == -1 || row < _validationStartRow)
+        _validationStartRow = row;
+    _validationTimer->start();
+}
+
+void D2StringTableWidget::validateNextRows()
+{
+    const int kRowsPerChunk = 2000;
+    if (_validationStartRow == -1)
+    {
+        _validationTimer->stop();
+        return;
+    }
+
+    bool hasChanges = false;
+    int n = qMin(_validationStartRow + kRowsPerChunk, _tooLongRows.size());
+    for (int i = _validationStartRow; i < n; ++i)
+    {
+        rawKeyHash(i); // hashes are computed in bulk here instead of on every cursor move
+        hasChanges |= validateRow(i);
+    }
+
+    if (n < _tooLongRows.size())
+        _validationStartRow = n;
+    else
+    {
+        _validationStartRow = -1;
+        _validationTimer->stop();
+    }
+    if (hasChanges)
+        emit tooLongRowsChanged();
+}
+
+// returns true if row state was changed
+bool D2StringTableWidget::validateRow(int row)
+{
+    QTableWidgetItem *valItem = item(row, 1);
+    bool isTooLong = valItem && coloredTextLength(valItem->text()) > kMaxLengthPatch110;
+    if (_tooLongRows.at(row) == isTooLong)
+        return false;
+
+    _tooLongRows[row] = isTooLong;
+    _tooLongRowsCount += isTooLong ? 1 : -1;
+    viewport()->update(visualRect(model()->index(row, 1)));
+    return true;
 }
 
 void D2StringTableWidget::dropEvent(QDropEvent *event)
@@ -145,11 +542,12 @@ void D2StringTableWidget::dropEvent(QDropEvent *event)
             QTableWidgetItem *anItem = item(firstDroppedItem->row() + i, firstDroppedItem->column() + j);
             droppedItems += anItem;
             oldTexts += anItem->text();
-            addEditedItem(anItem);
         }
     }
 
+    _editHistory->beginGroup();
     QTableWidget::dropEvent(event);
+    _editHistory->endGroup();
     for (int i = 0; i < droppedItems.size(); ++i)
     {
         QTableWidgetItem *anItem = droppedItems.at(i);
@@ -158,31 +556,47 @@ void D2StringTableWidget::dropEvent(QDropEvent *event)
     }
 }
 
-void D2StringTableWidget::toggleDisplayHex(bool toggled)
+qint64 D2StringTableWidget::memoryUsage() const
+{
+    // item object, its only role value (role and QVariant) with header of the vector holding it, and model's pointer to the item
+    const int kItemSize = sizeof(D2StringTableItem) + sizeof(int) + sizeof(QVariant) + 4 * sizeof(int) + sizeof(void *);
+    QSet<const QChar *> countedData;
+    qint64 bytes = 0;
+    for (int i = 0, n = rowCount(); i < n; ++i)
+    {
+        for (int j = 0; j < 2; ++j)
+        {
+            QTableWidgetItem *tableItem = item(i, j);
+            if (!tableItem)
+                continue;
+
+            bytes += kItemSize;
+            QString text = tableItem->text();
+            if (!countedData.contains(text.constData()))
+            {
+                countedData.insert(text.constData());
+                bytes += stringMemoryUsage(text);
+            }
+        }
+    }
+
+    // strings of saved entries are shared with items
+    bytes += _savedEntries.size() * qint64(sizeof(KeyValuePair) + sizeof(void *));
+    bytes += _modifiedCells.capacity() * sizeof(quint8) + _rawKeyHashes.capacity() * sizeof(DWORD) + _tooLongRows.capacity() * sizeof(bool);
+    return bytes + _editHistory->memoryUsage();
+}
+
+RowHeaderView *D2StringTableWidget::rowHeader() const
 {
-    _displayRowHex = toggled;
-    changeRowHeaderDisplay();
+    return static_cast<RowHeaderView *>(verticalHeader());
 }
 
-void D2StringTableWidget::changeRowNumberingTo1(bool toggled)
+void D2StringTableWidget::toggleDisplayHex(bool toggled)
 {
-    _addToRowValue = toggled;
-    changeRowHeaderDisplay();
+    rowHeader()->setDisplayHex(toggled);
 }
 
-void D2StringTableWidget::changeRowHeaderDisplay()
+void D2StringTableWidget::changeRowNumberingTo1(bool toggled)
 {
-    QStringList rowLabels;
-    for (int i = 0; i < rowCount(); ++i)
-    {
-        int row = i + _addToRowValue;
-        QString rowText = QString::number(row);
-        if (_displayRowHex)
-            rowText += QString(" (0x%2)").arg(row, 0, 16);
-#ifdef Q_OS_MAC
-        rowText += "  "; // fixes slight text truncation
-#endif
-        rowLabels += rowText;
-    }
-    setVerticalHeaderLabels(rowLabels);
+    rowHeader()->setStartsFrom1(toggled);
 }
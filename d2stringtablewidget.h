@@ -1,6 +1,10 @@
 #ifndef D2STRINGTABLEWIDGET_H
 #define D2STRINGTABLEWIDGET_H
 
+#include "tblstructure.h"
+#include "coloredtext.h"
+#include "tablerowview.h"
+
 #include <QTableWidget>
 #include <QHeaderView>
 
@@ -10,6 +14,26 @@ class QMouseEvent;
 class QDropEvent;
 class QListWidgetItem;
 class QAction;
+class TableEditHistory;
+class TableJournal;
+class RowHeaderView;
+class QTimer;
+
+class D2StringTableItem : public QTableWidgetItem // notifies the table about text changes
+{
+public:
+    explicit D2StringTableItem(const QString &text = QString()) : QTableWidgetItem(text), _coloredRunsRevision(-1) {}
+    virtual ~D2StringTableItem() {}
+
+    virtual QTableWidgetItem *clone() const { return new D2StringTableItem(*this); }
+    virtual void setData(int role, const QVariant &value);
+
+    const ColoredTextRuns &coloredRuns() const; // cached until text or colors change
+
+private:
+    mutable ColoredTextRuns _coloredRuns;
+    mutable int _coloredRunsRevision;
+};
 
 class D2StringTableWidget : public QTableWidget
 {
@@ -17,37 +41,89 @@ class D2StringTableWidget : public QTableWidget
 
 public:
     D2StringTableWidget(QWidget *parent = 0);
+    virtual ~D2StringTableWidget() { delete _rowView; }
 
     void deleteItems(bool isClear);
     void createRowAt(int row);
-    void addEditedItem(QTableWidgetItem *editedItem) { _editedItems[qMakePair<int, int>(editedItem->row(), editedItem->column())] = editedItem; }
-    void clearBackground();
+    void insertEntries(int row, const KeyValuePairList &entries);
     void createNewEntry(int row, const QString &key, const QString &val);
-    void clearContents() { QTableWidget::clearContents(); _editedItems.clear(); }
+    void setEntry(int row, const QString &key, const QString &val);
+    KeyValuePair entry(int row) const;
+    KeyValuePairList entries() const;
+    void clearContents();
 
-    void changeRowHeaderDisplay();
+    TableEditHistory *editHistory() const { return _editHistory; }
+    TableJournal *journal() const { return _journal; }
+    TableRowView *rowView() const { return _rowView; }
+    bool isColoredTextShown() const { return _isColoredTextShown; }
+    void itemTextChanged(QTableWidgetItem *item, const QString &oldText);
+
+    bool isCellModified(int row, int column) const { return row < _modifiedCells.size() && (_modifiedCells.at(row) & (1 << column)); }
+    void setCellModified(int row, int column);
+    void clearModifiedCells();
+    bool hasModifiedCells() const { return _modifiedRowsCount != 0; }
+    int nextModifiedRow(int row) const;
+
+    // rows where both the file and the table changed the same entry since the last load or save
+    bool isRowConflicting(int row) const { return row < _modifiedCells.size() && (_modifiedCells.at(row) & kConflictBit); }
+    void setRowConflicting(int row, bool isConflicting);
+
+    const KeyValuePairList &savedEntries() const { return _savedEntries; }
+    void rememberSavedEntries() { _savedEntries = entries(); } // the table must be equal to its file
+    int mergeEntries(const KeyValuePairList &fileEntries, int *changedRowsCount); // returns the number of conflicts
+
+    DWORD keyHash(int row) const { return rawKeyHash(row) % rowCount(); } // index in the hash table of *.tbl
+    DWORD rawKeyHash(int row) const;
+    void keyHashTablePlacement(QVector<int> *buckets, QVector<int> *probes) const;
+
+    bool isRowTooLong(int row) const { return row < _tooLongRows.size() && _tooLongRows.at(row); }
+    QList<int> tooLongRows() const;
+
+    RowHeaderView *rowHeader() const;
+    qint64 memoryUsage() const; // approximate: items, text, per-row state and edit history
 
 public slots:
     void changeCurrentCell(int row, int col = 1) { if (row < rowCount()) setCurrentCell(row, col); }
     void tableDifferencesItemChanged(const QString &newText) { changeCurrentCell(newText.left(newText.indexOf(' ')).toInt() - 1); }
 
     void toggleDisplayHex(bool toggled);
+    void setColoredTextShown(bool isShown) { _isColoredTextShown = isShown; viewport()->update(); }
     void changeRowNumberingTo1(bool toggled);
 
 signals:
     void tableGotFocus(QWidget *);
     void itemWasDropped(QTableWidgetItem *);
+    void tooLongRowsChanged();
 
 protected:
     void keyPressEvent(QKeyEvent *keyEvent);
     void mousePressEvent(QMouseEvent *mouseEvent);
     void dropEvent(QDropEvent *event);
 
+private slots:
+    void rowsWereInserted(const QModelIndex &parent, int first, int last);
+    void rowsWereRemoved(const QModelIndex &parent, int first, int last);
+    void validateNextRows();
+
 private:
-    QMap<QPair<int, int>, QTableWidgetItem *> _editedItems;
-    bool _displayRowHex, _addToRowValue;
+    TableEditHistory *_editHistory;
+    TableJournal *_journal;
+    TableRowView *_rowView;
+    QVector<quint8> _modifiedCells; // one byte per row, bit N is set if cell in column N was modified, kConflictBit - if row is conflicting
+    int _modifiedRowsCount;
+    bool _isColoredTextShown;
+    mutable QVector<DWORD> _rawKeyHashes; // kNoKeyHash for rows that weren't hashed yet
+    QVector<bool> _tooLongRows; // strings longer than 1.10 limit
+    int _tooLongRowsCount;
+    QTimer *_validationTimer;
+    int _validationStartRow; // rows after it are checked in background, -1 if nothing to check
+    KeyValuePairList _savedEntries; // contents of the file, strings are shared with items
+
+    static const quint8 kConflictBit = 0x80;
 
     void editInPlace() { editItem(currentItem()); };
+    void scheduleValidationFrom(int row);
+    bool validateRow(int row);
 };
 
 #endif // D2STRINGTABLEWIDGET_H
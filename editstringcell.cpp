@@ -1,11 +1,18 @@
 #include "editstringcell.h"
 #include "tblstructure.h"
 #include "editcolorsdialog.h"
+#include "d2stringtablewidget.h"
+#include "tableedithistory.h"
+#include "coloredtext.h"
 
 #include <QMenu>
 
-#include <QStack>
 #include <QTextCodec>
+#include <QTextCursor>
+#include <QTextCharFormat>
+#include <QTimer>
+
+#include <algorithm>
 
 
 // convenience function
@@ -15,16 +22,12 @@ QString colorHexString(const QColor &c)
     return QString("#%1%2%3").arg(c.red(), 2, 16, zeroChar).arg(c.green(), 2, 16, zeroChar).arg(c.blue(), 2, 16, zeroChar);
 }
 
-bool colorStringsIndecesLessThan(const QPair<int, int> &a, const QPair<int, int> &b)
-{
-    return a.second < b.second;
-}
-
 
 extern QList<QChar> colorCodes;
 extern QStringList colorStrings;
 extern QList<QColor> colors;
 extern int colorsNum;
+extern int colorsRevision;
 
 static const QString kGenderNumberMenuName("GenderNumberMenu");
 
@@ -32,13 +35,19 @@ EditStringCell::EditStringCell(QWidget *parent, const KeyValueItemsPair &keyValu
 {
     ui.setupUi(this);
 
-    static const QStringList kGenderAbbreviations = QStringList() << "[ms]" << "[fs]" << "[ns]" << "[nl]" << "[pl]" << "[mp]" << "[fp]";
+    // preview is updated after user stops typing for a moment
+    _previewTimer = new QTimer(this);
+    _previewTimer->setSingleShot(true);
+    _previewTimer->setInterval(50);
+    connect(_previewTimer, SIGNAL(timeout()), SLOT(setPreviewText()));
+
+    // names are in the order of kGenderTags, the same tags are checked in translations
     static const QStringList kGenders = QStringList() << tr("Masculine singular") << tr("Feminine singular") << tr("Neutral singular") << tr("Neutral") << tr("Plural") << tr("Masculine plural") << tr("Feminine plural");
 
     QMenu *genderNumberMenu = new QMenu(ui.genderNumberButton);
     genderNumberMenu->setObjectName(kGenderNumberMenuName);
-    for (int i = 0; i < kGenderAbbreviations.size(); i++)
-        genderNumberMenu->addAction(QString("%1 %2").arg(kGenderAbbreviations.at(i), kGenders.at(i)), this, SLOT(insertText()));
+    for (int i = 0; i < kGenderTagsNumber; i++)
+        genderNumberMenu->addAction(QString("%1 %2").arg(QLatin1String(kGenderTags[i]), kGenders.at(i)), this, SLOT(insertText()));
     ui.genderNumberButton->setMenu(genderNumberMenu);
 
     _colorMenu = new QMenu(ui.colorButton);
@@ -49,9 +58,9 @@ EditStringCell::EditStringCell(QWidget *parent, const KeyValueItemsPair &keyValu
     connect(ui.wrapCheckBox, SIGNAL(toggled(bool)), SLOT(wrapModeChanged(bool)));
     connect(ui.keyLineEdit, SIGNAL(textChanged(QString)), SLOT(calculateKeyHashValue()));
     connect(ui.stringEdit, SIGNAL(textChanged()), SLOT(updateCharsEditCounter()));
-    connect(ui.stringEdit, SIGNAL(textChanged()), SLOT(setPreviewText()));
+    connect(ui.stringEdit, SIGNAL(textChanged()), SLOT(schedulePreviewUpdate()));
     connect(ui.stringEdit, SIGNAL(cursorPositionChanged()), SLOT(updateCurrentEditColumn()));
-    connect(ui.reversePreviewTextCheckBox, SIGNAL(toggled(bool)), SLOT(setPreviewText()));
+    connect(ui.reversePreviewTextCheckBox, SIGNAL(toggled(bool)), SLOT(resetPreview()));
 
     setItem(keyValueItemsPairToEdit);
 }
@@ -66,15 +75,18 @@ void EditStringCell::insertText()
 {
     QAction *menuItem = qobject_cast<QAction *>(sender());
     if (menuItem->parentWidget()->objectName() == kGenderNumberMenuName)
-        ui.stringEdit->insertPlainText(menuItem->text().left(4));
+        ui.stringEdit->insertPlainText(menuItem->text().left(kGenderTagLength));
     else
         ui.stringEdit->insertPlainText(menuItem->text());
 }
 
 void EditStringCell::saveChanges()
 {
+    TableEditHistory *editHistory = qobject_cast<D2StringTableWidget *>(_keyValueItemsPair.first->tableWidget())->editHistory();
+    editHistory->beginGroup();
     _keyValueItemsPair.first->setText(ui.keyLineEdit->text());
     _keyValueItemsPair.second->setText(ui.stringEdit->toPlainText());
+    editHistory->endGroup();
 }
 
 void EditStringCell::changeItem(bool toNext)
@@ -95,71 +107,80 @@ void EditStringCell::resetText()
     ui.keyLineEdit->setText(_keyValueItemsPair.first->text());
     ui.stringEdit->setPlainText(_keyValueItemsPair.second->text());
     updateCharsEditCounter();
+    setPreviewText(); // don't wait for the timer
 }
 
 void EditStringCell::calculateKeyHashValue()
 {
-    ui.hashValueLabel->setText(QString("0x%1").arg(TblStructure::hashValue(TblStructure::encodeKey(ui.keyLineEdit->text()).data(), _keyValueItemsPair.first->tableWidget()->rowCount()), 0, 16));
+    QTableWidgetItem *keyItem = _keyValueItemsPair.first;
+    D2StringTableWidget *w = qobject_cast<D2StringTableWidget *>(keyItem->tableWidget());
+    DWORD hashValue;
+    if (w && ui.keyLineEdit->text() == keyItem->text()) // unchanged key has its hash cached in the table
+        hashValue = w->keyHash(keyItem->row());
+    else
+        hashValue = TblStructure::hashValue(TblStructure::encodeKey(ui.keyLineEdit->text()).constData(), keyItem->tableWidget()->rowCount());
+    ui.hashValueLabel->setText(QString("0x%1").arg(hashValue, 0, 16));
 }
 
-void EditStringCell::setPreviewText()
+void EditStringCell::schedulePreviewUpdate()
 {
+    _previewTimer->start();
+}
+
+void EditStringCell::resetPreview()
+{
+    _previewRuns.clear();
     ui.stringPreview->clear();
+    setPreviewText();
+}
 
-    // text is white by default + stupid HTML with its newlines and spaces
-    QString text = colorStrings.at(1) + ui.stringEdit->toPlainText().replace('<', "&lt;").replace('>', "&gt;").replace('\n', "<br>");
-    int emptyMatchIndex;
-    QRegExp emptyRe(" {2,}");
-    while ((emptyMatchIndex = emptyRe.indexIn(text)) != -1)
-    {
-        int matchedLength = emptyRe.matchedLength();
-        text.replace(emptyMatchIndex, matchedLength, QString("&nbsp;").repeated(matchedLength));
-    }
+void EditStringCell::setPreviewText()
+{
+    _previewTimer->stop();
 
+    ColoredTextRuns runs = splitIntoColoredRuns(ui.stringEdit->toPlainText());
     if (ui.reversePreviewTextCheckBox->isChecked())
     {
-        QList<QPair<int, int> > colorStringsIndeces; // <index_of_color_string_in_array, position_in_string>
-        for (int i = 0; i < colors.size(); i++)
-        {
-            QString colorString = colorStrings.at(i + 1);
-            int occurencesCount = text.count(colorString), position = 0, length = colorString.length();
-            for (int j = 0; j < occurencesCount; j++, position += length)
-            {
-                position = text.indexOf(colorString, position);
-                colorStringsIndeces.append(qMakePair(i + 1, position));
-            }
-        }
-
-        // sort colorStringsIndeces by position in ascending order
-        qSort(colorStringsIndeces.begin(), colorStringsIndeces.end(), colorStringsIndecesLessThan);
-
-        QStack<QString> colorStringsStack;
-        for (int i = 0, colorsNumberInString = colorStringsIndeces.size(); i < colorsNumberInString; i++)
+        // lines of each color and colors themselves go in reverse order, like in the game
+        for (int i = 0; i < runs.size(); i++)
         {
-            int index = colorStringsIndeces.at(i).first;
-            int position = colorStringsIndeces.at(i).second + colorStrings.at(index).length(); // skip colorString
-            QString coloredText = text.mid(position, i != colorsNumberInString - 1 ? colorStringsIndeces.at(i + 1).second - position : -1);
-
-            QStringList lines = coloredText.split("<br>");
+            QStringList lines = runs.at(i).Text.split('\n');
             std::reverse(lines.begin(), lines.end());
-            QString reversedText = lines.join("<br>");
-            if (!reversedText.isEmpty())
-                colorStringsStack.push(QString("<font color = \"%1\">%2</font>").arg(colorHexString(colors.at(index - 1)), reversedText));
+            runs[i].Text = lines.join("\n");
         }
-
-        // empty the stack
-        while (!colorStringsStack.isEmpty())
-            ui.stringPreview->insertHtml(colorStringsStack.pop());
+        std::reverse(runs.begin(), runs.end());
     }
-    else
+
+    // only runs between unchanged beginning and end are replaced
+    int oldRunsCount = _previewRuns.size(), newRunsCount = runs.size(), prefix = 0, suffix = 0;
+    while (prefix < oldRunsCount && prefix < newRunsCount && _previewRuns.at(prefix) == runs.at(prefix))
+        prefix++;
+    while (suffix < oldRunsCount - prefix && suffix < newRunsCount - prefix
+           && _previewRuns.at(oldRunsCount - 1 - suffix) == runs.at(newRunsCount - 1 - suffix))
+        suffix++;
+
+    int changeStart = 0, changeEnd;
+    for (int i = 0; i < prefix; i++)
+        changeStart += runs.at(i).Text.length();
+    changeEnd = changeStart;
+    for (int i = prefix; i < oldRunsCount - suffix; i++)
+        changeEnd += _previewRuns.at(i).Text.length();
+
+    QTextCursor cursor(ui.stringPreview->document());
+    cursor.beginEditBlock();
+    cursor.setPosition(changeStart);
+    cursor.setPosition(changeEnd, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    for (int i = prefix; i < newRunsCount - suffix; i++)
     {
-        for (int i = 0; i < colors.size(); i++) // replace color codes with their hex values for HTML
-            text.replace(colorStrings.at(i + 1), QString("</font><font color = \"%1\">").arg(colorHexString(colors.at(i))));
-        ui.stringPreview->setHtml(text);
+        QTextCharFormat format;
+        format.setForeground(colors.at(runs.at(i).ColorIndex));
+        cursor.insertText(runs.at(i).Text, format);
     }
+    cursor.endEditBlock();
+    _previewRuns = runs;
 
-    const int kMaxLengthPatch110 = 255;
-    int length = ui.stringPreview->toPlainText().length();
+    int length = coloredTextLength(runs);
     ui.charsPreviewCountLabel->setText(QString::number(length));
     if (length > kMaxLengthPatch110)
         emit maxLengthExceededFor110(tr("Patch 1.10 has limitation of %1 characters per string").arg(kMaxLengthPatch110));
@@ -184,6 +205,7 @@ void EditStringCell::showEditColorsDialog()
             colorStrings.append(ci.Name);
             colors.append(ci.Color);
         }
+        colorsRevision++;
 
         updateColorsMenu();
         emit colorMenuChanged();
@@ -205,5 +227,5 @@ void EditStringCell::updateColorsMenu()
     _colorMenu->addSeparator();
     _colorMenu->addAction(tr("Edit..."), this, SLOT(showEditColorsDialog()));
 
-    setPreviewText();
+    resetPreview();
 }
@@ -2,10 +2,14 @@
 #define EDITSTRINGCELL_H
 
 #include "ui_editstringcell.h"
+#include "coloredtext.h"
 
 #include <QTableWidgetItem>
 
 
+class QTimer;
+
+
 QString colorHexString(const QColor &c);
 
 
@@ -40,7 +44,9 @@ private slots:
     void insertText();
     void updateCharsEditCounter() { ui.charsEditCountLabel->setText(QString::number(ui.stringEdit->toPlainText().length())); }
     void calculateKeyHashValue();
+    void schedulePreviewUpdate();
     void setPreviewText();
+    void resetPreview();
     void updateCurrentEditColumn() { ui.currentEditColumnLabel->setText(QString::number(ui.stringEdit->textCursor().columnNumber())); }
     void showEditColorsDialog();
 
@@ -48,6 +54,8 @@ private:
     Ui::EditStringCellClass ui;
     QMenu *_colorMenu;
     KeyValueItemsPair _keyValueItemsPair;
+    QTimer *_previewTimer;
+    ColoredTextRuns _previewRuns; // what preview currently displays
 };
 
 #endif // EDITSTRINGCELL_H
@@ -1,5 +1,6 @@
 #include "findreplacedialog.h"
 #include "tablepanelwidget.h"
+#include "tableedithistory.h"
 
 #include <QMessageBox>
 #include <QDialog>
@@ -7,6 +8,7 @@
 #include <QCloseEvent>
 
 #include <QSettings>
+#include <QSet>
 
 
 FindReplaceDialog::FindReplaceDialog(QWidget *parent) : QDialog(parent)
@@ -182,9 +184,19 @@ void FindReplaceDialog::replaceAll()
     if (_searchFailed)
         return;
 
+    // replacing in each table is undone as a whole
+    QSet<TableEditHistory *> editHistories;
+    foreach (QTableWidgetItem *item, _foundTableItems)
+        editHistories.insert(editHistoryOfItem(item));
+    foreach (TableEditHistory *editHistory, editHistories)
+        editHistory->beginGroup();
+
     int n = 0;
     for (_currentStringIterator = _foundTableItems.begin(); _currentStringIterator != _foundTableItems.end(); _currentStringIterator++, n++)
         replaceInCurrentString();
+
+    foreach (TableEditHistory *editHistory, editHistories)
+        editHistory->endGroup();
     QMessageBox::information(this, tr("Replace"), tr("%n occurrence(s) replaced", 0, n));
 
     _query.clear();
@@ -196,9 +208,17 @@ void FindReplaceDialog::replaceInCurrentString()
     QString replaceIn = itemToReplaceIn->text(), replaceWith = ui.lineEditReplace->text();
     Qt::CaseSensitivity cs = (Qt::CaseSensitivity)ui.checkBoxCaseSensitive->isChecked();
     int occurencesCount = replaceIn.count(_query, cs), position = 0;
+    TableEditHistory *editHistory = editHistoryOfItem(itemToReplaceIn);
+    editHistory->beginGroup();
     for (int i = 0; i < occurencesCount; i++)
     {
         position = replaceIn.indexOf(_query, position, cs);
         itemToReplaceIn->setText(replaceIn.replace(position, _query.length(), replaceWith));
     }
+    editHistory->endGroup();
+}
+
+TableEditHistory *FindReplaceDialog::editHistoryOfItem(QTableWidgetItem *item)
+{
+    return qobject_cast<D2StringTableWidget *>(item->tableWidget())->editHistory();
 }
@@ -7,6 +7,7 @@
 class QDialog;
 class QTableWidgetItem;
 class QCloseEvent;
+class TableEditHistory;
 
 class FindReplaceDialog : public QDialog
 {
@@ -48,6 +49,8 @@ private:
     bool areResultsObsolete();
     void replaceInCurrentString();
     void changeCurrentTableCell();
+
+    static TableEditHistory *editHistoryOfItem(QTableWidgetItem *item);
 };
 
 #endif // FINDREPLACEDIALOG_H
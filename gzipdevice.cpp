@@ -0,0 +1,173 @@
+#include "gzipdevice.h"
+
+#ifdef QTBLEDITOR_QT_ZLIB
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+
+#include <cstring>
+
+
+static const int kChunkSize = 64 * 1024;
+static const int kGzipWindowBits = 15 + 16, kAutodetectWindowBits = 15 + 32; // zlib's way to choose the wrapper
+
+struct GzipDevice::Stream
+{
+    z_stream Z;
+    QByteArray Buffer; // compressed input or output
+
+    Stream() : Buffer(kChunkSize, 0) { std::memset(&Z, 0, sizeof(Z)); }
+};
+
+
+GzipDevice::GzipDevice(QIODevice *device, QObject *parent) : QIODevice(parent), _device(device), _stream(0), _isStreamEnded(false)
+{
+}
+
+GzipDevice::~GzipDevice()
+{
+    if (isOpen())
+        close();
+}
+
+bool GzipDevice::open(OpenMode mode)
+{
+    if (isOpen() || (mode != QIODevice::ReadOnly && mode != QIODevice::WriteOnly))
+        return false;
+
+    _stream = new Stream;
+    int result = mode == QIODevice::ReadOnly ? inflateInit2(&_stream->Z, kAutodetectWindowBits)
+                                             : deflateInit2(&_stream->Z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, kGzipWindowBits, 8, Z_DEFAULT_STRATEGY);
+    if (result != Z_OK)
+    {
+        delete _stream;
+        _stream = 0;
+        setErrorString(tr("Couldn't initialize compression"));
+        return false;
+    }
+    _isStreamEnded = false;
+    return QIODevice::open(mode);
+}
+
+void GzipDevice::close()
+{
+    if (!isOpen())
+        return;
+    if (openMode() == QIODevice::WriteOnly)
+        finish();
+    endStream();
+    QIODevice::close();
+}
+
+bool GzipDevice::reset()
+{
+    if (openMode() != QIODevice::ReadOnly || !_device->reset())
+        return false;
+
+    // reopening drops the data QIODevice has already buffered
+    QIODevice::close();
+    inflateReset(&_stream->Z);
+    _stream->Z.avail_in = 0;
+    _isStreamEnded = false;
+    return QIODevice::open(QIODevice::ReadOnly);
+}
+
+bool GzipDevice::finish()
+{
+    if (openMode() != QIODevice::WriteOnly)
+        return false;
+    if (!_isStreamEnded)
+        _isStreamEnded = writeCompressed(Z_FINISH);
+    return _isStreamEnded;
+}
+
+qint64 GzipDevice::readData(char *data, qint64 maxSize)
+{
+    z_stream &z = _stream->Z;
+    z.next_out = reinterpret_cast<Bytef *>(data);
+    z.avail_out = static_cast<uInt>(qMin<qint64>(maxSize, kChunkSize * 16));
+    uInt requestedSize = z.avail_out;
+    while (z.avail_out && !_isStreamEnded)
+    {
+        if (!z.avail_in)
+        {
+            qint64 readBytes = _device->read(_stream->Buffer.data(), kChunkSize);
+            if (readBytes <= 0)
+            {
+                if (z.avail_out != requestedSize)
+                    break; // return what was decompressed, the error will be reported on the next call
+                setErrorString(tr("Unexpected end of compressed data"));
+                return -1;
+            }
+            z.next_in = reinterpret_cast<Bytef *>(_stream->Buffer.data());
+            z.avail_in = static_cast<uInt>(readBytes);
+        }
+
+        int result = inflate(&z, Z_NO_FLUSH);
+        if (result == Z_STREAM_END)
+        {
+            // gzip file may consist of several members one after another
+            if (z.avail_in || !_device->atEnd())
+                inflateReset(&z);
+            else
+                _isStreamEnded = true;
+        }
+        else if (result != Z_OK && result != Z_BUF_ERROR)
+        {
+            setErrorString(tr("Compressed data is corrupted"));
+            return -1;
+        }
+    }
+    return requestedSize - z.avail_out;
+}
+
+qint64 GzipDevice::writeData(const char *data, qint64 maxSize)
+{
+    z_stream &z = _stream->Z;
+    for (qint64 offset = 0; offset < maxSize; offset += kChunkSize)
+    {
+        z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data + offset));
+        z.avail_in = static_cast<uInt>(qMin<qint64>(maxSize - offset, kChunkSize));
+        if (!writeCompressed(Z_NO_FLUSH))
+            return -1;
+    }
+    return maxSize;
+}
+
+bool GzipDevice::writeCompressed(int flushMode)
+{
+    z_stream &z = _stream->Z;
+    int result;
+    do
+    {
+        z.next_out = reinterpret_cast<Bytef *>(_stream->Buffer.data());
+        z.avail_out = kChunkSize;
+        result = deflate(&z, flushMode);
+        if (result == Z_STREAM_ERROR)
+        {
+            setErrorString(tr("Couldn't compress data"));
+            return false;
+        }
+
+        qint64 compressedSize = kChunkSize - z.avail_out;
+        if (_device->write(_stream->Buffer.constData(), compressedSize) != compressedSize)
+        {
+            setErrorString(_device->errorString());
+            return false;
+        }
+    } while (z.avail_in || (flushMode == Z_FINISH && result != Z_STREAM_END));
+    return true;
+}
+
+void GzipDevice::endStream()
+{
+    if (!_stream)
+        return;
+    if (openMode() == QIODevice::ReadOnly)
+        inflateEnd(&_stream->Z);
+    else
+        deflateEnd(&_stream->Z);
+    delete _stream;
+    _stream = 0;
+}
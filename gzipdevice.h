@@ -0,0 +1,39 @@
+#ifndef GZIPDEVICE_H
+#define GZIPDEVICE_H
+
+#include <QIODevice>
+
+
+// reads or writes gzip data through another device without buffering the whole file,
+// so compressed tables are decoded straight into the readers. Plain zlib streams are also accepted for reading
+class GzipDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit GzipDevice(QIODevice *device, QObject *parent = 0);
+    virtual ~GzipDevice();
+
+    virtual bool isSequential() const { return true; }
+    virtual bool open(OpenMode mode); // only ReadOnly or WriteOnly, the underlying device must be opened already
+    virtual void close();
+    virtual bool reset(); // starts decompression from the beginning of the underlying device
+
+    bool finish(); // writes the end of compressed stream, returns false if it couldn't be written
+
+protected:
+    virtual qint64 readData(char *data, qint64 maxSize);
+    virtual qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    struct Stream; // keeps zlib out of the header
+
+    QIODevice *_device;
+    Stream *_stream;
+    bool _isStreamEnded;
+
+    bool writeCompressed(int flushMode);
+    void endStream();
+};
+
+#endif // GZIPDEVICE_H
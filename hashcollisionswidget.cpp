@@ -0,0 +1,85 @@
+#include "hashcollisionswidget.h"
+#include "d2stringtablewidget.h"
+#include "tablesdifferenceswidget.h"
+
+#include <QPainter>
+
+
+static const int kHeatmapColumns = 64, kBucketSize = 4; // in pixels
+static const int kMaxListedKeys = 100;
+
+static bool moreProbesThan(const QPair<int, int> &a, const QPair<int, int> &b) // <probes, row>
+{
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+
+HashCollisionsWidget::HashCollisionsWidget(QWidget *parent) : QWidget(parent)
+{
+    ui.setupUi(this);
+    setWindowFlags(Qt::Tool);
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    connect(ui.refreshButton, SIGNAL(clicked()), SLOT(refreshButtonClicked()));
+}
+
+void HashCollisionsWidget::showCollisionsOf(D2StringTableWidget *tableWidget)
+{
+    ui.heatmapLabel->clear();
+
+    int n = tableWidget->rowCount();
+    if (!n)
+    {
+        TablesDifferencesWidget::replaceListedRows(ui.keysListWidget, QStringList());
+        ui.statsLabel->setText(tr("Table is empty"));
+        return;
+    }
+
+    QVector<int> buckets, probes;
+    tableWidget->keyHashTablePlacement(&buckets, &probes);
+
+    QVector<bool> isHomeBucket(n, false);
+    QList<QPair<int, int> > probedRows;
+    int maxProbes = 0, homeBucketsNumber = 0;
+    qint64 totalProbes = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        int homeBucket = tableWidget->keyHash(i);
+        if (!isHomeBucket.at(homeBucket))
+        {
+            isHomeBucket[homeBucket] = true;
+            homeBucketsNumber++;
+        }
+
+        int p = probes.at(i);
+        maxProbes = qMax(maxProbes, p);
+        totalProbes += p;
+        if (p)
+            probedRows += qMakePair(p, i);
+    }
+    ui.statsLabel->setText(tr("%1 keys, %2 distinct hash values\nmax probes: %3, average: %4").arg(n).arg(homeBucketsNumber)
+                           .arg(maxProbes).arg(double(totalProbes) / n, 0, 'f', 2));
+
+    // each bucket is colored from green to red by the number of probes needed to find its key
+    QImage heatmap(kHeatmapColumns * kBucketSize, ((n + kHeatmapColumns - 1) / kHeatmapColumns) * kBucketSize, QImage::Format_RGB32);
+    heatmap.fill(Qt::black);
+    QPainter painter(&heatmap);
+    for (int i = 0; i < n; ++i)
+    {
+        int bucket = buckets.at(i), hue = maxProbes ? 120 - 120 * probes.at(i) / maxProbes : 120;
+        painter.fillRect((bucket % kHeatmapColumns) * kBucketSize, (bucket / kHeatmapColumns) * kBucketSize, kBucketSize, kBucketSize, QColor::fromHsv(hue, 255, 220));
+    }
+    painter.end();
+    ui.heatmapLabel->setPixmap(QPixmap::fromImage(heatmap));
+
+    qSort(probedRows.begin(), probedRows.end(), moreProbesThan);
+    QStringList worstKeys;
+    for (int i = 0, listed = qMin(probedRows.size(), kMaxListedKeys); i < listed; ++i)
+    {
+        int row = probedRows.at(i).second;
+        QTableWidgetItem *keyItem = tableWidget->item(row, 0);
+        // row number must be first to navigate to it
+        worstKeys += QString("%1 (0x%2): ").arg(row + 1).arg(row + 1, 0, 16) + tr("%1 probes, %2").arg(probedRows.at(i).first).arg(keyItem ? keyItem->text() : QString());
+    }
+    TablesDifferencesWidget::replaceListedRows(ui.keysListWidget, worstKeys);
+}
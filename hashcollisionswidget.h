@@ -0,0 +1,30 @@
+#ifndef HASHCOLLISIONSWIDGET_H
+#define HASHCOLLISIONSWIDGET_H
+
+#include "ui_hashcollisionswidget.h"
+
+
+class D2StringTableWidget;
+
+class HashCollisionsWidget : public QWidget // shows how keys are placed in the hash table of *.tbl
+{
+    Q_OBJECT
+
+public:
+    explicit HashCollisionsWidget(QWidget *parent);
+
+    QListWidget *listWidget() const { return ui.keysListWidget; }
+
+    void showCollisionsOf(D2StringTableWidget *tableWidget);
+
+signals:
+    void refreshRequested(HashCollisionsWidget *w);
+
+private slots:
+    void refreshButtonClicked() { emit refreshRequested(this); }
+
+private:
+    Ui::HashCollisionsWidget ui;
+};
+
+#endif // HASHCOLLISIONSWIDGET_H
@@ -1,15 +1,257 @@
 #include <QApplication>
 
 #include <QTranslator>
+#include <QFile>
+#include <QBuffer>
+#include <QElapsedTimer>
+
+#include <cstdio>
 
 #include "qtbleditor.h"
+#include "d2stringtablewidget.h"
+#include "tableedithistory.h"
+#include "tablerowview.h"
+#include "tablefile.h"
+#include "batchreplace.h"
+#include "selftests.h"
+#include "timing.h"
+
+// --convert <input> <output> [<input> <output>...]: converts tables without showing the window.
+// Input can be inside an MPQ archive, e.g. "patch_d2.mpq/data/local/lng/eng/patchstring.tbl".
+// Output format is chosen by extension (*.gz is compressed), options are the same as in the editor
+static int convertTables(const QStringList &fileNames)
+{
+    if (fileNames.isEmpty() || fileNames.size() % 2)
+    {
+        fprintf(stderr, "usage: QTblEditor --convert <input> <output> [<input> <output>...]\n");
+        return 2;
+    }
+
+    TableFormatOptions options = TableFormatOptions::fromSettings();
+    int failedCount = 0;
+    for (int i = 0; i < fileNames.size(); i += 2)
+    {
+        const QString &inputFileName = fileNames.at(i), &outputFileName = fileNames.at(i + 1);
+        KeyValuePairList entries;
+        QString errorString;
+        bool isConverted = readTableFile(inputFileName, &entries, &errorString);
+        QByteArray bytes;
+        if (isConverted)
+            isConverted = tableFileBytes(entries, outputFileName, options, &bytes, &errorString) && writeTableFile(outputFileName, bytes, &errorString);
+        if (!isConverted)
+        {
+            fprintf(stderr, "%s\n", qPrintable(errorString));
+            failedCount++;
+        }
+    }
+    return failedCount ? 1 : 0;
+}
+
+// --replace <find> <replacement> [--regexp] [--case-sensitive] [--exact] [--keys] [--dry-run] <files...>:
+// the same as "Replace in files" without the window, counts are printed for every file
+static int replaceInFiles(const QStringList &arguments)
+{
+    BatchReplaceSpec spec;
+    QStringList fileNames;
+    bool isDryRun = false;
+    for (int i = 2; i < arguments.size(); i++)
+    {
+        const QString &argument = arguments.at(i);
+        if (argument == "--regexp")
+            spec.IsRegExp = true;
+        else if (argument == "--case-sensitive")
+            spec.IsCaseSensitive = true;
+        else if (argument == "--exact")
+            spec.IsExactMatch = true;
+        else if (argument == "--keys")
+            spec.IsInKeys = true;
+        else if (argument == "--dry-run")
+            isDryRun = true;
+        else
+            fileNames += argument;
+    }
+    spec.Query = arguments.value(0);
+    spec.Replacement = arguments.value(1);
+
+    QString errorString;
+    if (arguments.size() < 2 || fileNames.isEmpty())
+    {
+        fprintf(stderr, "usage: QTblEditor --replace <find> <replacement> [--regexp] [--case-sensitive] [--exact] [--keys] [--dry-run] <files...>\n");
+        return 2;
+    }
+    if (!BatchReplace::isSpecValid(spec, &errorString))
+    {
+        fprintf(stderr, "%s\n", qPrintable(errorString));
+        return 2;
+    }
+
+    QList<BatchReplaceResult> results = BatchReplace::start(fileNames, spec).results();
+    bool hasErrors = false;
+    foreach (const BatchReplaceResult &result, results)
+    {
+        if (result.ErrorString.isEmpty())
+            printf("%s: %d row(s), %d occurrence(s)\n", qPrintable(result.FileName), result.ChangedRowsCount, result.OccurrencesCount);
+        else
+        {
+            fprintf(stderr, "%s: %s\n", qPrintable(result.FileName), qPrintable(result.ErrorString));
+            hasErrors = true;
+        }
+    }
+    if (!isDryRun && !BatchReplace::writeResults(results, TableFormatOptions::fromSettings(), &errorString))
+    {
+        fprintf(stderr, "%s\n", qPrintable(errorString));
+        return 1;
+    }
+    return hasErrors ? 1 : 0;
+}
+
+// --benchmark-decode <tbl> [<repeats>]: decodes the table from memory several times and prints the throughput
+// and memory taken by decoded entries
+static int benchmarkDecoding(const QStringList &arguments)
+{
+    QFile file(arguments.value(0));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        fprintf(stderr, "usage: QTblEditor --benchmark-decode <tbl> [<repeats>]\n");
+        return 2;
+    }
+    QByteArray bytes = file.readAll();
+    int repeats = qMax(arguments.value(1, "10").toInt(), 1);
+
+    QElapsedTimer timer;
+    timer.start();
+    int invalidRowsCount = 0;
+    KeyValuePairList entries;
+    for (int i = 0; i < repeats; i++)
+    {
+        QBuffer buffer(&bytes);
+        buffer.open(QIODevice::ReadOnly);
+        entries.clear();
+        QList<int> invalidUtf8Rows;
+        QString errorString;
+        if (!readTblFile(&buffer, &entries, &errorString, &invalidUtf8Rows))
+        {
+            fprintf(stderr, "%s\n", qPrintable(errorString));
+            return 1;
+        }
+        invalidRowsCount = invalidUtf8Rows.size();
+    }
+    double seconds = qMax(timer.elapsed(), qint64(1)) / 1000.0;
+    printf("%d rows, %d with invalid UTF-8, %.2f ms per table, %.1f MB/s\n", entries.size(), invalidRowsCount,
+           seconds * 1000 / repeats, bytes.size() * double(repeats) / seconds / (1024 * 1024));
+    // the file is decoded in place, so this is close to peak memory of loading besides the file itself
+    printf("file: %.1f KB, decoded entries: %.1f KB\n", bytes.size() / 1024.0, entriesMemoryUsage(entries) / 1024.0);
+    return 0;
+}
+
+// --benchmark-row-view [<rows>] [<trace file>]: sorts and filters a generated table (60000 rows by default) the same way
+// View menu does and prints how long each change takes, phases are written to the trace file if it's given
+static int benchmarkRowView(const QStringList &arguments)
+{
+    int rowCount = qMax(arguments.value(0, "60000").toInt(), 1);
+    QString traceFileName = arguments.value(1);
+    Timing::setEnabled(!traceFileName.isEmpty());
+
+    // keys and strings are in different orders, every third string is empty
+    D2StringTableWidget tableWidget;
+    tableWidget.editHistory()->setEnabled(false);
+    tableWidget.setRowCount(rowCount);
+    for (int i = 0; i < rowCount; i++)
+        tableWidget.createNewEntry(i, QString("key%1").arg(qint64(i) * 7919 % rowCount), i % 3 ? QString("string %1").arg(rowCount - i) : QString());
+
+    struct ViewChange
+    {
+        const char *Name;
+        TableRowView::SortOrder Order;
+        bool IsDescending;
+        TableRowView::Filter Filter;
+    };
+    static const ViewChange viewChanges[] =
+    {
+        {"sort by key", TableRowView::ByKey, false, TableRowView::AllRows},
+        {"sort by string, descending", TableRowView::ByString, true, TableRowView::AllRows},
+        {"sort by key hash", TableRowView::ByKeyHash, false, TableRowView::AllRows},
+        {"show empty strings", TableRowView::ByKeyHash, false, TableRowView::EmptyStrings},
+        {"show all rows", TableRowView::ByKeyHash, false, TableRowView::AllRows},
+        {"file order", TableRowView::FileOrder, false, TableRowView::AllRows},
+    };
+
+    TableRowView *rowView = tableWidget.rowView();
+    for (size_t i = 0; i < sizeof(viewChanges) / sizeof(viewChanges[0]); i++)
+    {
+        const ViewChange &change = viewChanges[i];
+        QElapsedTimer timer;
+        timer.start();
+        if (change.Order != rowView->sortOrder() || change.IsDescending != rowView->isDescending())
+            rowView->setSortOrder(change.Order, change.IsDescending);
+        if (change.Filter != rowView->filter())
+            rowView->setFilter(change.Filter);
+        printf("%-28s %8.1f ms, %d rows shown\n", change.Name, timer.nsecsElapsed() / 1e6, rowView->visibleRowsCount());
+    }
+
+    if (!traceFileName.isEmpty())
+        Timing::writeChromeTrace(traceFileName);
+    return 0;
+}
+
+// --check-key-codec: self-check of the lookup tables used for keys, differences from QTextCodec are printed
+static int checkKeyCodec()
+{
+    if (!TblStructure::isKeyCodecCorrect())
+    {
+        fprintf(stderr, "key codec differs from QTextCodec\n");
+        return 1;
+    }
+    printf("key codec matches QTextCodec\n");
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    QCoreApplication::setOrganizationName("kambala");
+    QCoreApplication::setApplicationName("QTblEditor");
+    QCoreApplication::setApplicationVersion("1.3.1");
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!qstrcmp(argv[i], "--convert")) // no GUI is needed
+        {
+            QCoreApplication app(argc, argv);
+            return convertTables(app.arguments().mid(i + 1));
+        }
+        if (!qstrcmp(argv[i], "--replace"))
+        {
+            QCoreApplication app(argc, argv);
+            return replaceInFiles(app.arguments().mid(i + 1));
+        }
+        if (!qstrcmp(argv[i], "--benchmark-decode"))
+        {
+            QCoreApplication app(argc, argv);
+            return benchmarkDecoding(app.arguments().mid(i + 1));
+        }
+        if (!qstrcmp(argv[i], "--benchmark-row-view")) // the table widget needs GUI, but the window isn't shown
+        {
+            QApplication app(argc, argv);
+            return benchmarkRowView(app.arguments().mid(i + 1));
+        }
+        if (!qstrcmp(argv[i], "--check-key-codec"))
+        {
+            QCoreApplication app(argc, argv);
+            return checkKeyCodec();
+        }
+        if (!qstrcmp(argv[i], "--test-upload"))
+        {
+            QCoreApplication app(argc, argv);
+            return testUpload();
+        }
+        if (!qstrcmp(argv[i], "--test-mpq"))
+        {
+            QCoreApplication app(argc, argv);
+            return testMpqArchives(app.arguments().value(i + 1));
+        }
+    }
+
     QApplication app(argc, argv);
-    app.setOrganizationName("kambala");
-    app.setApplicationName("QTblEditor");
-    app.setApplicationVersion("1.3.1");
 #ifdef Q_OS_MAC
     app.setAttribute(Qt::AA_DontShowIconsInMenus);
 #endif
@@ -30,8 +272,20 @@ int main(int argc, char *argv[])
     app.installTranslator(&myappTranslator);
 
 
+    // --trace <file>: timings of the whole session are written to file on exit
+    QString traceFileName;
+    int traceArgumentIndex = app.arguments().indexOf("--trace");
+    if (traceArgumentIndex != -1)
+    {
+        traceFileName = app.arguments().value(traceArgumentIndex + 1);
+        Timing::setEnabled(!traceFileName.isEmpty());
+    }
+
     QTblEditor w;
     w.show();
 
-    return app.exec();
+    int result = app.exec();
+    if (!traceFileName.isEmpty())
+        Timing::writeChromeTrace(traceFileName);
+    return result;
 }
@@ -0,0 +1,483 @@
+#include "mpqarchive.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QDir>
+#include <QtEndian>
+
+#ifdef QTBLEDITOR_QT_ZLIB
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+
+
+static const DWORD kHeaderId = 0x1A51504D, kUserDataId = 0x1B51504D; // "MPQ\x1A", "MPQ\x1B"
+static const DWORD kNoBlock = 0xFFFFFFFF, kDeletedBlock = 0xFFFFFFFE;
+static const DWORD kFileImplode = 0x00000100, kFileCompress = 0x00000200, kFileEncrypted = 0x00010000, kFileFixKey = 0x00020000,
+                   kFileSingleUnit = 0x01000000, kFileExists = 0x80000000;
+static const uchar kCompressionZlib = 0x02, kCompressionPkware = 0x08;
+enum HashType {HashTableOffset, HashNameA, HashNameB, HashFileKey};
+
+
+// encryption and name hashes share the same table
+struct CryptTable
+{
+    DWORD Values[0x500];
+
+    CryptTable()
+    {
+        DWORD seed = 0x00100001;
+        for (int i = 0; i < 0x100; i++)
+        {
+            for (int j = i; j < 0x500; j += 0x100)
+            {
+                seed = (seed * 125 + 3) % 0x2AAAAB;
+                DWORD high = (seed & 0xFFFF) << 0x10;
+                seed = (seed * 125 + 3) % 0x2AAAAB;
+                Values[j] = high | (seed & 0xFFFF);
+            }
+        }
+    }
+};
+static const CryptTable cryptTable; // built before main(), so archives can be read from any thread
+
+static DWORD hashString(const QByteArray &s, HashType type)
+{
+    DWORD seed1 = 0x7FED7FED, seed2 = 0xEEEEEEEE;
+    for (int i = 0; i < s.size(); i++)
+    {
+        uchar c = s.at(i);
+        if (c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        else if (c == '/')
+            c = '\\';
+        seed1 = cryptTable.Values[type * 0x100 + c] ^ (seed1 + seed2);
+        seed2 = c + seed1 + seed2 + (seed2 << 5) + 3;
+    }
+    return seed1;
+}
+
+static void decrypt(QByteArray *data, DWORD key)
+{
+    DWORD seed = 0xEEEEEEEE;
+    uchar *p = reinterpret_cast<uchar *>(data->data());
+    for (int i = 0; i + 4 <= data->size(); i += 4) // trailing bytes aren't encrypted
+    {
+        seed += cryptTable.Values[0x400 + (key & 0xFF)];
+        DWORD value = qFromLittleEndian<quint32>(p + i) ^ (key + seed);
+        key = ((~key << 0x15) + 0x11111111) | (key >> 0x0B);
+        seed = value + seed + (seed << 5) + 3;
+        qToLittleEndian<quint32>(value, p + i);
+    }
+}
+
+static DWORD dwordAt(const QByteArray &data, int i)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(data.constData()) + i * 4);
+}
+
+
+// PKWare Data Compression Library "implode" format used by Diablo II archives,
+// the decoder follows blast.c by Mark Adler from zlib's contrib
+static const int kMaxCodeBits = 13;
+
+struct HuffmanCode
+{
+    short Count[kMaxCodeBits + 1]; // number of symbols of each length
+    short Symbol[256]; // symbols ordered by code
+
+    // code lengths are run-length coded: low nibble is the length, high nibble + 1 is the number of symbols
+    HuffmanCode(const uchar *lengths, int size)
+    {
+        short symbolLengths[256], offsets[kMaxCodeBits + 1];
+        int n = 0;
+        for (int i = 0; i < size; i++)
+            for (int repeats = (lengths[i] >> 4) + 1; repeats; repeats--)
+                symbolLengths[n++] = lengths[i] & 15;
+
+        for (int len = 0; len <= kMaxCodeBits; len++)
+            Count[len] = 0;
+        for (int i = 0; i < n; i++)
+            Count[symbolLengths[i]]++;
+        offsets[1] = 0;
+        for (int len = 1; len < kMaxCodeBits; len++)
+            offsets[len + 1] = offsets[len] + Count[len];
+        for (int i = 0; i < n; i++)
+            if (symbolLengths[i])
+                Symbol[offsets[symbolLengths[i]]++] = i;
+    }
+};
+
+static const uchar kLiteralLengths[] =
+{
+    11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8, 9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
+    7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12, 8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
+    44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45, 44, 173
+};
+static const uchar kLengthLengths[] = {2, 35, 36, 53, 38, 23};
+static const uchar kDistanceLengths[] = {2, 20, 53, 230, 247, 151, 248};
+static const short kLengthBase[16] = {3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264};
+static const char kLengthExtraBits[16] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+static const int kEndLength = 519;
+
+static const HuffmanCode literalCode(kLiteralLengths, sizeof(kLiteralLengths)), lengthCode(kLengthLengths, sizeof(kLengthLengths)),
+                         distanceCode(kDistanceLengths, sizeof(kDistanceLengths));
+
+class Exploder
+{
+public:
+    Exploder(const QByteArray &input) : _input(reinterpret_cast<const uchar *>(input.constData())), _inputSize(input.size()), _position(0),
+        _bitBuffer(0), _bitCount(0), _isOutOfInput(false) {}
+
+    bool explode(QByteArray *output, int outputSize)
+    {
+        int isLiteralCoded = bits(8), dictionaryBits = bits(8);
+        if (isLiteralCoded > 1 || dictionaryBits < 4 || dictionaryBits > 6)
+            return false;
+
+        output->resize(outputSize);
+        char *out = output->data();
+        int written = 0;
+        while (written < outputSize)
+        {
+            if (bits(1)) // match
+            {
+                int symbol = decode(lengthCode);
+                if (symbol < 0)
+                    return false;
+                int length = kLengthBase[symbol] + bits(kLengthExtraBits[symbol]);
+                if (length == kEndLength)
+                    break;
+
+                symbol = length == 2 ? 2 : dictionaryBits;
+                int distance = decode(distanceCode);
+                if (distance < 0)
+                    return false;
+                distance = (distance << symbol) + bits(symbol) + 1;
+                if (_isOutOfInput || distance > written || length > outputSize - written)
+                    return false;
+                for (; length; length--, written++) // regions can overlap
+                    out[written] = out[written - distance];
+            }
+            else
+            {
+                int symbol = isLiteralCoded ? decode(literalCode) : bits(8);
+                if (symbol < 0 || _isOutOfInput)
+                    return false;
+                out[written++] = char(symbol);
+            }
+        }
+        return written == outputSize;
+    }
+
+private:
+    const uchar *_input;
+    int _inputSize, _position, _bitBuffer, _bitCount;
+    bool _isOutOfInput;
+
+    int bits(int count) // least significant bits first
+    {
+        int value = _bitBuffer;
+        while (_bitCount < count)
+        {
+            if (_position == _inputSize)
+            {
+                _isOutOfInput = true;
+                return 0;
+            }
+            value |= int(_input[_position++]) << _bitCount;
+            _bitCount += 8;
+        }
+        _bitBuffer = value >> count;
+        _bitCount -= count;
+        return value & ((1 << count) - 1);
+    }
+
+    int decode(const HuffmanCode &code) // codes are stored with inverted bits
+    {
+        int value = 0, first = 0, index = 0;
+        for (int len = 1; len <= kMaxCodeBits; len++)
+        {
+            value |= bits(1) ^ 1;
+            if (_isOutOfInput)
+                return -1;
+            int count = code.Count[len];
+            if (value < first + count)
+                return code.Symbol[index + value - first];
+            index += count;
+            first = (first + count) << 1;
+            value <<= 1;
+        }
+        return -1;
+    }
+};
+
+
+bool MpqArchive::open(const QString &fileName)
+{
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::ReadOnly))
+    {
+        _errorString = _file.errorString();
+        return false;
+    }
+
+    // header is aligned to 512 bytes and can be preceded by anything, e.g. an installer
+    QByteArray header;
+    for (qint64 offset = 0; offset + 32 <= _file.size(); offset += 512)
+    {
+        _file.seek(offset);
+        header = _file.read(32);
+        if (header.size() == 32 && dwordAt(header, 0) == kUserDataId)
+        {
+            offset += dwordAt(header, 2);
+            _file.seek(offset);
+            header = _file.read(32);
+        }
+        if (header.size() == 32 && dwordAt(header, 0) == kHeaderId)
+        {
+            _archiveOffset = offset;
+            break;
+        }
+        header.clear();
+    }
+    if (header.isEmpty())
+    {
+        _errorString = QCoreApplication::translate("MpqArchive", "It's not an MPQ archive");
+        return false;
+    }
+
+    _sectorSize = 512 << qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(header.constData()) + 14);
+    QVector<DWORD> hashTable, blockTable;
+    if (!readTable(dwordAt(header, 4), dwordAt(header, 6), "(hash table)", &hashTable) ||
+        !readTable(dwordAt(header, 5), dwordAt(header, 7), "(block table)", &blockTable))
+        return false;
+
+    _hashTable.resize(hashTable.size() / 4);
+    for (int i = 0; i < _hashTable.size(); i++)
+    {
+        HashEntry &entry = _hashTable[i];
+        entry.NameA = hashTable.at(i * 4);
+        entry.NameB = hashTable.at(i * 4 + 1);
+        entry.Locale = hashTable.at(i * 4 + 2) & 0xFFFF;
+        entry.Platform = hashTable.at(i * 4 + 2) >> 16;
+        entry.BlockIndex = hashTable.at(i * 4 + 3);
+    }
+    _blockTable.resize(blockTable.size() / 4);
+    for (int i = 0; i < _blockTable.size(); i++)
+    {
+        BlockEntry &entry = _blockTable[i];
+        entry.FilePos = blockTable.at(i * 4);
+        entry.CompressedSize = blockTable.at(i * 4 + 1);
+        entry.FileSize = blockTable.at(i * 4 + 2);
+        entry.Flags = blockTable.at(i * 4 + 3);
+    }
+    return !_hashTable.isEmpty();
+}
+
+bool MpqArchive::readTable(DWORD position, DWORD entriesNumber, const char *key, QVector<DWORD> *table)
+{
+    qint64 size = qint64(entriesNumber) * 16;
+    QByteArray bytes;
+    if (_file.seek(_archiveOffset + position) && size <= _file.size())
+        bytes = _file.read(size);
+    if (bytes.size() != size)
+    {
+        _errorString = QCoreApplication::translate("MpqArchive", "Archive is damaged");
+        return false;
+    }
+
+    decrypt(&bytes, hashString(key, HashFileKey));
+    table->resize(entriesNumber * 4);
+    for (int i = 0; i < table->size(); i++)
+        (*table)[i] = dwordAt(bytes, i);
+    return true;
+}
+
+int MpqArchive::blockIndex(const QString &fileName) const
+{
+    if (_hashTable.isEmpty())
+        return -1;
+
+    QByteArray name = fileName.toLatin1();
+    DWORD nameA = hashString(name, HashNameA), nameB = hashString(name, HashNameB), n = _hashTable.size();
+    for (DWORD i = hashString(name, HashTableOffset) % n, tries = 0; tries < n; i = (i + 1) % n, tries++)
+    {
+        const HashEntry &entry = _hashTable.at(i);
+        if (entry.BlockIndex == kNoBlock)
+            break;
+        if (entry.NameA == nameA && entry.NameB == nameB && entry.BlockIndex != kDeletedBlock &&
+            entry.BlockIndex < DWORD(_blockTable.size()) && (_blockTable.at(entry.BlockIndex).Flags & kFileExists))
+            return entry.BlockIndex;
+    }
+    return -1;
+}
+
+QByteArray MpqArchive::read(const QString &fileName)
+{
+    int index = blockIndex(fileName);
+    if (index == -1)
+    {
+        _errorString = QCoreApplication::translate("MpqArchive", "File \"%1\" isn't found in the archive").arg(fileName);
+        return QByteArray();
+    }
+
+    const BlockEntry &block = _blockTable.at(index);
+    QByteArray data;
+    if (_file.seek(_archiveOffset + block.FilePos) && block.CompressedSize <= _file.size())
+        data = _file.read(block.CompressedSize);
+    if (data.size() != int(block.CompressedSize))
+    {
+        _errorString = QCoreApplication::translate("MpqArchive", "Archive is damaged");
+        return QByteArray();
+    }
+
+    DWORD key = 0;
+    if (block.Flags & kFileEncrypted)
+    {
+        key = hashString(fileName.section('\\', -1).toLatin1(), HashFileKey);
+        if (block.Flags & kFileFixKey)
+            key = (key + block.FilePos) ^ block.FileSize;
+    }
+
+    bool isCompressed = block.Flags & (kFileImplode | kFileCompress);
+    if (block.Flags & kFileSingleUnit)
+    {
+        if (block.Flags & kFileEncrypted)
+            decrypt(&data, key);
+        QByteArray result;
+        if (!isCompressed || block.CompressedSize >= block.FileSize)
+            result = data.left(block.FileSize);
+        else if (!decompressSector(data, block.Flags, block.FileSize, &result))
+            return QByteArray();
+        return result;
+    }
+
+    // file is split into sectors, compressed ones are preceded by the table of their offsets
+    int sectorsNumber = (block.FileSize + _sectorSize - 1) / _sectorSize;
+    QVector<DWORD> sectorOffsets(sectorsNumber + 1);
+    if (isCompressed)
+    {
+        QByteArray offsetsData = data.left(sectorOffsets.size() * 4);
+        if (offsetsData.size() != sectorOffsets.size() * 4)
+        {
+            _errorString = QCoreApplication::translate("MpqArchive", "Archive is damaged");
+            return QByteArray();
+        }
+        if (block.Flags & kFileEncrypted)
+            decrypt(&offsetsData, key - 1);
+        for (int i = 0; i < sectorOffsets.size(); i++)
+            sectorOffsets[i] = dwordAt(offsetsData, i);
+    }
+    else
+    {
+        for (int i = 0; i < sectorsNumber; i++)
+            sectorOffsets[i] = i * _sectorSize;
+        sectorOffsets[sectorsNumber] = block.FileSize;
+    }
+
+    QByteArray result;
+    result.reserve(block.FileSize);
+    for (int i = 0; i < sectorsNumber; i++)
+    {
+        DWORD start = sectorOffsets.at(i), end = sectorOffsets.at(i + 1);
+        int expectedSize = qMin(_sectorSize, block.FileSize - i * _sectorSize);
+        if (start > end || end > DWORD(data.size()))
+        {
+            _errorString = QCoreApplication::translate("MpqArchive", "Archive is damaged");
+            return QByteArray();
+        }
+
+        QByteArray sector = data.mid(start, end - start), decompressedSector;
+        if (block.Flags & kFileEncrypted)
+            decrypt(&sector, key + i);
+        if (!isCompressed || sector.size() >= expectedSize)
+            decompressedSector = sector.left(expectedSize);
+        else if (!decompressSector(sector, block.Flags, expectedSize, &decompressedSector))
+            return QByteArray();
+        result += decompressedSector;
+    }
+    return result;
+}
+
+bool MpqArchive::decompressSector(const QByteArray &sector, DWORD flags, int expectedSize, QByteArray *result)
+{
+    bool isDecompressed = false;
+    if (flags & kFileImplode)
+        isDecompressed = Exploder(sector).explode(result, expectedSize);
+    else
+    {
+        // the first byte tells which methods were used, Diablo II tables need only one of these
+        uchar methods = sector.isEmpty() ? 0 : sector.at(0);
+        QByteArray compressedData = sector.mid(1);
+        if (methods == kCompressionPkware)
+            isDecompressed = Exploder(compressedData).explode(result, expectedSize);
+        else if (methods == kCompressionZlib)
+        {
+            result->resize(expectedSize);
+            uLongf size = expectedSize;
+            isDecompressed = uncompress(reinterpret_cast<Bytef *>(result->data()), &size, reinterpret_cast<const Bytef *>(compressedData.constData()),
+                                        compressedData.size()) == Z_OK && size == uLongf(expectedSize);
+        }
+        else
+        {
+            _errorString = QCoreApplication::translate("MpqArchive", "Unsupported compression method 0x%1").arg(methods, 2, 16, QChar('0'));
+            return false;
+        }
+    }
+
+    if (!isDecompressed)
+        _errorString = QCoreApplication::translate("MpqArchive", "Archive is damaged");
+    return isDecompressed;
+}
+
+QStringList MpqArchive::tableFileNames()
+{
+    QStringList fileNames;
+    QString errorString = _errorString; // (listfile) is optional
+    QList<QByteArray> listedFileNames = read("(listfile)").split('\n');
+    _errorString = errorString;
+    foreach (const QByteArray &listedFileName, listedFileNames)
+    {
+        QString fileName = QString::fromLatin1(listedFileName.trimmed());
+        if (fileName.endsWith(".tbl", Qt::CaseInsensitive) && contains(fileName))
+            fileNames += fileName;
+    }
+
+    // Diablo II archives usually have no list of files
+    static const char *languages[] = {"eng", "deu", "fra", "ita", "esp", "pol", "kor", "chi", "jpn", "por", "rus"};
+    static const char *tableNames[] = {"string", "expansionstring", "patchstring"};
+    for (size_t i = 0; i < sizeof(languages) / sizeof(languages[0]); i++)
+    {
+        for (size_t j = 0; j < sizeof(tableNames) / sizeof(tableNames[0]); j++)
+        {
+            QString fileName = QString("data\\local\\lng\\%1\\%2.tbl").arg(languages[i], tableNames[j]);
+            if (contains(fileName) && !fileNames.contains(fileName, Qt::CaseInsensitive))
+                fileNames += fileName;
+        }
+    }
+    fileNames.sort();
+    return fileNames;
+}
+
+bool MpqArchive::splitPath(const QString &path, QString *archiveFileName, QString *fileName)
+{
+    QString s = QDir::fromNativeSeparators(path);
+    for (int i = s.indexOf(".mpq/", 0, Qt::CaseInsensitive); i != -1; i = s.indexOf(".mpq/", i + 1, Qt::CaseInsensitive))
+    {
+        QString archive = s.left(i + 4);
+        if (QFileInfo(archive).isFile())
+        {
+            *archiveFileName = archive;
+            *fileName = s.mid(i + 5).replace('/', '\\');
+            return true;
+        }
+    }
+    return false;
+}
+
+QString MpqArchive::joinPath(const QString &archiveFileName, const QString &fileName)
+{
+    return archiveFileName + '/' + QString(fileName).replace('\\', '/');
+}
@@ -0,0 +1,53 @@
+#ifndef MPQARCHIVE_H
+#define MPQARCHIVE_H
+
+#include "tblstructure.h"
+
+#include <QFile>
+#include <QStringList>
+#include <QVector>
+
+
+// read-only access to Blizzard MPQ archives as used by Diablo II (format versions 0 and 1).
+// Requested files are decompressed into memory, nothing is extracted to disk.
+// Tables inside an archive are addressed like files in a directory: "path/patch_d2.mpq/data/local/lng/eng/string.tbl"
+class MpqArchive
+{
+public:
+    MpqArchive() : _archiveOffset(0), _sectorSize(0) {}
+
+    bool open(const QString &fileName);
+    bool contains(const QString &fileName) const { return blockIndex(fileName) != -1; }
+    QByteArray read(const QString &fileName); // null on error
+    QStringList tableFileNames(); // *.tbl from (listfile) and from the places where Diablo II keeps them
+    QString errorString() const { return _errorString; }
+
+    // fileName is the path inside the archive with backslashes, as MPQ stores it
+    static bool splitPath(const QString &path, QString *archiveFileName, QString *fileName);
+    static QString joinPath(const QString &archiveFileName, const QString &fileName);
+
+private:
+    struct HashEntry
+    {
+        DWORD NameA, NameB;
+        WORD Locale, Platform;
+        DWORD BlockIndex;
+    };
+    struct BlockEntry
+    {
+        DWORD FilePos, CompressedSize, FileSize, Flags;
+    };
+
+    QFile _file;
+    qint64 _archiveOffset;
+    DWORD _sectorSize;
+    QVector<HashEntry> _hashTable;
+    QVector<BlockEntry> _blockTable;
+    QString _errorString;
+
+    int blockIndex(const QString &fileName) const;
+    bool readTable(DWORD position, DWORD entriesNumber, const char *key, QVector<DWORD> *table);
+    bool decompressSector(const QByteArray &sector, DWORD flags, int expectedSize, QByteArray *result);
+};
+
+#endif // MPQARCHIVE_H
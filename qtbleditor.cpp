@@ -2,6 +2,15 @@
 #include "gotorowdialog.h"
 #include "tablepanelwidget.h"
 #include "findreplacedialog.h"
+#include "batchreplacedialog.h"
+#include "tablemimedata.h"
+#include "tablekeyindex.h"
+#include "tablelint.h"
+#include "stringpool.h"
+#include "tableuploader.h"
+#include "tablejournal.h"
+#include "mpqarchive.h"
+#include "timing.h"
 
 #include <QMainWindow>
 #include <QCloseEvent>
@@ -21,8 +30,12 @@
 #include <QFileInfo>
 #include <QMimeData>
 #include <QDateTime>
+#include <QProgressBar>
+#include <QTimer>
+#include <QFileSystemWatcher>
 
-#include <QNetworkReply>
+#include <QtConcurrentMap>
+#include <QFutureWatcher>
 
 #ifndef QT_NO_DEBUG
 #include <QDebug>
@@ -59,11 +72,12 @@ QString stripSurroundingQuotes(const QString &s)
 extern QList<QChar> colorCodes;
 extern QStringList colorStrings;
 extern QList<QColor> colors;
-extern QString colorHeader;
 extern int colorsNum;
 
-QTblEditor::QTblEditor(QWidget *parent, Qt::WindowFlags flags) : QMainWindow(parent, flags), _openedTables(0), _isTableLoaded(false)
+QTblEditor::QTblEditor(QWidget *parent, Qt::WindowFlags flags) : QMainWindow(parent, flags), _currentTableWidget(0), _isTableLoaded(false), _isSyncingTables(false),
+    _undoMemoryLimit(TableEditHistory::kDefaultMemoryLimit), _sessionWatcher(0), _restoredTablesCount(0)
 {
+    _startupTimer.start();
     ui.setupUi(this);
     ui.mainToolBar->setWindowTitle(tr("Toolbar"));
 
@@ -74,6 +88,8 @@ QTblEditor::QTblEditor(QWidget *parent, Qt::WindowFlags flags) : QMainWindow(par
 #else
     ui.actionGoTo->setShortcut(QKeySequence("Ctrl+G"));
 #endif
+    ui.actionUndo->setShortcut(QKeySequence::Undo);
+    ui.actionRedo->setShortcut(QKeySequence::Redo);
     ui.actionSwap->setShortcut(QKeySequence("Meta+Tab"));
     ui.actionChangeActive->setShortcut(QKeySequence("Tab"));
 
@@ -100,18 +116,30 @@ QTblEditor::QTblEditor(QWidget *parent, Qt::WindowFlags flags) : QMainWindow(par
 #ifndef Q_OS_MAC
     ui.statusBar->addWidget(new QLabel, 1);
 #endif
+    _uploadProgressBar = new QProgressBar(this);
+    _uploadProgressBar->setMaximumWidth(150);
+    _uploadProgressBar->setTextVisible(false);
+    _uploadProgressBar->hide();
+
+    ui.statusBar->addPermanentWidget(_uploadProgressBar);
     ui.statusBar->addPermanentWidget(_keyHashLabel);
     ui.statusBar->addPermanentWidget(_locationLabel);
 
-    _leftTablePanelWidget = new TablePanelWidget(this);
-    _rightTablePanelWidget = new TablePanelWidget(this);
-    _leftTableWidget = _leftTablePanelWidget->tableWidget();
-    _rightTableWidget = _rightTablePanelWidget->tableWidget();
-    _rightTablePanelWidget->hide();
+    _fileWatcher = new QFileSystemWatcher(this);
+    connect(_fileWatcher, SIGNAL(fileChanged(const QString &)), SLOT(tableFileChanged(const QString &)));
+    _reloadTimer = new QTimer(this);
+    _reloadTimer->setSingleShot(true);
+    _reloadTimer->setInterval(500); // tools often write files in several steps
+    connect(_reloadTimer, SIGNAL(timeout()), SLOT(reloadChangedTables()));
+
+    _uploader = new TableUploader(this);
+    connect(_uploader, SIGNAL(progressChanged(qint64, qint64)), SLOT(uploadProgressChanged(qint64, qint64)));
+    connect(_uploader, SIGNAL(finished(bool, const QString &)), SLOT(uploadFinished(bool, const QString &)));
 
+    _keyIndex = new TableKeyIndex(this);
+    _tableLint = new TableLint(this);
+    connect(_tableLint, SIGNAL(issuesChanged()), SLOT(updateTranslationIssuesWidget()));
     _tableSplitter = new QSplitter(Qt::Horizontal, this);
-    _tableSplitter->addWidget(_leftTablePanelWidget);
-    _tableSplitter->addWidget(_rightTablePanelWidget);
     _tableSplitter->setChildrenCollapsible(false);
     setCentralWidget(_tableSplitter);
 
@@ -121,42 +149,46 @@ QTblEditor::QTblEditor(QWidget *parent, Qt::WindowFlags flags) : QMainWindow(par
     _startNumberingGroup->addAction(ui.actionStartNumberingFrom0);
     _startNumberingGroup->addAction(ui.actionStartNumberingFrom1);
 
+    // data of actions is the value of TableRowView::SortOrder or TableRowView::Filter
+    _rowOrderGroup = new QActionGroup(this);
+    QList<QAction *> rowOrderActions = QList<QAction *>() << ui.actionSortByFileOrder << ui.actionSortByKey << ui.actionSortByString
+                                                          << ui.actionSortByLength << ui.actionSortByKeyHash << ui.actionSortByModified;
+    for (int i = 0; i < rowOrderActions.size(); ++i)
+    {
+        rowOrderActions[i]->setData(i);
+        _rowOrderGroup->addAction(rowOrderActions[i]);
+    }
+    _rowFilterGroup = new QActionGroup(this);
+    QList<QAction *> rowFilterActions = QList<QAction *>() << ui.actionShowAllRows << ui.actionShowModifiedRows << ui.actionShowEmptyStrings << ui.actionShowTooLongStrings;
+    for (int i = 0; i < rowFilterActions.size(); ++i)
+    {
+        rowFilterActions[i]->setData(i);
+        _rowFilterGroup->addAction(rowFilterActions[i]);
+    }
 
     connectActions();
 
     connect(ui.menuView, SIGNAL(aboutToShow()), SLOT(updateToolbarStateInMenu()));
 
-    connect(_leftTableWidget, SIGNAL(itemDoubleClicked(QTableWidgetItem *)), SLOT(editString(QTableWidgetItem *)));
-    connect(_leftTableWidget, SIGNAL(currentCellChanged(int, int, int, int)), SLOT(updateLocationLabel(int)));
-    connect(_leftTableWidget, SIGNAL(tableGotFocus(QWidget *)), SLOT(changeCurrentTable(QWidget *)));
-    connect(_leftTableWidget, SIGNAL(itemChanged(QTableWidgetItem *)), SLOT(updateItem(QTableWidgetItem *)));
-
-    connect(_rightTableWidget, SIGNAL(itemDoubleClicked(QTableWidgetItem *)), SLOT(editString(QTableWidgetItem *)));
-    connect(_rightTableWidget, SIGNAL(currentCellChanged(int, int, int, int)), SLOT(updateLocationLabel(int)));
-    connect(_rightTableWidget, SIGNAL(tableGotFocus(QWidget *)), SLOT(changeCurrentTable(QWidget *)));
-    connect(_rightTableWidget, SIGNAL(itemChanged(QTableWidgetItem *)), SLOT(updateItem(QTableWidgetItem *)));
-
-    connect(ui.actionShowHexInRow, SIGNAL(toggled(bool)), _leftTableWidget, SLOT(toggleDisplayHex(bool)));
-    connect(ui.actionShowHexInRow, SIGNAL(toggled(bool)), _rightTableWidget, SLOT(toggleDisplayHex(bool)));
-    connect(ui.actionStartNumberingFrom1, SIGNAL(toggled(bool)), _leftTableWidget, SLOT(changeRowNumberingTo1(bool)));
-    connect(ui.actionStartNumberingFrom1, SIGNAL(toggled(bool)), _rightTableWidget, SLOT(changeRowNumberingTo1(bool)));
-
     connect(_findReplaceDlg, SIGNAL(getStrings(QString, bool, bool, bool)), SLOT(findNextString(QString, bool, bool, bool)));
     connect(_findReplaceDlg, SIGNAL(currentItemChanged(QTableWidgetItem *)), SLOT(changeCurrentTableItem(QTableWidgetItem *)));
     
 
-    _currentTableWidget = _leftTableWidget;
+    // journals are read before the last session is restored, because opening a table starts its journal anew
+    foreach (const QString &journalFileName, TableJournal::abandonedJournals())
+        _abandonedJournals.insert(journalFileName, TableJournal::journalContents(journalFileName));
+
+    // the first panel is always visible, even without a table
+    _currentTableWidget = addTablePanel()->tableWidget();
     readSettings();
     updateRecentFilesActions();
-
-    _leftTableWidget->changeRowHeaderDisplay();
-    _rightTableWidget->changeRowHeaderDisplay();
 }
 
 void QTblEditor::connectActions()
 {
     CONNECT_ACTION_TO_SLOT(ui.actionNew, SLOT(newTable()));
     CONNECT_ACTION_TO_SLOT(ui.actionOpen, SLOT(open()));
+    CONNECT_ACTION_TO_SLOT(ui.actionOpenFromMpq, SLOT(openFromMpq()));
     CONNECT_ACTION_TO_SLOT(ui.actionReopen, SLOT(reopen()));
     CONNECT_ACTION_TO_SLOT(ui.actionSendToServer, SLOT(sendToServer()));
     CONNECT_ACTION_TO_SLOT(ui.actionSave, SLOT(save()));
@@ -165,6 +197,8 @@ void QTblEditor::connectActions()
     CONNECT_ACTION_TO_SLOT(ui.actionClose, SLOT(closeTable()));
     CONNECT_ACTION_TO_SLOT(ui.actionCloseAll, SLOT(closeAll()));
 
+    CONNECT_ACTION_TO_SLOT(ui.actionUndo, SLOT(undo()));
+    CONNECT_ACTION_TO_SLOT(ui.actionRedo, SLOT(redo()));
     CONNECT_ACTION_TO_SLOT(ui.actionChangeText, SLOT(changeText()));
     CONNECT_ACTION_TO_SLOT(ui.actionAppendEntry, SLOT(appendEntry()));
     CONNECT_ACTION_TO_SLOT(ui.actionInsertAfterCurrent, SLOT(insertAfterCurrent()));
@@ -173,10 +207,17 @@ void QTblEditor::connectActions()
     CONNECT_ACTION_TO_SLOT(ui.actionCopy, SLOT(copy()));
     CONNECT_ACTION_TO_SLOT(ui.actionPaste, SLOT(paste()));
     CONNECT_ACTION_TO_SLOT(ui.actionFindReplace, SLOT(showFindReplaceDialog()));
+    CONNECT_ACTION_TO_SLOT(ui.actionReplaceInFiles, SLOT(showBatchReplaceDialog()));
     CONNECT_ACTION_TO_SLOT(ui.actionGoTo, SLOT(goTo()));
+    CONNECT_ACTION_TO_SLOT(ui.actionGoToNextModified, SLOT(goToNextModified()));
+    CONNECT_ACTION_TO_SLOT(ui.actionTooLongStrings, SLOT(showTooLongStrings()));
+    CONNECT_ACTION_TO_SLOT(ui.actionHashCollisions, SLOT(showHashCollisions()));
 
     connect(ui.actionToolbar, SIGNAL(toggled(bool)), ui.mainToolBar, SLOT(setVisible(bool)));
     connect(ui.actionSmallRows, SIGNAL(toggled(bool)), SLOT(toggleRowsHeight(bool)));
+    connect(_rowOrderGroup, SIGNAL(triggered(QAction *)), SLOT(changeRowOrder()));
+    CONNECT_ACTION_TO_SLOT(ui.actionSortDescending, SLOT(changeRowOrder()));
+    connect(_rowFilterGroup, SIGNAL(triggered(QAction *)), SLOT(changeRowFilter()));
 
     CONNECT_ACTION_TO_SLOT(ui.actionSupplement, SLOT(supplement()));
     CONNECT_ACTION_TO_SLOT(ui.actionSwap, SLOT(swapTables()));
@@ -185,7 +226,16 @@ void QTblEditor::connectActions()
     CONNECT_ACTION_TO_SLOT(ui.actionStrings, SLOT(showDifferences()));
     CONNECT_ACTION_TO_SLOT(ui.actionBoth, SLOT(showDifferences()));
     CONNECT_ACTION_TO_SLOT(ui.actionSameStrings, SLOT(showDifferences()));
+    CONNECT_ACTION_TO_SLOT(ui.actionTranslationIssues, SLOT(showTranslationIssues()));
     connect(ui.actionSyncScrolling, SIGNAL(toggled(bool)), SLOT(syncScrollingChanged(bool)));
+    connect(ui.actionSyncByKeys, SIGNAL(toggled(bool)), SLOT(syncScrollingChanged(bool)));
+
+    CONNECT_ACTION_TO_SLOT(ui.actionUndoMemoryLimit, SLOT(changeUndoMemoryLimit()));
+    CONNECT_ACTION_TO_SLOT(ui.actionMemoryUsage, SLOT(showMemoryUsage()));
+    CONNECT_ACTION_TO_SLOT(ui.actionExportTimingTrace, SLOT(exportTimingTrace()));
+    connect(ui.actionRecordTimings, SIGNAL(toggled(bool)), SLOT(recordTimings(bool)));
+    connect(ui.actionCacheTextTables, SIGNAL(toggled(bool)), SLOT(cacheTextTables(bool)));
+    connect(Timing::instance(), SIGNAL(operationTimed(const QString &)), SLOT(showTiming(const QString &)));
 
     CONNECT_ACTION_TO_SLOT(ui.actionAbout, SLOT(aboutApp()));
     connect(ui.actionAboutQt, SIGNAL(triggered()), qApp, SLOT(aboutQt()));
@@ -242,38 +292,20 @@ void QTblEditor::newTable()
 {
     bool okPressed;
     int rowsNum = QInputDialog::getInt(this, tr("New table"), tr("Enter desired number of rows (1-100000):"), 1, 1, 100000, 1, &okPressed);
-    if (okPressed)
+    bool isAdded;
+    if (okPressed && prepareTablePanel(true, &isAdded))
     {
-        bool areTwoTablesOpened = _openedTables == 2;
-        int result = -1;
-        if (_openedTables == 1)
-        {
-            result = openTableMsgBoxResult(); // 0 - add one more, 1 - replace active, rest - cancel
-            if (result != 0 && result != 1)
-                return;
-        }
-        if (result && !currentTablePanelWidget()->absoluteFileName().isEmpty() && !closeTable())
-            return;
-
-        if (!result || (result == -1 && areTwoTablesOpened))
-        {
-            activateAnotherTable();
-            currentTablePanelWidget()->show();
-            inactiveNamedTableWidget(currentTablePanelWidget())->setActive(false);
-            tableMenuSetEnabled(true);
-            closeAllDialogs();
-        }
-
-        if (!_openedTables || (_openedTables == 1 && (!result || result == -1)))
-            _openedTables++;
-
+        currentTablePanelWidget()->clearContents(); // also disables edit history
         _currentTableWidget->setRowCount(rowsNum);
         currentTablePanelWidget()->updateRowCountLabel();
         for (int i = 0; i < rowsNum; i++)
             _currentTableWidget->createNewEntry(i, QString(), QString());
+        _currentTableWidget->editHistory()->setEnabled(true);
         currentTablePanelWidget()->setFilePath(kNewTblFileName);
         currentTablePanelWidget()->setActive(true);
         _currentTableWidget->setCurrentCell(0, 0, QItemSelectionModel::Select);
+        tableMenuSetEnabled(openedTablesCount() > 1);
+        updateLintedTables();
 
         updateWindow();
         enableTableActions(true);
@@ -312,9 +344,38 @@ void QTblEditor::addToRecentFiles(const QString &fileName)
 
 void QTblEditor::open()
 {
-    QString fileName = QFileDialog::getOpenFileName(this, tr("Open table file"), _lastPath,
-        tr("All supported formats (*.tbl *.txt *.csv);;Tbl files (*.tbl);;Tab-delimited txt files (*.txt);;CSV files (*.csv);;All files (*)"));
-    if (!fileName.isEmpty() && loadFile(fileName))
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, tr("Open table file"), _lastPath,
+        tr("All supported formats (*.tbl *.txt *.csv *.tbl.gz *.txt.gz *.csv.gz);;Tbl files (*.tbl);;Tab-delimited txt files (*.txt);;CSV files (*.csv);;"
+           "Compressed tables (*.tbl.gz *.txt.gz *.csv.gz);;All files (*)"));
+    if (fileNames.size() == 1 ? loadFile(fileNames.at(0)) : loadFiles(fileNames) != 0) // several files are always added
+    {
+        foreach (const QString &fileName, fileNames)
+            addToRecentFiles(fileName);
+        _findReplaceDlg->needsRefind();
+    }
+}
+
+void QTblEditor::openFromMpq()
+{
+    QString archiveFileName = QFileDialog::getOpenFileName(this, tr("Open MPQ archive"), _lastPath, tr("MPQ archives (*.mpq);;All files (*)"));
+    if (archiveFileName.isEmpty())
+        return;
+
+    MpqArchive archive;
+    QStringList tableFileNames;
+    if (archive.open(archiveFileName))
+        tableFileNames = archive.tableFileNames();
+    if (tableFileNames.isEmpty())
+    {
+        QString reason = archive.errorString().isEmpty() ? tr("No tables were found in the archive") : archive.errorString();
+        QMessageBox::critical(this, qApp->applicationName(), tr("Error opening file \"%1\"\nReason: %2").arg(QDir::toNativeSeparators(archiveFileName), reason));
+        return;
+    }
+
+    bool isChosen;
+    QString tableFileName = QInputDialog::getItem(this, tr("Open from MPQ"), tr("Table:"), tableFileNames, 0, false, &isChosen);
+    QString fileName = MpqArchive::joinPath(archiveFileName, tableFileName);
+    if (isChosen && loadFile(fileName))
     {
         addToRecentFiles(fileName);
         _findReplaceDlg->needsRefind();
@@ -326,7 +387,7 @@ void QTblEditor::reopen()
     if (processTable(currentTablePanelWidget()->absoluteFileName()))
     {
         updateWindow(false);
-        setWindowModified(_leftTableWidget->isWindowModified() && _rightTableWidget->isWindowModified());
+        setWindowModified(hasModifiedTables());
         updateLocationLabel(_currentTableWidget->currentRow());
     }
 }
@@ -343,291 +404,509 @@ void QTblEditor::sendToServer()
         settings.setValue("serverUrl", url);
     }
 
-    // force wrapping in quotes
-    bool wrapCurrent = ui.actionWrapStrings->isChecked();
-    ui.actionWrapStrings->setChecked(true);
-    QByteArray data;
-    writeAsText(data, false);
-    ui.actionWrapStrings->setChecked(wrapCurrent);
+    if (_uploader->isRunning())
+    {
+        QMessageBox::information(this, qApp->applicationName(), tr("Previous table is still being sent"));
+        return;
+    }
+
+    // entries share strings with the table, so the snapshot is cheap and the table stays editable
+    KeyValuePairList entries;
+    for (int i = 0, n = _currentTableWidget->rowCount(); i < n; ++i)
+        entries += _currentTableWidget->entry(i);
 
-    QNetworkRequest request(QUrl(url + "?name=" + QFileInfo(currentTablePanelWidget()->absoluteFileName()).baseName()));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+    TableUploader::Options options;
+    options.ChunkSize = settings.value("uploadChunkSizeKb", 0).toInt() * 1024;
+    options.IsCompressed = ui.actionCompressUploads->isChecked();
+    _uploader->start(url + "?name=" + QFileInfo(currentTablePanelWidget()->absoluteFileName()).baseName(), entries, options);
 
-    QNetworkAccessManager qnam;
-    QNetworkReply *reply = qnam.post(request, data);
-    QEventLoop eventLoop;
-    connect(reply, SIGNAL(finished()), &eventLoop, SLOT(quit()));
-    eventLoop.exec();
+    _uploadProgressBar->setRange(0, 0);
+    _uploadProgressBar->show();
+    ui.statusBar->showMessage(tr("Sending table..."));
+}
 
-    if (reply->error())
-        QMessageBox::critical(this, tr("Error"), reply->errorString());
+void QTblEditor::uploadProgressChanged(qint64 sentBytes, qint64 totalBytes)
+{
+    if (totalBytes > 0) // busy indicator until the size is known
+    {
+        _uploadProgressBar->setRange(0, 1000);
+        _uploadProgressBar->setValue(1000 * sentBytes / totalBytes);
+    }
+}
+
+void QTblEditor::uploadFinished(bool isSuccess, const QString &response)
+{
+    _uploadProgressBar->hide();
+    ui.statusBar->clearMessage();
+    if (isSuccess)
+        QMessageBox::information(this, tr("Success"), tr("Response:") + "\n" + response);
     else
-        QMessageBox::information(this, tr("Success"), tr("Response:") + "\n" + reply->readAll());
-    reply->deleteLater();
+        QMessageBox::critical(this, tr("Error"), response);
 }
 
 bool QTblEditor::loadFile(const QString &fileName, bool shouldShowOpenOptions)
 {
-    bool areTwoTablesOpened = _openedTables == 2;
-    int result = shouldShowOpenOptions ? -1 : 0;
-    if (_openedTables == 1 && shouldShowOpenOptions)
+    TablePanelWidget *previousPanel = currentTablePanelWidget();
+    bool isAdded;
+    if (!prepareTablePanel(shouldShowOpenOptions, &isAdded))
+        return false;
+
+    TimingSpan span("open table");
+    return finishLoading(loadTableFile(fileName), isAdded, previousPanel);
+}
+
+// files are parsed in parallel, then tables are filled one by one and added to the right
+int QTblEditor::loadFiles(const QStringList &fileNames, const QVariantList &rows)
+{
+    TimingSpan span("open tables");
+    QList<LoadedTable> loadedTables = QtConcurrent::blockingMapped<QList<LoadedTable> >(fileNames, loadTableFile);
+
+    int loadedNumber = 0;
+    for (int i = 0; i < loadedTables.size(); ++i)
     {
-        result = openTableMsgBoxResult(); // 0 - add one more, 1 - replace active, rest - cancel
-        if (result != 0 && result != 1)
-            return false;
+        TablePanelWidget *previousPanel = currentTablePanelWidget();
+        bool isAdded;
+        prepareTablePanel(false, &isAdded);
+        if (finishLoading(loadedTables.at(i), isAdded, previousPanel))
+        {
+            loadedNumber++;
+            if (i < rows.size())
+                _currentTableWidget->setCurrentCell(rows.at(i).toInt(), 1);
+        }
     }
+    return loadedNumber;
+}
 
-    if (result && !currentTablePanelWidget()->absoluteFileName().isEmpty() && !closeTable())
-        return false;
+// makes current the panel where a table will be opened, returns false if user cancelled
+bool QTblEditor::prepareTablePanel(bool shouldShowOpenOptions, bool *isAdded)
+{
+    *isAdded = false;
+    if (!openedTablesCount())
+        return true;
 
-    if (!result || (result == -1 && areTwoTablesOpened))
+    int result = shouldShowOpenOptions ? openTableMsgBoxResult() : 0; // 0 - add one more, 1 - replace active, rest - cancel
+    if (result == 1)
     {
-        activateAnotherTable();
-        currentTablePanelWidget()->show();
+        if (!wasSaved())
+            return false;
+        rememberViewState(currentTablePanelWidget());
         closeAllDialogs();
+        return true;
     }
+    else if (result != 0)
+        return false;
 
-    TablePanelWidget *w = currentTablePanelWidget();
-    if (processTable(fileName))
-    {
-        if (!_openedTables || (_openedTables == 1 && (!result || result == -1)))
-            _openedTables++;
+    TablePanelWidget *w = addTablePanel();
+    w->show();
+    changeCurrentTable(w);
+    closeAllDialogs();
+    *isAdded = true;
+    return true;
+}
 
-        w->setFilePath(fileName);
-        w->setActive(true);
-        w->setWindowModified(false);
+bool QTblEditor::finishLoading(const LoadedTable &table, bool isAdded, TablePanelWidget *previousPanel)
+{
+    if (!processLoadedTable(table))
+    {
+        if (isAdded)
+            discardTablePanel(currentTablePanelWidget(), previousPanel);
+        return false;
+    }
 
-        int row = _lastSelectedRowsHash[QDir::toNativeSeparators(fileName)].toInt();
-        _currentTableWidget->setCurrentCell(row, 1);
-        _currentTableWidget->scrollTo(_currentTableWidget->model()->index(row, 1));
+    TablePanelWidget *w = currentTablePanelWidget();
+    w->setFilePath(table.FileName);
+    w->setActive(true);
+    w->setWindowModified(false);
+
+    TableViewState viewState = _viewStates.value(table.FileName);
+    _currentTableWidget->setCurrentCell(viewState.Row, viewState.Column);
+    if (viewState.ScrollValue >= 0)
+        _currentTableWidget->verticalScrollBar()->setValue(viewState.ScrollValue);
+    else
+        _currentTableWidget->scrollTo(_currentTableWidget->model()->index(viewState.Row, viewState.Column));
 
-        if (_openedTables == 2)
-        {
-            inactiveNamedTableWidget(w)->setActive(false);
-            tableMenuSetEnabled(true);
-        }
+    tableMenuSetEnabled(openedTablesCount() > 1);
+    updateLintedTables();
+    _lastPath = w->fileDirPath();
+    enableTableActions(true);
+    return true;
+}
 
-        _lastPath = w->fileDirPath();
-        enableTableActions(true);
+void QTblEditor::discardTablePanel(TablePanelWidget *w, TablePanelWidget *previousPanel)
+{
+    w->clearContents();
+    w->hide();
+    changeCurrentTable(previousPanel);
+    _currentTableWidget->setFocus();
+}
 
-        return true;
-    }
-    else
+bool QTblEditor::processLoadedTable(const LoadedTable &table)
+{
+    // the current table is left untouched if the file can't be read
+    if (!table.IsLoaded)
     {
-        if (!result || (result == -1 && areTwoTablesOpened))
-        {
-            w->hide();
-            activateAnotherTable();
-        }
+        QMessageBox::critical(this, qApp->applicationName(), table.ErrorString);
         return false;
     }
+
+    TimingSpan span("fill table");
+    _isTableLoaded = false;
+    _currentTableWidget->clearModifiedCells();
+    _currentTableWidget->editHistory()->setEnabled(false);
+    _currentTableWidget->journal()->close();
+    populateTable(table.Entries, _viewStates.value(table.FileName).Row);
+    updateRowViewActions();
+    StringPool::squeeze(); // strings of the replaced table
+    _currentTableWidget->editHistory()->setEnabled(true);
+    _currentTableWidget->journal()->open(table.FileName);
+    _currentTableWidget->rememberSavedEntries();
+    updateWatchedFiles();
+    _isTableLoaded = true;
+
+    if (!table.InvalidUtf8Rows.isEmpty()) // such values will be different after saving
+    {
+        const int kMaxListedRows = 10;
+        int rowOffset = ui.actionStartNumberingFrom1->isChecked() ? 1 : 0;
+        QStringList rows;
+        for (int i = 0; i < qMin(table.InvalidUtf8Rows.size(), kMaxListedRows); i++)
+            rows += QString::number(table.InvalidUtf8Rows.at(i) + rowOffset);
+        if (table.InvalidUtf8Rows.size() > kMaxListedRows)
+            rows += "...";
+        ui.statusBar->showMessage(tr("Invalid UTF-8 was replaced in %n row(s): %1", 0, table.InvalidUtf8Rows.size()).arg(rows.join(", ")), 10000);
+    }
+    return true;
 }
 
-bool QTblEditor::processTable(const QString &fileName)
+void QTblEditor::populateTable(const KeyValuePairList &entries, int firstVisibleRow)
 {
-    _isTableLoaded = false;
+    _currentTableWidget->setRowCount(0);
+    _currentTableWidget->rowView()->reset(); // new contents are shown in file order
+    _currentTableWidget->setRowCount(entries.size());
+    currentTablePanelWidget()->updateRowCountLabel();
 
-    QFile inputFile(fileName);
-    if (inputFile.open(QIODevice::ReadOnly))
     {
-        QString extension = fileName.right(4).toLower();
-        if (extension == ".tbl")
-            return _isTableLoaded = processTblFile(&inputFile);
-        else if (extension == ".txt" || extension == ".csv")
-            return _isTableLoaded = processTxtOrCsvFile(&inputFile);
-        else // arbitrary file opened
+        TimingSpan span("create entries");
+        // rows that will be visible are created and painted first, so a big table appears at once
+        int pageRows = _currentTableWidget->viewport()->height() / qMax(_currentTableWidget->verticalHeader()->defaultSectionSize(), 1) + 1;
+        int firstRow = 0, lastRow = 0;
+        if (_currentTableWidget->isVisible() && entries.size() > 2 * pageRows)
         {
-            QTextStream in(&inputFile);
-            in.readLine();
-            QString secondLine = in.readLine(); // it should equal "X" if it's tbl file
-            inputFile.reset();
-            if (secondLine.contains('\t') || secondLine.contains(';') || secondLine.contains(',')) // text format
-                _isTableLoaded = processTxtOrCsvFile(&inputFile);
-            else // tbl format
-                _isTableLoaded = processTblFile(&inputFile);
+            firstRow = qBound(0, firstVisibleRow - pageRows / 2, entries.size() - pageRows);
+            lastRow = firstRow + pageRows;
+            for (int i = firstRow; i < lastRow; i++)
+                _currentTableWidget->createNewEntry(i, entries.at(i).first, entries.at(i).second);
+            _currentTableWidget->scrollTo(_currentTableWidget->model()->index(qBound(firstRow, firstVisibleRow, lastRow - 1), 1), QAbstractItemView::PositionAtCenter);
+            _currentTableWidget->viewport()->repaint(); // without processing events, user can't touch the rest of rows
         }
+
+        for (int i = 0; i < firstRow; i++)
+            _currentTableWidget->createNewEntry(i, entries.at(i).first, entries.at(i).second);
+        for (int i = lastRow; i < entries.size(); i++)
+            _currentTableWidget->createNewEntry(i, entries.at(i).first, entries.at(i).second);
     }
-    else
+
+    TimingSpan span("measure keys");
+    int maxKeyWidth = 0;
+    QFontMetrics fm(_currentTableWidget->font());
+    foreach (const KeyValuePair &entry, entries)
     {
-        QMessageBox::critical(this, qApp->applicationName(), tr("Error opening file \"%1\"\nReason: %2")
-                              .arg(fileName, inputFile.errorString()));
-        return false;
+        int currentKeyWidth = fm.width(entry.first);
+        if (maxKeyWidth < currentKeyWidth)
+            maxKeyWidth = currentKeyWidth;
     }
-    return _isTableLoaded;
+    _currentTableWidget->setColumnWidth(0, maxKeyWidth + 1); // making "key" column width fit all the entries
 }
 
-bool QTblEditor::processTblFile(QFile *inputFile)
+bool QTblEditor::closeTable()
 {
-    QDataStream in(inputFile);
-    in.setByteOrder(QDataStream::LittleEndian);
-    TblStructure tbl;
-    tbl.fillHeader(in); // reading header
-    DWORD numElem = tbl.header().FileSize - TblHeader::size; // number of bytes to read without header
-    char *table = new char[numElem];
-    if (in.readRawData(table, numElem) == numElem)
-    {
-        delete [] table;
-
-        inputFile->reset(); // current offset for reading = 0x00
-        in.skipRawData(TblHeader::size); // current offset for reading = 0x15 (we don't need header any more)
-        tbl.getStringTable(in);
-        inputFile->close();
+    if (!openedTablesCount())
+        return true;
 
-        int rowCount = tbl.header().NodesNumber;
-        _currentTableWidget->setRowCount(rowCount);
-        currentTablePanelWidget()->updateRowCountLabel();
+    if (wasSaved())
+    {
+        _locationLabel->clear();
+        _keyHashLabel->clear();
+        closeAllDialogs();
+        rememberViewState(currentTablePanelWidget());
 
-        int maxKeyWidth = 0;
-        for (WORD i = 0; i < rowCount; i++)
+        TablePanelWidget *closedPanel = currentTablePanelWidget(), *nextPanel = inactiveNamedTableWidget(closedPanel);
+        closedPanel->clearContents();
+        StringPool::squeeze();
+        updateWatchedFiles();
+        if (nextPanel)
         {
-            QPair<QString, QString> currentDataStrings = tbl.dataStrings(i); // reading pair <key, value>
-            _currentTableWidget->createNewEntry(i, currentDataStrings.first, currentDataStrings.second);
+            closedPanel->hide();
+            changeCurrentTable(nextPanel);
+            _currentTableWidget->setFocus();
 
-            int currentKeyWidth = QFontMetrics(_currentTableWidget->item(i, 0)->font()).width(currentDataStrings.first);
-            if (maxKeyWidth < currentKeyWidth)
-                maxKeyWidth = currentKeyWidth;
+            tableMenuSetEnabled(openedTablesCount() > 1);
+            updateWindow(_currentTableWidget->isWindowModified());
+            ui.actionSaveAll->setEnabled(hasModifiedTables());
+        }
+        else // the last panel stays visible
+        {
+            enableTableActions(false);
+            updateWindow(false);
+            ui.actionSaveAll->setEnabled(false);
         }
-        _currentTableWidget->setColumnWidth(0, maxKeyWidth + 1); // making "key" column width fit all the entries
-
         return true;
     }
-    else
-    {
-        delete [] table;
-        QMessageBox::critical(this, qApp->applicationName(), tr("Couldn't read entire file, read only %n byte(s) after header.\n"
-                                                    "Probably file is corrupted or wrong file format.", 0, numElem));
-        return false;
-    }
+    return false;
 }
 
-bool QTblEditor::processTxtOrCsvFile(QFile *inputFile)
+bool QTblEditor::closeAll(bool hideTable)
 {
-    QList<QByteArray> entries = inputFile->readAll().split('\n'); // TODO: maybe read line by line to improve performance
-    inputFile->close();
-    if (entries.isEmpty())
-        return true;
-
-    int rows = entries.size() - 1; // don't include last empty line
-    _currentTableWidget->setRowCount(rows);
-    currentTablePanelWidget()->updateRowCountLabel();
-
-    QByteArray currentLine = entries.at(0).trimmed();
-    char separator = '\t', wrappingCharKey = '\"', wrappingCharValue = '\"';
-    if (inputFile->fileName().right(4).toLower() == ".csv" || currentLine.contains("\",\"") || currentLine.contains("\";\""))
+    if (!hideTable) // only ask to save modified tables, e.g. when quitting
     {
-        int secondDoubleQuoteIndex = currentLine.indexOf('\"', 1);
-        if (secondDoubleQuoteIndex == -1)
+        foreach (TablePanelWidget *w, openedTablePanels())
         {
-            QMessageBox::critical(this, qApp->applicationName(), tr("Wrong file format - all strings in *.csv should be wrapped in double quotes"));
-            closeTable();
-            return false;
+            changeCurrentTable(w);
+            if (!wasSaved())
+                return false;
         }
-        separator = currentLine.at(secondDoubleQuoteIndex + 1);
+        return true;
     }
-    else
+
+    while (openedTablesCount())
+        if (!closeTable())
+            return false;
+    return true;
+}
+
+void QTblEditor::restoreLastSession()
+{
+    if (_sessionTablePaths.isEmpty())
     {
-        QList<QByteArray> s = currentLine.split(separator);
-        QByteArray currentKey = s.at(0), currentValue = s.at(1);
-        if (!currentKey.startsWith(wrappingCharKey) || !currentKey.endsWith(wrappingCharKey))
-            wrappingCharKey = 0;
-        if (!currentValue.startsWith(wrappingCharValue) || !currentValue.endsWith(wrappingCharValue))
-            wrappingCharValue = 0;
+        lastSessionRestored();
+        return;
     }
 
-    QByteArray keyValueSeparator(1, separator);
-    if (wrappingCharKey)
-        keyValueSeparator.prepend(wrappingCharKey);
-    if (wrappingCharValue)
-        keyValueSeparator.append(wrappingCharValue);
+    _restoredTablesCount = 0;
+    _sessionWatcher = new QFutureWatcher<LoadedTable>(this);
+    connect(_sessionWatcher, SIGNAL(resultReadyAt(int)), SLOT(fillRestoredTables()));
+    connect(_sessionWatcher, SIGNAL(finished()), SLOT(fillRestoredTables()));
+    _sessionWatcher->setFuture(QtConcurrent::mapped(_sessionTablePaths, loadTableFile));
+}
 
-    QString wrappingCharKeyString = wrappingCharKey ? QChar(wrappingCharKey) : QString(), wrappingCharValueString = wrappingCharValue ? QChar(wrappingCharValue) : QString();
-    QString utf8TblEditHeaderString = QString("%1Key%1%2%3Value%3").arg(wrappingCharKeyString, QChar(separator), wrappingCharValueString);
-    QString afj666HeaderString = QString("%1String Index%1%2%3Text%3").arg(wrappingCharKeyString, QChar(separator), wrappingCharValueString);
-    int i = 0;
-    if (currentLine == utf8TblEditHeaderString || currentLine == afj666HeaderString)
+void QTblEditor::fillRestoredTables()
+{
+    if (!_sessionWatcher)
+        return;
+    if (QApplication::activeModalWidget()) // e.g. an open dialog or an error message about one of restored files
     {
-        if (!rows)
-            return true;
-        currentLine = entries.at(++i);
+        QTimer::singleShot(100, this, SLOT(fillRestoredTables()));
+        return;
     }
 
-    int maxKeyWidth = 0;
-    for (; i < rows; currentLine = entries.at(++i))
+    // tables are added in the order of the last session, whichever file was read first
+    QFuture<LoadedTable> future = _sessionWatcher->future();
+    while (_restoredTablesCount < _sessionTablePaths.size() && future.isResultReadyAt(_restoredTablesCount))
     {
-        currentLine = currentLine.trimmed();
-        if (wrappingCharKey)
-            currentLine = currentLine.mid(1); // remove leading wrappingCharKeyString
-        if (wrappingCharValue)
-            currentLine.chop(1); // remove trailing wrappingCharValueString
-
-        int separatorIndex = currentLine.indexOf(keyValueSeparator);
-        if (separatorIndex == -1)
-        {
-            QMessageBox::critical(this, qApp->applicationName(), tr("Wrong file format - separator is absent at line %1").arg(i + 1));
-            closeTable();
-            return false;
-        }
-
-        QString key = restoreNewlines(TblStructure::decodeKey(currentLine.left(separatorIndex)));
-        _currentTableWidget->createNewEntry(i, key, restoreNewlines(QString::fromUtf8(currentLine.mid(separatorIndex + keyValueSeparator.length()))));
+        int i = _restoredTablesCount++;
+        TablePanelWidget *previousPanel = currentTablePanelWidget();
+        bool isAdded;
+        prepareTablePanel(false, &isAdded);
+        if (finishLoading(future.resultAt(i), isAdded, previousPanel) && i < _sessionTableRows.size())
+            _currentTableWidget->setCurrentCell(_sessionTableRows.at(i).toInt(), 1);
+        if (!i)
+            startupFinished();
+    }
 
-        int currentKeyWidth = QFontMetrics(_currentTableWidget->item(i, 0)->font()).width(key);
-        if (maxKeyWidth < currentKeyWidth)
-            maxKeyWidth = currentKeyWidth;
+    if (_restoredTablesCount == _sessionTablePaths.size())
+    {
+        _sessionWatcher->disconnect(this);
+        _sessionWatcher->deleteLater();
+        _sessionWatcher = 0;
+        _sessionTablePaths.clear();
+        _sessionTableRows.clear();
+        lastSessionRestored();
     }
-    _currentTableWidget->setColumnWidth(0, maxKeyWidth + 1);
+}
 
-    return true;
+void QTblEditor::lastSessionRestored()
+{
+    startupFinished();
+    if (!_abandonedJournals.isEmpty())
+        recoverTables();
 }
 
-bool QTblEditor::closeTable(bool hideTable)
+void QTblEditor::startupFinished()
 {
-    if (!_openedTables)
-        return true;
+    if (!_startupTimer.isValid())
+        return;
 
-    if (wasSaved())
-    {
-        _locationLabel->clear();
-        _keyHashLabel->clear();
-        closeAllDialogs();
+    // the first table of the last session is visible or there's nothing to restore
+    qint64 milliseconds = _startupTimer.elapsed();
+    _startupTimer.invalidate();
+    Timing::addCompletedSpan("startup", milliseconds * 1000);
+    if (Timing::isEnabled())
+        ui.statusBar->showMessage(tr("Ready in %1 ms").arg(milliseconds), 5000);
+}
 
-        QString filePath = currentTablePanelWidget()->absoluteFileName();
-        if (filePath != kNewTblFileName)
-            _lastSelectedRowsHash[QDir::toNativeSeparators(filePath)] = _currentTableWidget->currentRow();
+void QTblEditor::recoverTables()
+{
+    // a table that was opened in several panels has a journal for each of them, they are recovered in different panels
+    QStringList journalFileNames = _abandonedJournals.keys(), fileNames;
+    foreach (const QString &journalFileName, journalFileNames)
+        fileNames += TableJournal::tableFileNameOf(_abandonedJournals.value(journalFileName));
+    QStringList listedFileNames = fileNames;
+    listedFileNames.removeDuplicates();
+    if (!isDialogQuestionConfirmed(tr("Unsaved changes of the following tables were found after the previous session had ended unexpectedly:\n%1\n\n"
+                                      "Do you want to recover them?").arg(listedFileNames.join("\n"))))
+    {
+        foreach (const QString &journalFileName, journalFileNames)
+            TableJournal::removeAbandonedJournal(journalFileName);
+        _abandonedJournals.clear();
+        return;
+    }
 
-        if (hideTable || filePath == kNewTblFileName)
+    QList<TablePanelWidget *> recoveredPanels;
+    for (int i = 0; i < journalFileNames.size(); i++)
+    {
+        const QString &fileName = fileNames.at(i);
+        TablePanelWidget *w = 0;
+        foreach (TablePanelWidget *panel, openedTablePanelsOf(fileName))
         {
-            currentTablePanelWidget()->clearContents();
-            _openedTables--;
+            if (!recoveredPanels.contains(panel))
+            {
+                w = panel;
+                break;
+            }
         }
-        if (_openedTables)
+        if (!w && loadFiles(QStringList(fileName)))
+            w = currentTablePanelWidget();
+        if (w)
         {
-            if (hideTable || filePath == kNewTblFileName)
-                currentTablePanelWidget()->hide();
-            activateAnotherTable();
-            currentTablePanelWidget()->setActive(true);
-
-            tableMenuSetEnabled(false);
-            updateWindow(_currentTableWidget->isWindowModified());
-            ui.actionSaveAll->setEnabled(_currentTableWidget->isWindowModified());
+            recoveredPanels += w;
+            changeCurrentTable(w);
+            if (!_currentTableWidget->journal()->replay(_abandonedJournals.value(journalFileNames.at(i))))
+                QMessageBox::warning(this, qApp->applicationName(), tr("Changes of \"%1\" couldn't be recovered").arg(fileName));
+            w->updateRowCountLabel();
+            updateWindow();
+            ui.actionSaveAll->setEnabled(true);
         }
-        else
+        TableJournal::removeAbandonedJournal(journalFileNames.at(i)); // replayed changes are in the journal of the panel
+    }
+    _abandonedJournals.clear();
+}
+
+void QTblEditor::updateWatchedFiles()
+{
+    QStringList fileNames;
+    foreach (TablePanelWidget *w, openedTablePanels())
+        if (w->absoluteFileName() != kNewTblFileName)
+            fileNames += w->absoluteFileName();
+
+    foreach (const QString &fileName, _fileWatcher->files())
+        if (!fileNames.contains(fileName))
+            _fileWatcher->removePath(fileName);
+    foreach (const QString &fileName, fileNames)
+        if (!_fileWatcher->files().contains(fileName) && QFile::exists(fileName))
+            _fileWatcher->addPath(fileName);
+}
+
+void QTblEditor::tableFileChanged(const QString &fileName)
+{
+    if (!_changedFiles.contains(fileName))
+        _changedFiles += fileName;
+    _reloadTimer->start();
+}
+
+void QTblEditor::reloadChangedTables()
+{
+    QStringList changedFiles = _changedFiles;
+    _changedFiles.clear();
+    updateWatchedFiles(); // files replaced by other tools are removed from the watcher
+
+    foreach (const QString &fileName, changedFiles)
+    {
+        QList<TablePanelWidget *> panels = openedTablePanelsOf(fileName);
+        if (panels.isEmpty() || !QFile::exists(fileName))
+            continue;
+
+        LoadedTable table = loadTableFile(fileName);
+        if (!table.IsLoaded)
         {
-            enableTableActions(false);
-            updateWindow(false);
-            ui.actionSaveAll->setEnabled(false);
+            ui.statusBar->showMessage(table.ErrorString, 5000);
+            continue;
         }
-        return true;
+
+        // each panel with the file has its own unsaved changes, so the file is merged into all of them
+        foreach (TablePanelWidget *w, panels)
+            mergeChangedTable(w, table);
     }
-    return false;
+}
+
+void QTblEditor::mergeChangedTable(TablePanelWidget *w, const LoadedTable &table)
+{
+    // selection follows its key, the view stays where it was
+    D2StringTableWidget *tableWidget = w->tableWidget();
+    int currentRow = tableWidget->currentRow(), currentColumn = qMax(tableWidget->currentColumn(), 0);
+    int scrollValue = tableWidget->verticalScrollBar()->value();
+    QString currentKey = currentRow >= 0 ? tableWidget->item(currentRow, 0)->text() : QString();
+
+    int changedRowsCount, conflictsCount;
+    {
+        TimingSpan span("merge file changes");
+        _isTableLoaded = false; // rows taken from the file aren't modifications
+        conflictsCount = tableWidget->mergeEntries(table.Entries, &changedRowsCount);
+        _isTableLoaded = true;
+    }
+
+    // the journal can't be replayed over the new file, so unsaved changes are kept as the whole table
+    tableWidget->journal()->open(table.FileName);
+    if (tableWidget->hasModifiedCells())
+    {
+        tableWidget->journal()->recordSnapshot();
+        tableWidget->editHistory()->resetClean(); // undo can't bring back the new file without unsaved changes
+    }
+    else
+        tableWidget->editHistory()->setClean();
+
+    if (currentRow >= 0 && tableWidget->rowCount())
+    {
+        int row = currentKey.isEmpty() ? -1 : _keyIndex->rowOfKey(currentKey, tableWidget);
+        tableWidget->setCurrentCell(row != -1 ? row : qMin(currentRow, tableWidget->rowCount() - 1), currentColumn);
+    }
+    tableWidget->verticalScrollBar()->setValue(scrollValue);
+    w->updateRowCountLabel();
+    tableWidget->viewport()->update();
+
+    QString message = tr("\"%1\" was changed on disk, rows updated: %2").arg(w->fileName()).arg(changedRowsCount);
+    if (conflictsCount)
+        QMessageBox::warning(this, qApp->applicationName(), message + "\n" +
+                             tr("Conflicting rows that were also changed here: %1. They keep your text and are highlighted in orange.").arg(conflictsCount));
+    else
+        ui.statusBar->showMessage(message, 5000);
+}
+
+QList<TablePanelWidget *> QTblEditor::openedTablePanelsOf(const QString &fileName) const
+{
+    QList<TablePanelWidget *> panels;
+    QString absoluteFileName = QFileInfo(QDir::fromNativeSeparators(fileName)).absoluteFilePath();
+    foreach (TablePanelWidget *w, openedTablePanels())
+        if (QFileInfo(w->absoluteFileName()).absoluteFilePath() == absoluteFileName)
+            panels += w;
+    return panels;
+}
+
+void QTblEditor::rememberViewState(TablePanelWidget *w)
+{
+    QString filePath = w->absoluteFileName();
+    D2StringTableWidget *tableWidget = w->tableWidget();
+    if (!filePath.isEmpty() && filePath != kNewTblFileName)
+        _viewStates.insert(filePath, TableViewState(tableWidget->currentRow(), qMax(tableWidget->currentColumn(), 0), tableWidget->verticalScrollBar()->value()));
 }
 
 void QTblEditor::enableTableActions(bool state)
 {
-    QList<QAction *> actions = QList<QAction *>() << ui.actionSaveAs << ui.actionClose << ui.actionCloseAll << ui.menuEdit->actions() << ui.actionSendToServer;
+    QList<QAction *> actions = QList<QAction *>() << ui.actionSaveAs << ui.actionClose << ui.actionCloseAll << ui.menuEdit->actions() << ui.actionSendToServer
+                                                  << ui.menuSortRows->menuAction() << ui.menuShowRows->menuAction();
     foreach (QAction *action, actions)
         action->setEnabled(state);
     ui.menuEdit->setEnabled(state);
+    if (state)
+        updateUndoActions();
 }
 
 void QTblEditor::closeEvent(QCloseEvent *event)
@@ -635,6 +914,8 @@ void QTblEditor::closeEvent(QCloseEvent *event)
     if (closeAll(false))
     {
         writeSettings();
+        foreach (TablePanelWidget *w, tablePanels()) // unsaved changes were discarded by user
+            w->tableWidget()->journal()->close();
         event->accept();
     }
     else
@@ -665,8 +946,8 @@ bool QTblEditor::wasSaved()
 
 void QTblEditor::save()
 {
-    QString fileName = currentTablePanelWidget()->absoluteFileName();
-    if (fileName == kNewTblFileName)
+    QString fileName = currentTablePanelWidget()->absoluteFileName(), archiveFileName, archivedFileName;
+    if (fileName == kNewTblFileName || MpqArchive::splitPath(fileName, &archiveFileName, &archivedFileName)) // archives are read-only
         saveAs();
     else
         saveFile(fileName);
@@ -683,41 +964,47 @@ void QTblEditor::saveAs()
     }
 #endif
     QString fileNameToSave = QFileDialog::getSaveFileName(this, tr("Save table"), fileName,
-                                                          tr("Tbl files (*.tbl);;Tab-delimited text files (*.txt);;CSV files (*.csv);;All files (*)"));
+                                                          tr("Tbl files (*.tbl);;Tab-delimited text files (*.txt);;CSV files (*.csv);;"
+                                                             "Compressed tbl files (*.tbl.gz);;Compressed text files (*.txt.gz);;Compressed CSV files (*.csv.gz);;All files (*)"));
     if (!fileNameToSave.isEmpty() && saveFile(fileNameToSave))
     {
         // change opened file path only if saving with the same extension
-        if (fileName.right(4) == fileNameToSave.right(4))
+        if (tableFileExtension(fileName) == tableFileExtension(fileNameToSave) && isCompressedTableFile(fileName) == isCompressedTableFile(fileNameToSave))
+        {
             currentTablePanelWidget()->setFilePath(fileNameToSave);
+            updateWatchedFiles();
+        }
         addToRecentFiles(fileNameToSave);
     }
 }
 
 void QTblEditor::saveAll()
 {
-    if (_currentTableWidget->isWindowModified())
-        save();
-    if (_openedTables == 2)
+    TablePanelWidget *currentPanel = currentTablePanelWidget();
+    foreach (TablePanelWidget *w, openedTablePanels())
     {
-        activateAnotherTable();
-        if (_currentTableWidget->isWindowModified())
+        if (w->tableWidget()->isWindowModified())
+        {
+            changeCurrentTable(w);
             save();
-        activateAnotherTable();
+        }
     }
+    changeCurrentTable(currentPanel);
     ui.actionSaveAll->setDisabled(true);
 }
 
 bool QTblEditor::saveFile(const QString &fileName)
 {
+    TimingSpan span("save");
     QByteArray bytesToWrite; // first of all, write everything to buffer
-    QString extension = fileName.right(4);
+    QString extension = tableFileExtension(fileName);
     bool isCsv = extension == ".csv";
 
-    DWORD fileSize;
+    DWORD savedBytes = 0;
     if (extension == ".tbl")
-        fileSize = writeAsTbl(bytesToWrite);
+        writeAsTbl(bytesToWrite, &savedBytes);
     else if (extension == ".txt" || isCsv)
-        fileSize = writeAsText(bytesToWrite, isCsv);
+        writeAsText(bytesToWrite, isCsv);
     else // any file
     {
         QMessageBox msgbox(this);
@@ -731,176 +1018,105 @@ bool QTblEditor::saveFile(const QString &fileName)
         switch (msgbox.exec())
         {
         case 0: // tbl
-            fileSize = writeAsTbl(bytesToWrite);
+            writeAsTbl(bytesToWrite, &savedBytes);
             break;
         case 1: // txt
-            fileSize = writeAsText(bytesToWrite, false);
+            writeAsText(bytesToWrite, false);
             break;
         case 2: // csv
-            fileSize = writeAsText(bytesToWrite, true);
+            writeAsText(bytesToWrite, true);
             break;
         }
     }
 
-    QFile output(fileName);
-    if (output.open(QIODevice::WriteOnly))
+    _fileWatcher->removePath(fileName); // it's not a change made by somebody else
+    QString errorString;
+    if (writeTableFile(fileName, bytesToWrite, &errorString))
     {
-        if (output.write(bytesToWrite) == fileSize)
-        {
-            _currentTableWidget->clearBackground();
-            _lastPath = QFileInfo(fileName).canonicalPath();
-            if (_openedTables == 1 || !inactiveNamedTableWidget(currentTablePanelWidget())->tableWidget()->isWindowModified())
-                ui.actionSaveAll->setDisabled(true);
-
-            updateWindow(false);
-            ui.statusBar->showMessage(tr("File \"%1\" successfully saved").arg(QDir::toNativeSeparators(fileName)), 3000);
+        _currentTableWidget->clearModifiedCells();
+        _currentTableWidget->editHistory()->setClean();
+        _currentTableWidget->journal()->open(fileName); // changes are in the file now
+        _currentTableWidget->rememberSavedEntries();
+        _lastPath = QFileInfo(fileName).canonicalPath();
 
-            return true;
-        }
-        else
-            QMessageBox::critical(this, qApp->applicationName(), tr("Error writing file \"%1\"\nReason: %2").arg(QDir::toNativeSeparators(fileName), output.errorString()));
+        updateWindow(false);
+        if (!hasModifiedTables())
+            ui.actionSaveAll->setDisabled(true);
+        QString message = tr("File \"%1\" successfully saved").arg(QDir::toNativeSeparators(fileName));
+        if (savedBytes)
+            message += ", " + tr("%1 bytes saved by sharing identical strings").arg(savedBytes);
+        ui.statusBar->showMessage(message, 3000);
+
+        updateWatchedFiles();
+        return true;
     }
-    else
-        QMessageBox::critical(this, qApp->applicationName(), tr("Error creating file \"%1\"\nReason: %2").arg(QDir::toNativeSeparators(fileName), output.errorString()));
+    QMessageBox::critical(this, qApp->applicationName(), errorString);
+    updateWatchedFiles();
     return false;
 }
 
-DWORD QTblEditor::writeAsTbl(QByteArray &bytesToWrite)
+DWORD QTblEditor::writeAsTbl(QByteArray &bytesToWrite, DWORD *savedBytes)
 {
-    int entriesNumber = _currentTableWidget->rowCount();
-    QStringList stringValsWithModifiedColors; // replacing user-readable colors with their internal form
-    for (WORD i = 0; i < entriesNumber; i++)
-    {
-        QString currentVal = _currentTableWidget->item(i, 1)->text();
-        for (int j = 0; j < colorStrings.size(); j++)
-        {
-            if (currentVal.contains(colorStrings.at(j)) && j)
-                currentVal.replace(colorStrings.at(j), colorHeader + colorCodes.at(j - 1));
-            else
-                currentVal.replace(colorStrings.at(j), colorHeader); // string "\color;" found
-        }
-        stringValsWithModifiedColors << currentVal;
-    }
-
-    DWORD dataStartOffset = TblHeader::size + entriesNumber*sizeof(WORD) + entriesNumber*TblHashNode::size;
-    QVector<WORD> indices(entriesNumber);
-    QVector<TblHashNode> nodes(entriesNumber);
-    QVector<bool> collisionsDetected(entriesNumber, false);
-    DWORD currentOffset = dataStartOffset, maxCollisionsNumber = 0;
-    for (WORD i = 0; i < entriesNumber; i++)
-    {
-        QByteArray currentKey = TblStructure::encodeKey(_currentTableWidget->item(i, 0)->text()),
-        currentVal = stringValsWithModifiedColors.at(i).toUtf8();
-        DWORD hashValue = TblStructure::hashValue(currentKey.data(), entriesNumber), hashIndex = hashValue,
-        currentCollisionsNumber = 0;
-        while (collisionsDetected[hashIndex]) // counting collisions for current hash value
-        {
-            currentCollisionsNumber++;
-            hashIndex++;
-            hashIndex %= entriesNumber;
-        }
-        collisionsDetected[hashIndex] = true;
-        if (currentCollisionsNumber > maxCollisionsNumber)
-            maxCollisionsNumber = currentCollisionsNumber;
-        indices[i] = hashIndex;
-
-        // we need the size of UTF-8 data, not QString
-        WORD currentKeyLength = qstrlen(currentKey.constData()) + 1, currentValLength = qstrlen(currentVal.constData()) + 1;
-        // convenient constructor instead of nodes[hashIndex].Active = 1; ...
-        nodes[hashIndex] = TblHashNode(1, i, hashValue, currentOffset, currentOffset + currentKeyLength, currentValLength);
-        currentOffset += currentKeyLength + currentValLength;
-    }
-
-    bytesToWrite.fill(0, TblHeader::size); // header will be filled in the end, so we reserve bytes for it
-    QDataStream out(&bytesToWrite, QIODevice::WriteOnly);
-    out.setByteOrder(QDataStream::LittleEndian);
-
-    out.skipRawData(TblHeader::size); // current offset for writing = 0x15
-    for (WORD i = 0; i < entriesNumber; i++)
-        out << indices[i];
-
-    for (WORD i = 0; i < entriesNumber; i++)
-        out << nodes[i];
-
-    for (WORD i = 0; i < entriesNumber; i++)
-    {
-        QByteArray keyLatin1 = TblStructure::encodeKey(_currentTableWidget->item(i, 0)->text()), valUtf8 = stringValsWithModifiedColors.at(i).toUtf8();
-        out.writeRawData(keyLatin1.constData(), keyLatin1.size() + 1);
-        out.writeRawData(valUtf8.constData(), qstrlen(valUtf8.constData()) + 1);
-    }
-
-    DWORD fileSize = bytesToWrite.size();
-    out.device()->reset(); // current offset for writing = 0x00 (to write the header)
-    out << TblHeader(TblStructure::getCRC(bytesToWrite.data() + dataStartOffset, fileSize - dataStartOffset), entriesNumber,
-        entriesNumber, 1, dataStartOffset, maxCollisionsNumber + 1, fileSize); // convenient constructor
-
-    return fileSize;
+    TimingSpan span("serialize tbl");
+    QVector<DWORD> rawKeyHashes(_currentTableWidget->rowCount());
+    for (int i = 0; i < rawKeyHashes.size(); ++i)
+        rawKeyHashes[i] = _currentTableWidget->rawKeyHash(i); // cached
+    bytesToWrite = tblFileBytes(_currentTableWidget->entries(), rawKeyHashes, ui.actionShareIdenticalStrings->isChecked(), savedBytes);
+    return bytesToWrite.size();
 }
 
 DWORD QTblEditor::writeAsText(QByteArray &bytesToWrite, bool isCsv)
 {
+    TimingSpan span("serialize text");
     // format: [wrapper]key[wrapper]<separator>[wrapper]value[wrapper]<newline>,
     // where <separator> is '\t' (for *.txt) or ','/';' (for *.csv),
     // [wrapper] - double quotes or nothing (depends on current settings).
     // for *.csv [wrapper] is always '\"'
-    quint8 separator = '\t', wrappingChar = '\"';
+    char separator = '\t', wrappingChar = '\"';
     if (isCsv)
         separator = ui.actionCsvComma->isChecked() ? ',' : ';';
     else if (!ui.actionWrapStrings->isChecked())
         wrappingChar = 0;
 
-    QDataStream out(&bytesToWrite, QIODevice::WriteOnly);
-    for (WORD i = 0, n = _currentTableWidget->rowCount(); i < n; ++i)
-    {
-        QByteArray keyLatin1 = TblStructure::encodeKey(foldNewlines(_currentTableWidget->item(i, 0)->text()));
-        if (wrappingChar)
-            out << wrappingChar;
-        out.writeRawData(keyLatin1.constData(), keyLatin1.size());
-        if (wrappingChar)
-            out << wrappingChar;
-
-        out << separator;
-
-        QByteArray valUtf8 = foldNewlines(_currentTableWidget->item(i, 1)->text()).toUtf8();
-        if (wrappingChar)
-            out << wrappingChar;
-        if (!valUtf8.isEmpty())
-            out.writeRawData(valUtf8.constData(), qstrlen(valUtf8.constData()));
-        if (wrappingChar)
-            out << wrappingChar;
-
-        out << static_cast<quint8>('\n');
-    }
+    bytesToWrite = textFileBytes(_currentTableWidget->entries(), separator, wrappingChar);
     return bytesToWrite.size();
 }
 
 void QTblEditor::showFindReplaceDialog()
 {
-    _findReplaceDlg->show(_openedTables == 2);
+    _findReplaceDlg->show(openedTablesCount() > 1);
     _findReplaceDlg->raise();
     _findReplaceDlg->activateWindow();
 }
 
+void QTblEditor::showBatchReplaceDialog()
+{
+    QStringList openedFileNames;
+    foreach (TablePanelWidget *w, openedTablePanels())
+        if (w->absoluteFileName() != kNewTblFileName)
+            openedFileNames += QDir::fromNativeSeparators(w->absoluteFileName());
+    (new BatchReplaceDialog(this, openedFileNames, _lastPath))->show(); // deletes itself on close
+}
+
 void QTblEditor::changeCurrentTableItem(QTableWidgetItem *newItem)
 {
-    _currentTableWidget = qobject_cast<D2StringTableWidget *>(newItem->tableWidget());
+    changeCurrentTable(tablePanelOf(newItem->tableWidget()));
     _currentTableWidget->setCurrentCell(newItem->row(), newItem->column());
-
-    currentTablePanelWidget()->setActive(true);
-    if (_openedTables == 2)
-        inactiveNamedTableWidget(currentTablePanelWidget())->setActive(false);
 }
 
 void QTblEditor::findNextString(const QString &query, bool isCaseSensitive, bool isExactString, bool isSearchBothTables)
 {
+    TimingSpan span("search");
     Qt::MatchFlags searchOptions(Qt::MatchWrap | Qt::MatchContains);
     if (isCaseSensitive)
         searchOptions |= Qt::MatchCaseSensitive;
     if (isExactString)
         searchOptions &= ~Qt::MatchContains;
     QList<QTableWidgetItem *> foundItems = _currentTableWidget->findItems(query, searchOptions);
-    if (isSearchBothTables && _openedTables == 2)
-        foundItems.append(inactiveTableWidget(_currentTableWidget)->findItems(query, searchOptions));
+    if (isSearchBothTables) // search in all opened tables
+        foreach (TablePanelWidget *w, openedTablePanels())
+            if (w->tableWidget() != _currentTableWidget)
+                foundItems.append(w->tableWidget()->findItems(query, searchOptions));
     _findReplaceDlg->getFoundStrings(foundItems);
 }
 
@@ -911,6 +1127,170 @@ void QTblEditor::goTo()
         _currentTableWidget->setCurrentCell(dlg.row() - 1, 1);
 }
 
+void QTblEditor::goToNextModified()
+{
+    int row = _currentTableWidget->nextModifiedRow(_currentTableWidget->currentRow());
+    if (row != -1)
+        _currentTableWidget->setCurrentCell(row, _currentTableWidget->isCellModified(row, 1) ? 1 : 0);
+    else
+        qApp->beep();
+}
+
+void QTblEditor::showTooLongStrings()
+{
+    TablesDifferencesWidget *w = tooLongStringsWidget();
+    if (!w)
+    {
+        w = new TablesDifferencesWidget(this, TablesDifferencesWidget::TooLongStrings);
+        connect(w->listWidget(), SIGNAL(currentTextChanged(const QString &)), SLOT(goToListedRow(const QString &)));
+        connect(w, SIGNAL(refreshRequested(TablesDifferencesWidget *)), SLOT(refreshDifferences(TablesDifferencesWidget *)));
+    }
+    refreshDifferences(w);
+    w->resize(w->sizeHint());
+    w->show();
+}
+
+void QTblEditor::showHashCollisions()
+{
+    HashCollisionsWidget *w = findChild<HashCollisionsWidget *>();
+    if (!w)
+    {
+        w = new HashCollisionsWidget(this);
+        connect(w->listWidget(), SIGNAL(currentTextChanged(const QString &)), SLOT(goToListedRow(const QString &)));
+        connect(w, SIGNAL(refreshRequested(HashCollisionsWidget *)), SLOT(refreshHashCollisions(HashCollisionsWidget *)));
+    }
+    refreshHashCollisions(w);
+    w->show();
+}
+
+void QTblEditor::updateTooLongStringsWidget()
+{
+    // the list is kept in sync with the current table while background validation runs
+    if (sender() && sender() != _currentTableWidget)
+        return;
+    if (TablesDifferencesWidget *w = tooLongStringsWidget())
+        refreshDifferences(w);
+}
+
+void QTblEditor::changeRowOrder()
+{
+    TableRowView::SortOrder order = (TableRowView::SortOrder)_rowOrderGroup->checkedAction()->data().toInt();
+    _currentTableWidget->rowView()->setSortOrder(order, ui.actionSortDescending->isChecked());
+}
+
+void QTblEditor::changeRowFilter()
+{
+    _currentTableWidget->rowView()->setFilter((TableRowView::Filter)_rowFilterGroup->checkedAction()->data().toInt());
+    currentTablePanelWidget()->updateRowCountLabel();
+}
+
+void QTblEditor::updateRowViewActions()
+{
+    // each table has its own order and filter
+    const TableRowView *rowView = _currentTableWidget->rowView();
+    _rowOrderGroup->actions().at(rowView->sortOrder())->setChecked(true);
+    ui.actionSortDescending->setChecked(rowView->isDescending());
+    _rowFilterGroup->actions().at(rowView->filter())->setChecked(true);
+}
+
+void QTblEditor::undo()
+{
+    _currentTableWidget->editHistory()->undo();
+    editHistoryApplied();
+}
+
+void QTblEditor::redo()
+{
+    _currentTableWidget->editHistory()->redo();
+    editHistoryApplied();
+}
+
+void QTblEditor::editHistoryApplied()
+{
+    // the table is the same as in the file again, so there's nothing to save
+    if (_currentTableWidget->editHistory()->isClean())
+    {
+        _currentTableWidget->clearModifiedCells();
+        updateWindow(false);
+        ui.actionSaveAll->setEnabled(hasModifiedTables());
+    }
+    else
+        updateWindow();
+    currentTablePanelWidget()->updateRowCountLabel();
+    updateLocationLabel(_currentTableWidget->currentRow());
+}
+
+void QTblEditor::updateUndoActions()
+{
+    TableEditHistory *editHistory = _currentTableWidget->editHistory();
+    bool hasTable = openedTablesCount() != 0;
+    ui.actionUndo->setEnabled(hasTable && editHistory->canUndo());
+    ui.actionRedo->setEnabled(hasTable && editHistory->canRedo());
+}
+
+void QTblEditor::changeUndoMemoryLimit()
+{
+    bool okPressed;
+    int megabytes = QInputDialog::getInt(this, tr("Undo memory limit"), tr("Maximum memory for undo history of each table, MB:"),
+                                         _undoMemoryLimit / (1024 * 1024), 1, 4096, 1, &okPressed);
+    if (okPressed)
+    {
+        _undoMemoryLimit = qint64(megabytes) * 1024 * 1024;
+        foreach (TablePanelWidget *w, tablePanels())
+            w->tableWidget()->editHistory()->setMemoryLimit(_undoMemoryLimit);
+    }
+}
+
+void QTblEditor::showMemoryUsage()
+{
+    // text of equal strings is counted once if they share data, i.e. were interned or copied
+    QSet<const QChar *> countedData;
+    qint64 textBytes = 0, unsharedTextBytes = 0, undoBytes = 0;
+    int stringsNumber = 0;
+    foreach (TablePanelWidget *w, openedTablePanels())
+    {
+        D2StringTableWidget *tableWidget = w->tableWidget();
+        for (int i = 0, n = tableWidget->rowCount(); i < n; ++i)
+        {
+            for (int j = 0; j < 2; ++j)
+            {
+                QTableWidgetItem *item = tableWidget->item(i, j);
+                if (!item)
+                    continue;
+
+                QString text = item->text();
+                qint64 bytes = text.size() * sizeof(QChar);
+                stringsNumber++;
+                unsharedTextBytes += bytes;
+                if (!text.isEmpty() && !countedData.contains(text.constData()))
+                {
+                    countedData.insert(text.constData());
+                    textBytes += bytes;
+                }
+            }
+        }
+        undoBytes += tableWidget->editHistory()->memoryUsage();
+    }
+
+    const double kb = 1024.0;
+    QString text = tr("Strings in opened tables: %1\nText data: %2 KB\nSaved by sharing identical strings: %3 KB\n"
+                      "Strings in the shared pool: %4\nUndo history: %5 KB")
+                       .arg(stringsNumber).arg(textBytes / kb, 0, 'f', 1).arg((unsharedTextBytes - textBytes) / kb, 0, 'f', 1)
+                       .arg(StringPool::size()).arg(undoBytes / kb, 0, 'f', 1);
+    // footprint of each table includes items and per-row state, so it's what closing the table would free at most
+    text += "\n";
+    foreach (TablePanelWidget *w, openedTablePanels())
+        text += "\n" + tr("%1: %2 KB").arg(w->fileName()).arg(w->tableWidget()->memoryUsage() / kb, 0, 'f', 1);
+    QMessageBox::information(this, tr("Memory usage"), text);
+}
+
+void QTblEditor::exportTimingTrace()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export timing trace"), _lastPath + "/trace.json", tr("Chrome trace files (*.json)"));
+    if (!fileName.isEmpty() && !Timing::writeChromeTrace(fileName))
+        QMessageBox::critical(this, qApp->applicationName(), tr("Error writing file \"%1\"").arg(QDir::toNativeSeparators(fileName)));
+}
+
 void QTblEditor::editString(QTableWidgetItem *itemToEdit)
 {
     int row = itemToEdit->row();
@@ -920,23 +1300,24 @@ void QTblEditor::editString(QTableWidgetItem *itemToEdit)
     else // key selected
         itemsPair = KeyValueItemsPair(itemToEdit, itemToEdit->tableWidget()->item(row, 1));
 
+    // the paired table is edited side by side when tables are synced
     EditStringCellDialog *editStringCellDlg = 0;
-    if (_openedTables == 1 || row >= inactiveTableWidget(_currentTableWidget)->rowCount() || !ui.actionSyncScrolling->isChecked())
+    D2StringTableWidget *pairedTableWidget = inactiveTableWidget(itemToEdit->tableWidget());
+    if (!pairedTableWidget || row >= pairedTableWidget->rowCount() || !ui.actionSyncScrolling->isChecked())
         editStringCellDlg = new EditStringCellDialog(this, itemsPair);
     else
     {
-        QTableWidget *w = inactiveTableWidget(itemToEdit->tableWidget());
-        KeyValueItemsPair otherItemsPair(w->item(row, 0), w->item(row, 1));
-        if (_currentTableWidget == _leftTableWidget)
+        KeyValueItemsPair otherItemsPair(pairedTableWidget->item(row, 0), pairedTableWidget->item(row, 1));
+        if (_tableSplitter->indexOf(tablePanelOf(itemToEdit->tableWidget())) < _tableSplitter->indexOf(tablePanelOf(pairedTableWidget)))
             editStringCellDlg = new EditStringCellDialog(this, itemsPair, otherItemsPair);
         else
             editStringCellDlg = new EditStringCellDialog(this, otherItemsPair, itemsPair);
     }
 
     connect(editStringCellDlg, SIGNAL(editorClosedAt(int)), _currentTableWidget, SLOT(changeCurrentCell(int)));
-    if (_openedTables == 2 && ui.actionSyncScrolling->isChecked())
+    if (pairedTableWidget && ui.actionSyncScrolling->isChecked())
     {
-        connect(editStringCellDlg, SIGNAL(editorClosedAt(int)), inactiveTableWidget(_currentTableWidget), SLOT(changeCurrentCell(int)));
+        connect(editStringCellDlg, SIGNAL(editorClosedAt(int)), pairedTableWidget, SLOT(changeCurrentCell(int)));
         connect(this, SIGNAL(tablesWereSwapped()), editStringCellDlg, SLOT(swapEditors()));
     }
 
@@ -945,12 +1326,14 @@ void QTblEditor::editString(QTableWidgetItem *itemToEdit)
 
 void QTblEditor::updateItem(QTableWidgetItem *item)
 {
-    if (_isTableLoaded && item && item->background().color() != Qt::green)
-    {
-        item->setBackground(QBrush(Qt::green));
+    if (!_isTableLoaded || !item)
+        return;
 
-        TablePanelWidget *w = _leftTablePanelWidget->tableWidget() == item->tableWidget() ? _leftTablePanelWidget : _rightTablePanelWidget;
-        w->tableWidget()->addEditedItem(item);
+    TablePanelWidget *w = tablePanelOf(item->tableWidget());
+    int row = item->row(), column = item->column();
+    if (!w->tableWidget()->isCellModified(row, column))
+    {
+        w->tableWidget()->setCellModified(row, column);
         w->setWindowModified(true);
 
         setWindowModified(true);
@@ -996,21 +1379,20 @@ void QTblEditor::updateWindow(bool isModified)
 
 void QTblEditor::updateLocationLabel(int newRow)
 {
-    if (newRow < 0)
+    if (newRow < 0 || newRow >= _currentTableWidget->rowCount())
         return;
 
     int row = newRow + 1, rows = _currentTableWidget->rowCount();
     _locationLabel->setText(QString("%1 (0x%2) / %3 (0x%4)").arg(row).arg(row, 0, 16).arg(rows).arg(rows, 0, 16));
 
-    QString keyHash = QString("0x%1").arg(TblStructure::hashValue(TblStructure::encodeKey(_currentTableWidget->item(newRow, 0)->text()).data(), rows), 0, 16);
+    QString keyHash = QString("0x%1").arg(_currentTableWidget->keyHash(newRow), 0, 16);
     D2StringTableWidget *otherTableWidget = inactiveTableWidget(_currentTableWidget);
-    int inactiveRows = otherTableWidget->rowCount();
-    if (_openedTables == 2 && newRow < inactiveRows)
+    if (otherTableWidget && newRow < otherTableWidget->rowCount())
     {
-        QString otherKeyHash = QString("0x%1").arg(TblStructure::hashValue(TblStructure::encodeKey(otherTableWidget->item(newRow, 0)->text()).data(), inactiveRows), 0, 16);
+        QString otherKeyHash = QString("0x%1").arg(otherTableWidget->keyHash(newRow), 0, 16);
         if (keyHash != otherKeyHash)
         {
-            if (_currentTableWidget == _leftTableWidget)
+            if (_tableSplitter->indexOf(currentTablePanelWidget()) < _tableSplitter->indexOf(tablePanelOf(otherTableWidget)))
                 keyHash += " | " + otherKeyHash;
             else
                 keyHash = otherKeyHash + " | " + keyHash;
@@ -1023,7 +1405,10 @@ void QTblEditor::writeSettings()
 {
     QSettings settings;
     settings.setValue("syncScrolling", ui.actionSyncScrolling->isChecked());
-    settings.setValue("lastSelectedRowsHash", _lastSelectedRowsHash);
+    settings.setValue("syncByKeys", ui.actionSyncByKeys->isChecked());
+    foreach (TablePanelWidget *w, openedTablePanels())
+        rememberViewState(w);
+    _viewStates.write(settings);
 
     settings.beginGroup("geometry");
     settings.setValue("windowGeometry", saveGeometry());
@@ -1035,8 +1420,14 @@ void QTblEditor::writeSettings()
     settings.setValue("isCsvSeparatorComma", ui.actionCsvComma->isChecked());
     settings.setValue("restoreOpenedFiles", ui.actionRestoreLastOpenedFiles->isChecked());
     settings.setValue("wrapTxtStrings", ui.actionWrapStrings->isChecked());
+    settings.setValue("shareIdenticalTblStrings", ui.actionShareIdenticalStrings->isChecked());
+    settings.setValue("compressUploads", ui.actionCompressUploads->isChecked());
+    settings.setValue("cacheTextTables", ui.actionCacheTextTables->isChecked());
+    settings.setValue("recordTimings", ui.actionRecordTimings->isChecked());
     settings.setValue("showHexInRows", ui.actionShowHexInRow->isChecked());
+    settings.setValue("showColorsInTable", ui.actionShowColorsInTable->isChecked());
     settings.setValue("startNumberingFrom", _startNumberingGroup->checkedAction()->text());
+    settings.setValue("undoMemoryLimit", _undoMemoryLimit);
     settings.endGroup();
 
     settings.beginGroup("recentItems");
@@ -1044,22 +1435,27 @@ void QTblEditor::writeSettings()
     settings.setValue("recentFiles", _recentFilesList);
     settings.endGroup();
 
-    if (ui.actionRestoreLastOpenedFiles->isChecked() && _openedTables)
+    if (ui.actionRestoreLastOpenedFiles->isChecked() && openedTablesCount())
     {
-        settings.beginGroup("lastSession");
-        settings.setValue("firstTablePath", currentTablePanelWidget()->absoluteFileName());
-        settings.setValue("firstTableRow", _currentTableWidget->currentRow());
-        if (_openedTables == 2)
+        QStringList tablePaths;
+        QVariantList tableRows;
+        foreach (TablePanelWidget *w, openedTablePanels())
         {
-            activateAnotherTable();
-            settings.setValue("secondTablePath", currentTablePanelWidget()->absoluteFileName());
-            settings.setValue("secondTableRow", _currentTableWidget->currentRow());
+            if (w->absoluteFileName() == kNewTblFileName)
+                continue;
+            tablePaths += w->absoluteFileName();
+            tableRows += w->tableWidget()->currentRow();
         }
-        else
+        if (_sessionWatcher) // closed before the last session was restored completely
         {
-            settings.remove("secondTablePath");
-            settings.remove("secondTableRow");
+            tablePaths += _sessionTablePaths.mid(_restoredTablesCount);
+            tableRows += _sessionTableRows.mid(_restoredTablesCount);
         }
+
+        settings.remove("lastSession"); // also removes keys of the old two-table format
+        settings.beginGroup("lastSession");
+        settings.setValue("tablePaths", tablePaths);
+        settings.setValue("tableRows", tableRows);
         settings.endGroup();
     }
     else
@@ -1089,7 +1485,8 @@ void QTblEditor::readSettings()
 {
     QSettings settings;
     ui.actionSyncScrolling->setChecked(settings.value("syncScrolling", true).toBool());
-    _lastSelectedRowsHash = settings.value("lastSelectedRowsHash").toHash();
+    ui.actionSyncByKeys->setChecked(settings.value("syncByKeys").toBool());
+    _viewStates.read(settings);
 
     settings.beginGroup("geometry");
     restoreGeometry(settings.value("windowGeometry").toByteArray());
@@ -1101,8 +1498,16 @@ void QTblEditor::readSettings()
     ui.actionRestoreLastOpenedFiles->setChecked(settings.value("restoreOpenedFiles", true).toBool());
     ui.actionCsvSemiColon->setChecked(!settings.value("isCsvSeparatorComma", true).toBool());
     ui.actionWrapStrings->setChecked(settings.value("wrapTxtStrings", true).toBool());
+    ui.actionShareIdenticalStrings->setChecked(settings.value("shareIdenticalTblStrings").toBool());
+    ui.actionCompressUploads->setChecked(settings.value("compressUploads").toBool());
+    ui.actionCacheTextTables->setChecked(settings.value("cacheTextTables").toBool());
+    ui.actionRecordTimings->setChecked(Timing::isEnabled() || settings.value("recordTimings").toBool()); // can be enabled from command line
     ui.actionShowHexInRow->setChecked(settings.value("showHexInRows").toBool());
+    ui.actionShowColorsInTable->setChecked(settings.value("showColorsInTable").toBool());
     (settings.value("startNumberingFrom").toString() == "0" ? ui.actionStartNumberingFrom0 : ui.actionStartNumberingFrom1)->setChecked(true);
+    _undoMemoryLimit = settings.value("undoMemoryLimit", TableEditHistory::kDefaultMemoryLimit).toLongLong();
+    foreach (TablePanelWidget *w, tablePanels())
+        w->tableWidget()->editHistory()->setMemoryLimit(_undoMemoryLimit);
     settings.endGroup();
 
     settings.beginGroup("recentItems");
@@ -1112,21 +1517,25 @@ void QTblEditor::readSettings()
     settings.endGroup();
 
     settings.beginGroup("lastSession");
-    QStringList keys = settings.allKeys();
-    if (keys.length() >= 2)
+    QStringList tablePaths = settings.value("tablePaths").toStringList();
+    QVariantList tableRows = settings.value("tableRows").toList();
+    if (tablePaths.isEmpty() && settings.contains("firstTablePath")) // two-table format of older versions
     {
-        if (loadFile(settings.value(keys.at(0)).toString()))
-            _currentTableWidget->setCurrentCell(settings.value(keys.at(1)).toInt(), 1);
-
-        if (keys.length() == 4)
+        tablePaths << settings.value("firstTablePath").toString();
+        tableRows << settings.value("firstTableRow");
+        if (settings.contains("secondTablePath"))
         {
-            _isTableLoaded = false;
-            if (loadFile(settings.value(keys.at(2)).toString(), false))
-                _currentTableWidget->setCurrentCell(settings.value(keys.at(3)).toInt(), 1);
+            tablePaths << settings.value("secondTablePath").toString();
+            tableRows << settings.value("secondTableRow");
         }
     }
     settings.endGroup();
 
+    // tables are read in background after the window is shown
+    _sessionTablePaths = tablePaths;
+    _sessionTableRows = tableRows;
+    QTimer::singleShot(0, this, SLOT(restoreLastSession()));
+
 
     // read custom colors from file
     QFile f(
@@ -1177,19 +1586,95 @@ void QTblEditor::aboutApp()
     aboutBox.exec();
 }
 
-TablePanelWidget *QTblEditor::currentTablePanelWidget() const
+TablePanelWidget *QTblEditor::addTablePanel()
+{
+    // closed panels are reused, new tables always appear on the right
+    TablePanelWidget *w = 0;
+    foreach (TablePanelWidget *panel, tablePanels())
+    {
+        if (!panel->isOpened() && panel->isHidden())
+        {
+            w = panel;
+            break;
+        }
+    }
+
+    if (!w)
+    {
+        w = new TablePanelWidget(this);
+        D2StringTableWidget *tableWidget = w->tableWidget();
+        connect(tableWidget, SIGNAL(itemDoubleClicked(QTableWidgetItem *)), SLOT(editString(QTableWidgetItem *)));
+        connect(tableWidget, SIGNAL(currentCellChanged(int, int, int, int)), SLOT(updateLocationLabel(int)));
+        connect(tableWidget, SIGNAL(currentCellChanged(int, int, int, int)), SLOT(syncCurrentCell()));
+        connect(tableWidget->verticalScrollBar(), SIGNAL(valueChanged(int)), SLOT(syncScrollValue(int)));
+        connect(tableWidget, SIGNAL(tableGotFocus(QWidget *)), SLOT(changeCurrentTable(QWidget *)));
+        connect(tableWidget, SIGNAL(itemChanged(QTableWidgetItem *)), SLOT(updateItem(QTableWidgetItem *)));
+        connect(tableWidget, SIGNAL(tooLongRowsChanged()), SLOT(updateTooLongStringsWidget()));
+        connect(tableWidget->editHistory(), SIGNAL(changed()), SLOT(updateUndoActions()));
+
+        connect(ui.actionShowHexInRow, SIGNAL(toggled(bool)), tableWidget, SLOT(toggleDisplayHex(bool)));
+        connect(ui.actionShowColorsInTable, SIGNAL(toggled(bool)), tableWidget, SLOT(setColoredTextShown(bool)));
+        connect(ui.actionStartNumberingFrom1, SIGNAL(toggled(bool)), tableWidget, SLOT(changeRowNumberingTo1(bool)));
+
+        // new table must look like the others
+        tableWidget->toggleDisplayHex(ui.actionShowHexInRow->isChecked());
+        tableWidget->setColoredTextShown(ui.actionShowColorsInTable->isChecked());
+        tableWidget->changeRowNumberingTo1(ui.actionStartNumberingFrom1->isChecked());
+        if (ui.actionSmallRows->isChecked())
+            tableWidget->verticalHeader()->setDefaultSectionSize(20);
+        tableWidget->editHistory()->setMemoryLimit(_undoMemoryLimit);
+
+        _keyIndex->addTable(tableWidget);
+    }
+    _tableSplitter->addWidget(w); // moves reused panel to the end
+    return w;
+}
+
+QList<TablePanelWidget *> QTblEditor::tablePanels() const
+{
+    QList<TablePanelWidget *> panels;
+    for (int i = 0; i < _tableSplitter->count(); ++i)
+        panels += qobject_cast<TablePanelWidget *>(_tableSplitter->widget(i));
+    return panels;
+}
+
+QList<TablePanelWidget *> QTblEditor::openedTablePanels() const
+{
+    QList<TablePanelWidget *> panels;
+    foreach (TablePanelWidget *w, tablePanels())
+        if (w->isOpened())
+            panels += w;
+    return panels;
+}
+
+bool QTblEditor::hasModifiedTables() const
+{
+    foreach (TablePanelWidget *w, openedTablePanels())
+        if (w->tableWidget()->isWindowModified())
+            return true;
+    return false;
+}
+
+TablePanelWidget *QTblEditor::tablePanelOf(QTableWidget *tableWidget) const
 {
-    return _currentTableWidget == _leftTablePanelWidget->tableWidget() ? _leftTablePanelWidget : _rightTablePanelWidget;
+    foreach (TablePanelWidget *w, tablePanels())
+        if (w->tableWidget() == tableWidget)
+            return w;
+    return 0;
 }
 
+// the table paired with the given one in two-table operations: the next opened table to the right or the first one
 TablePanelWidget *QTblEditor::inactiveNamedTableWidget(TablePanelWidget *namedTableToCheck) const
 {
-    return namedTableToCheck == _leftTablePanelWidget ? _rightTablePanelWidget : _leftTablePanelWidget;
+    QList<TablePanelWidget *> panels = openedTablePanels();
+    int i = panels.indexOf(namedTableToCheck);
+    return i != -1 && panels.size() > 1 ? panels.at((i + 1) % panels.size()) : 0;
 }
 
 D2StringTableWidget *QTblEditor::inactiveTableWidget(QTableWidget *tableToCheck) const
 {
-    return tableToCheck == _leftTableWidget ? _rightTableWidget : _leftTableWidget;
+    TablePanelWidget *w = inactiveNamedTableWidget(tablePanelOf(tableToCheck));
+    return w ? w->tableWidget() : 0;
 }
 
 void QTblEditor::changeCurrentTable(QWidget *newActiveTable)
@@ -1198,34 +1683,48 @@ void QTblEditor::changeCurrentTable(QWidget *newActiveTable)
     if (_currentTableWidget != w->tableWidget())
     {
         _currentTableWidget = w->tableWidget();
-        w->setActive(true);
-        inactiveNamedTableWidget(w)->setActive(false);
+        foreach (TablePanelWidget *panel, tablePanels())
+            panel->setActive(panel == w);
 
         bool isTableModified = _currentTableWidget->isWindowModified();
         ui.actionSave->setEnabled(isTableModified);
         ui.actionReopen->setEnabled(isTableModified);
+        updateUndoActions();
+        updateTooLongStringsWidget();
+        updateLintedTables();
+        updateRowViewActions();
+        if (HashCollisionsWidget *hashCollisionsWidget = findChild<HashCollisionsWidget *>())
+            refreshHashCollisions(hashCollisionsWidget);
     }
 }
 
 void QTblEditor::activateAnotherTable()
 {
-    changeCurrentTable(inactiveNamedTableWidget(currentTablePanelWidget()));
+    TablePanelWidget *w = inactiveNamedTableWidget(currentTablePanelWidget());
+    if (!w)
+        return;
+    changeCurrentTable(w);
     _currentTableWidget->setFocus();
 }
 
 void QTblEditor::supplement()
 {
-    D2StringTableWidget *smallerTable = _leftTableWidget->rowCount() < _rightTableWidget->rowCount() ? _leftTableWidget : _rightTableWidget;
-    D2StringTableWidget *biggerTable = inactiveTableWidget(smallerTable);
+    D2StringTableWidget *pairedTable = inactiveTableWidget(_currentTableWidget);
+    if (!pairedTable)
+        return;
+    D2StringTableWidget *smallerTable = _currentTableWidget->rowCount() < pairedTable->rowCount() ? _currentTableWidget : pairedTable;
+    D2StringTableWidget *biggerTable = smallerTable == _currentTableWidget ? pairedTable : _currentTableWidget;
     int i = smallerTable->rowCount(), maxRow = biggerTable->rowCount();
     if (i == maxRow)
         return;
 
+    smallerTable->editHistory()->beginGroup();
     for (; i < maxRow; i++)
     {
         smallerTable->createRowAt(i);
         smallerTable->createNewEntry(i, biggerTable->item(i, 0)->text(), biggerTable->item(i, 1)->text());
     }
+    smallerTable->editHistory()->endGroup();
 
     _currentTableWidget = smallerTable;
     updateWindow();
@@ -1234,14 +1733,13 @@ void QTblEditor::supplement()
 
 void QTblEditor::swapTables()
 {
-    _tableSplitter->addWidget(_leftTablePanelWidget);
-
-    TablePanelWidget *temp = _leftTablePanelWidget;
-    _leftTablePanelWidget = _rightTablePanelWidget;
-    _rightTablePanelWidget = temp;
+    TablePanelWidget *w = currentTablePanelWidget(), *other = inactiveNamedTableWidget(w);
+    if (!other)
+        return;
 
-    _leftTableWidget = _leftTablePanelWidget->tableWidget();
-    _rightTableWidget = _rightTablePanelWidget->tableWidget();
+    int i = _tableSplitter->indexOf(w), j = _tableSplitter->indexOf(other);
+    _tableSplitter->insertWidget(j, w);
+    _tableSplitter->insertWidget(i, other);
 
     updateLocationLabel(_currentTableWidget->currentRow());
     emit tablesWereSwapped();
@@ -1256,87 +1754,102 @@ void QTblEditor::increaseRowCount(int rowIndex)
 
 void QTblEditor::copy()
 {
-    QStringList selectedLines;
+    // text is rendered only when it's requested from the clipboard. Like deleting, copying skips rows hidden by a filter
+    QList<TableMimeData::Record> records;
     foreach (const QTableWidgetSelectionRange &range, _currentTableWidget->selectedRanges())
     {
+        qint8 column = range.columnCount() == 1 ? range.rightColumn() : -1;
         for (int j = range.topRow(); j <= range.bottomRow(); j++)
-        {
-            QString s;
-            if (range.columnCount() == 1)
-                s = QString("\"%1\"").arg(_currentTableWidget->item(j, range.rightColumn())->text());
-            else
-                s = QString("\"%1\"\t\"%2\"").arg(_currentTableWidget->item(j, 0)->text(), _currentTableWidget->item(j, 1)->text());
-            selectedLines += foldNewlines(s);
-        }
+            if (!_currentTableWidget->isRowHidden(j))
+                records += TableMimeData::Record(_currentTableWidget->item(j, 0)->text(), _currentTableWidget->item(j, 1)->text(), column);
     }
 
-    qApp->clipboard()->setText(selectedLines.join("\n"));
+    qApp->clipboard()->setMimeData(new TableMimeData(records));
 }
 
 void QTblEditor::paste()
 {
     const QMimeData *data = qApp->clipboard()->mimeData();
-    if (data->hasText())
+    if (!data)
+        return;
+
+    QList<TableMimeData::Record> records;
+    if (!TableMimeData::readRecords(data, &records))
     {
-        QStringList records = data->text().split("\n");
-        if (records.last().isEmpty()) // remove last empty line
-            records.removeLast();
-        int row = _currentTableWidget->currentRow() + 1, recordsNumber = records.size();
-        if (records.at(0).contains('\t')) // format: "key"<tab>"value"
+        if (!data->hasText())
+            return;
+
+        QStringList lines = data->text().split("\n");
+        if (lines.last().isEmpty()) // remove last empty line
+            lines.removeLast();
+        if (lines.isEmpty())
+            return;
+
+        bool hasKeysAndValues = lines.at(0).contains('\t'); // format: "key"<tab>"value", otherwise "text"
+        foreach (const QString &line, lines)
         {
-            for (int i = 0; i < recordsNumber; i++)
+            if (hasKeysAndValues)
             {
-                int rowIndex = row + i;
-                _currentTableWidget->createRowAt(rowIndex);
-                QStringList keyValueString = records.at(i).split('\t');
-                _currentTableWidget->createNewEntry(rowIndex, stripSurroundingQuotes(keyValueString.at(0)), stripSurroundingQuotes(restoreNewlines(keyValueString.at(1))));
+                QStringList keyValueString = line.split('\t');
+                records += TableMimeData::Record(stripSurroundingQuotes(keyValueString.at(0)), stripSurroundingQuotes(restoreNewlines(keyValueString.value(1))), -1);
             }
-        }
-        else // format: "text"
-        {
-            bool isKey = !_currentTableWidget->currentColumn();
-            for (int i = 0; i < recordsNumber; i++)
+            else
             {
-                int rowIndex = row + i;
-                _currentTableWidget->createRowAt(rowIndex);
-
-                QString s = stripSurroundingQuotes(restoreNewlines(records.at(i)));
-                if (isKey)
-                    _currentTableWidget->createNewEntry(rowIndex, s, QString());
-                else
-                    _currentTableWidget->createNewEntry(rowIndex, QString(), s);
+                QString s = stripSurroundingQuotes(restoreNewlines(line));
+                records += TableMimeData::Record(s, s, 0);
             }
         }
+    }
+    if (records.isEmpty())
+        return;
 
-        for (int i = row; i < row + recordsNumber; i++)
+    // single column text goes to the current column
+    bool isKey = !_currentTableWidget->currentColumn();
+    KeyValuePairList entries;
+    foreach (const TableMimeData::Record &r, records)
+    {
+        if (r.Column == -1)
+            entries += KeyValuePair(r.Key, r.Val);
+        else
         {
-            updateItem(_currentTableWidget->item(i, 0));
-            updateItem(_currentTableWidget->item(i, 1));
+            const QString &s = r.Column ? r.Val : r.Key;
+            entries += isKey ? KeyValuePair(s, QString()) : KeyValuePair(QString(), s);
         }
+    }
 
-        _currentTableWidget->setCurrentCell(row + recordsNumber, 0);
-        currentTablePanelWidget()->updateRowCountLabel();
+    int row = _currentTableWidget->currentRow() + 1, recordsNumber = entries.size();
+    _currentTableWidget->insertEntries(row, entries);
+
+    for (int i = row; i < row + recordsNumber; i++)
+    {
+        updateItem(_currentTableWidget->item(i, 0));
+        updateItem(_currentTableWidget->item(i, 1));
     }
+
+    _currentTableWidget->setCurrentCell(row + recordsNumber, 0);
+    currentTablePanelWidget()->updateRowCountLabel();
 }
 
 void QTblEditor::toggleRowsHeight(bool isSmall)
 {
-    // TODO: try to improve performance
     int height = isSmall ? 20 : 30;
-    for (int i = 0; i < _leftTableWidget->rowCount(); i++)
-        _leftTableWidget->setRowHeight(i, height);
-    for (int i = 0; i < _rightTableWidget->rowCount(); i++)
-        _rightTableWidget->setRowHeight(i, height);
+    foreach (TablePanelWidget *w, tablePanels())
+        w->tableWidget()->verticalHeader()->setDefaultSectionSize(height);
 }
 
 QStringList QTblEditor::differentStrings(TablesDifferencesWidget::DiffType diffType) const
 {
-    int minRows = qMin(_leftTableWidget->rowCount(), _rightTableWidget->rowCount());
+    TimingSpan span("compare tables");
     QStringList differenceRows;
+    D2StringTableWidget *pairedTable = inactiveTableWidget(_currentTableWidget);
+    if (!pairedTable)
+        return differenceRows;
+
+    int minRows = qMin(_currentTableWidget->rowCount(), pairedTable->rowCount());
     for (int i = 0; i < minRows; i++)
     {
-        bool areDifferentKeys = _leftTableWidget->item(i, 0)->text() != _rightTableWidget->item(i, 0)->text();
-        bool areDifferentStrings = !areDifferentKeys && _leftTableWidget->item(i, 1)->text() != _rightTableWidget->item(i, 1)->text();
+        bool areDifferentKeys = _currentTableWidget->item(i, 0)->text() != pairedTable->item(i, 0)->text();
+        bool areDifferentStrings = !areDifferentKeys && _currentTableWidget->item(i, 1)->text() != pairedTable->item(i, 1)->text();
         bool areDifferentEither = areDifferentKeys || areDifferentStrings;
         if ((diffType == TablesDifferencesWidget::Keys          && areDifferentKeys) ||
             (diffType == TablesDifferencesWidget::Strings       && areDifferentStrings) ||
@@ -1349,16 +1862,6 @@ QStringList QTblEditor::differentStrings(TablesDifferencesWidget::DiffType diffT
     return differenceRows;
 }
 
-QString QTblEditor::foldNewlines(const QString &s)
-{
-    return QString(s).replace(QLatin1String("\n"), QLatin1String("\\n"));
-}
-
-QString QTblEditor::restoreNewlines(const QString &s)
-{
-    return QString(s).replace(QLatin1String("\\n"), QLatin1String("\n"));
-}
-
 void QTblEditor::showDifferences()
 {
     QAction *action = qobject_cast<QAction *>(sender());
@@ -1373,7 +1876,6 @@ void QTblEditor::showDifferences()
             if (w->diffType() == diffType)
             {
                 diffWidget = w;
-                diffWidget->clear();
                 break;
             }
         }
@@ -1381,10 +1883,10 @@ void QTblEditor::showDifferences()
         if (!diffWidget)
         {
             diffWidget = new TablesDifferencesWidget(this, diffType);
-            connect(diffWidget->listWidget(), SIGNAL(currentTextChanged(const QString &)), _leftTableWidget, SLOT(tableDifferencesItemChanged(const QString &)));
+            connect(diffWidget->listWidget(), SIGNAL(currentTextChanged(const QString &)), SLOT(goToListedRow(const QString &)));
             connect(diffWidget, SIGNAL(refreshRequested(TablesDifferencesWidget *)), SLOT(refreshDifferences(TablesDifferencesWidget *)));
         }
-        diffWidget->addRows(differenceRows);
+        diffWidget->setRows(differenceRows);
         diffWidget->resize(diffWidget->sizeHint());
         diffWidget->show();
     }
@@ -1394,28 +1896,124 @@ void QTblEditor::showDifferences()
 
 void QTblEditor::refreshDifferences(TablesDifferencesWidget *w)
 {
-    w->clear();
-    w->addRows(differentStrings(w->diffType()));
+    if (w->diffType() == TablesDifferencesWidget::TooLongStrings)
+        w->setRows(tooLongStrings());
+    else if (w->diffType() == TablesDifferencesWidget::TranslationIssues)
+        w->setRows(_tableLint->issueRows());
+    else
+        w->setRows(differentStrings(w->diffType()));
 }
 
-void QTblEditor::syncScrollingChanged(bool isSyncing)
+QStringList QTblEditor::tooLongStrings() const
 {
-    QScrollBar *leftScrollbar = _leftTableWidget->verticalScrollBar(), *rightScrollbar = _rightTableWidget->verticalScrollBar();
-    const char *changeCellSlot = SLOT(changeCurrentCell(int, int));
-    if (isSyncing)
-    {
-        connect(leftScrollbar,  SIGNAL(valueChanged(int)), rightScrollbar, SLOT(setValue(int)));
-        connect(rightScrollbar, SIGNAL(valueChanged(int)), leftScrollbar,  SLOT(setValue(int)));
+    QStringList tooLongRows;
+    foreach (int i, _currentTableWidget->tooLongRows())
+        tooLongRows.append(QString("%1 (0x%2): %3").arg(i + 1).arg(i + 1, 0, 16).arg(coloredTextLength(_currentTableWidget->item(i, 1)->text())));
+    return tooLongRows;
+}
+
+TablesDifferencesWidget *QTblEditor::tooLongStringsWidget() const
+{
+    foreach (TablesDifferencesWidget *w, findChildren<TablesDifferencesWidget *>())
+        if (w->diffType() == TablesDifferencesWidget::TooLongStrings)
+            return w;
+    return 0;
+}
 
-        connect(_leftTableWidget,  SIGNAL(currentCellChanged(int, int, int, int)), _rightTableWidget, changeCellSlot);
-        connect(_rightTableWidget, SIGNAL(currentCellChanged(int, int, int, int)), _leftTableWidget,  changeCellSlot);
+void QTblEditor::showTranslationIssues()
+{
+    TablesDifferencesWidget *w = translationIssuesWidget();
+    if (!w)
+    {
+        w = new TablesDifferencesWidget(this, TablesDifferencesWidget::TranslationIssues);
+        connect(w->listWidget(), SIGNAL(currentTextChanged(const QString &)), SLOT(goToListedRow(const QString &)));
+        connect(w, SIGNAL(refreshRequested(TablesDifferencesWidget *)), SLOT(refreshDifferences(TablesDifferencesWidget *)));
     }
+    updateLintedTables();
+    refreshDifferences(w);
+    w->resize(w->sizeHint());
+    w->show();
+}
+
+void QTblEditor::updateTranslationIssuesWidget()
+{
+    // edited rows are checked again by the lint, so the list follows editing without full comparison
+    if (TablesDifferencesWidget *w = translationIssuesWidget())
+        refreshDifferences(w);
     else
+        _tableLint->setTables(0, 0); // the widget was closed
+}
+
+TablesDifferencesWidget *QTblEditor::translationIssuesWidget() const
+{
+    foreach (TablesDifferencesWidget *w, findChildren<TablesDifferencesWidget *>())
+        if (w->diffType() == TablesDifferencesWidget::TranslationIssues)
+            return w;
+    return 0;
+}
+
+void QTblEditor::updateLintedTables()
+{
+    // the current table is checked as a translation of the other one
+    D2StringTableWidget *pairedTable = translationIssuesWidget() ? inactiveTableWidget(_currentTableWidget) : 0;
+    _tableLint->setTables(pairedTable, pairedTable ? _currentTableWidget : 0);
+}
+
+void QTblEditor::syncScrollingChanged(bool isSyncing)
+{
+    if (isSyncing)
+        syncTablesWith(_currentTableWidget);
+}
+
+void QTblEditor::syncScrollValue(int value)
+{
+    if (_isSyncingTables || !ui.actionSyncScrolling->isChecked() || ui.actionSyncByKeys->isChecked())
+        return;
+
+    TablePanelWidget *source = 0;
+    foreach (TablePanelWidget *w, tablePanels())
     {
-        leftScrollbar->disconnect(rightScrollbar);
-        rightScrollbar->disconnect(leftScrollbar);
+        if (w->tableWidget()->verticalScrollBar() == sender())
+        {
+            source = w;
+            break;
+        }
+    }
+    if (!source || !source->isSynced())
+        return;
 
-        _leftTableWidget->disconnect(_rightTableWidget, changeCellSlot);
-        _rightTableWidget->disconnect(_leftTableWidget, changeCellSlot);
+    _isSyncingTables = true;
+    foreach (TablePanelWidget *w, openedTablePanels())
+        if (w != source && w->isSynced())
+            w->tableWidget()->verticalScrollBar()->setValue(value);
+    _isSyncingTables = false;
+}
+
+void QTblEditor::syncTablesWith(D2StringTableWidget *table)
+{
+    TablePanelWidget *source = tablePanelOf(table);
+    if (_isSyncingTables || !ui.actionSyncScrolling->isChecked() || !source || !source->isSynced())
+        return;
+
+    int row = table->currentRow(), column = table->currentColumn();
+    if (row < 0)
+        return;
+
+    bool isSyncByKeys = ui.actionSyncByKeys->isChecked();
+    QString key = isSyncByKeys ? table->item(row, 0)->text() : QString();
+
+    _isSyncingTables = true;
+    foreach (TablePanelWidget *w, openedTablePanels())
+    {
+        if (w == source || !w->isSynced())
+            continue;
+
+        D2StringTableWidget *t = w->tableWidget();
+        int targetRow = isSyncByKeys ? _keyIndex->rowOfKey(key, t) : row;
+        if (targetRow != -1)
+            t->changeCurrentCell(targetRow, column < 0 ? 1 : column);
+        if (!isSyncByKeys)
+            t->verticalScrollBar()->setValue(table->verticalScrollBar()->value());
     }
+    _isSyncingTables = false;
 }
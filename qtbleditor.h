@@ -6,12 +6,26 @@
 #include "editstringcelldialog.h"
 #include "d2stringtablewidget.h"
 #include "tablesdifferenceswidget.h"
+#include "hashcollisionswidget.h"
 #include "tblstructure.h"
+#include "tableedithistory.h"
+#include "tablefile.h"
+#include "timing.h"
+#include "texttablecache.h"
+#include "tableviewstatestore.h"
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 
 
 class TablePanelWidget;
 class FindReplaceDialog;
-class QFile;
+class TableKeyIndex;
+class TableLint;
+class TableUploader;
+class QProgressBar;
+class QFileSystemWatcher;
+class QTimer;
 
 class QTblEditor : public QMainWindow
 {
@@ -31,16 +45,29 @@ protected:
 private slots:
     void newTable();
     void open();
+    void openFromMpq();
     void openRecentFile();
     void reopen();
     void sendToServer();
-    bool closeTable(bool hideTable = true);
-    bool closeAll(bool hideTable = true) { return closeTable(hideTable) && (!_openedTables || closeTable(hideTable)); }
+    void uploadProgressChanged(qint64 sentBytes, qint64 totalBytes);
+    void uploadFinished(bool isSuccess, const QString &response);
+    bool closeTable();
+    bool closeAll(bool hideTable = true);
     void save();
     void saveAs();
     void saveAll();
     void aboutApp();
 
+    void undo();
+    void redo();
+    void updateUndoActions();
+    void changeUndoMemoryLimit();
+    void showMemoryUsage();
+    void recordTimings(bool isEnabled) { Timing::setEnabled(isEnabled); }
+    void cacheTextTables(bool isEnabled) { TextTableCache::setEnabled(isEnabled); }
+    void showTiming(const QString &summary) { ui.statusBar->showMessage(summary, 5000); }
+    void exportTimingTrace();
+
     void changeText() { editString(_currentTableWidget->currentItem()); }
     void appendEntry() { increaseRowCount(_currentTableWidget->rowCount()); }
     void insertAfterCurrent() { increaseRowCount(_currentTableWidget->currentRow() + 1); }
@@ -48,18 +75,32 @@ private slots:
     void copy();
     void paste();
     void showFindReplaceDialog();
+    void showBatchReplaceDialog();
     void findNextString(const QString &query, bool isCaseSensitive, bool isExactString, bool isSearchBothTables);
     void changeCurrentTableItem(QTableWidgetItem *newItem);
     void goTo();
+    void goToNextModified();
+    void showTooLongStrings();
+    void goToListedRow(const QString &rowText) { _currentTableWidget->tableDifferencesItemChanged(rowText); }
+    void updateTooLongStringsWidget();
+    void showHashCollisions();
+    void refreshHashCollisions(HashCollisionsWidget *w) { w->showCollisionsOf(_currentTableWidget); }
 
     void updateToolbarStateInMenu() { ui.actionToolbar->setChecked(ui.mainToolBar->isVisible()); }
     void toggleRowsHeight(bool isSmall);
+    void changeRowOrder();
+    void changeRowFilter();
 
     void supplement();
     void swapTables();
     void activateAnotherTable();
     void showDifferences();
+    void showTranslationIssues();
+    void updateTranslationIssuesWidget();
+    void translationIssuesWidgetClosed();
     void syncScrollingChanged(bool isSyncing);
+    void syncCurrentCell() { syncTablesWith(qobject_cast<D2StringTableWidget *>(sender())); }
+    void syncScrollValue(int value);
 
     void editString(QTableWidgetItem *itemToEdit);
     void updateLocationLabel(int newRow);
@@ -67,45 +108,82 @@ private slots:
     void updateWindow(bool isModified = true);
     void updateItem(QTableWidgetItem *item);
     void refreshDifferences(TablesDifferencesWidget *w);
+    void restoreLastSession();
+    void fillRestoredTables();
+    void recoverTables();
+    void tableFileChanged(const QString &fileName);
+    void reloadChangedTables();
 
 private:
     Ui::QTblEditorClass ui;
     QSplitter *_tableSplitter;
-    TablePanelWidget *_leftTablePanelWidget, *_rightTablePanelWidget;
-    D2StringTableWidget *_currentTableWidget, *_leftTableWidget, *_rightTableWidget;
+    D2StringTableWidget *_currentTableWidget;
+    TableKeyIndex *_keyIndex;
+    TableLint *_tableLint; // checks rows of the current table against the other one while issues are shown
     FindReplaceDialog *_findReplaceDlg;
     QLabel *_locationLabel, *_keyHashLabel;
+    QProgressBar *_uploadProgressBar;
+    TableUploader *_uploader;
+    QFileSystemWatcher *_fileWatcher;
+    QTimer *_reloadTimer;
+    QStringList _changedFiles;
     QActionGroup *_startNumberingGroup;
+    QActionGroup *_rowOrderGroup, *_rowFilterGroup;
 
-    quint8 _openedTables; // 0, 1 or 2
     QString _lastPath;
     QStringList _recentFilesList;
-    bool _isTableLoaded;
-    QHash<QString, QVariant> _lastSelectedRowsHash;
+    bool _isTableLoaded, _isSyncingTables;
+    TableViewStateStore _viewStates;
+    QHash<QString, QByteArray> _abandonedJournals; // journal file name -> contents
+    qint64 _undoMemoryLimit;
+
+    QElapsedTimer _startupTimer; // until the first table of the last session is shown, invalid after that
+    QFutureWatcher<LoadedTable> *_sessionWatcher; // reads tables of the last session, 0 when they're restored
+    QStringList _sessionTablePaths;
+    QVariantList _sessionTableRows;
+    int _restoredTablesCount;
 
 
     void connectActions();
     int openTableMsgBoxResult();
 
     bool loadFile(const QString &fileName, bool shouldShowOpenOptions = true);
-    bool processTable(const QString &fileName);
-    bool processTblFile(QFile *inputFile);
-    bool processTxtOrCsvFile(QFile *inputFile);
+    int loadFiles(const QStringList &fileNames, const QVariantList &rows = QVariantList());
+    bool prepareTablePanel(bool shouldShowOpenOptions, bool *isAdded);
+    bool finishLoading(const LoadedTable &table, bool isAdded, TablePanelWidget *previousPanel);
+    void discardTablePanel(TablePanelWidget *w, TablePanelWidget *previousPanel);
+    bool processTable(const QString &fileName) { return processLoadedTable(loadTableFile(fileName)); }
+    bool processLoadedTable(const LoadedTable &table);
+    void mergeChangedTable(TablePanelWidget *w, const LoadedTable &table); // file was changed on disk
+    void populateTable(const KeyValuePairList &entries, int firstVisibleRow = 0);
 
     bool wasSaved();
     void enableTableActions(bool state);
     bool isDialogQuestionConfirmed(const QString &text);
 
     bool saveFile(const QString &fileName);
-    DWORD writeAsTbl(QByteArray &bytesToWrite);
+    void editHistoryApplied();
+    DWORD writeAsTbl(QByteArray &bytesToWrite, DWORD *savedBytes = 0);
     DWORD writeAsText(QByteArray &bytesToWrite, bool isCsv);
 
     void writeSettings();
     void readSettings();
 
-    TablePanelWidget *currentTablePanelWidget() const;
+    TablePanelWidget *addTablePanel();
+    QList<TablePanelWidget *> tablePanels() const;
+    QList<TablePanelWidget *> openedTablePanels() const;
+    int openedTablesCount() const { return openedTablePanels().size(); }
+    bool hasModifiedTables() const;
+    TablePanelWidget *tablePanelOf(QTableWidget *tableWidget) const;
+    QList<TablePanelWidget *> openedTablePanelsOf(const QString &fileName) const; // the same file can be opened several times
+    void updateWatchedFiles();
+    void lastSessionRestored();
+    void startupFinished();
+    TablePanelWidget *currentTablePanelWidget() const { return tablePanelOf(_currentTableWidget); }
     TablePanelWidget *inactiveNamedTableWidget(TablePanelWidget *namedTableToCheck) const;
     D2StringTableWidget *inactiveTableWidget(QTableWidget *tableToCheck) const;
+    void syncTablesWith(D2StringTableWidget *tableWidget);
+    void rememberViewState(TablePanelWidget *w);
 
     void tableMenuSetEnabled(bool isEnabled);
     void addToRecentFiles(const QString &fileName);
@@ -113,9 +191,11 @@ private:
     void closeAllDialogs() { foreach (QDialog *d, findChildren<QDialog *>()) d->close(); }
     void increaseRowCount(int rowIndex);
     QStringList differentStrings(TablesDifferencesWidget::DiffType diffType) const;
-
-    QString foldNewlines(const QString &s);
-    QString restoreNewlines(const QString &s);
+    QStringList tooLongStrings() const;
+    TablesDifferencesWidget *tooLongStringsWidget() const;
+    TablesDifferencesWidget *translationIssuesWidget() const;
+    void updateLintedTables();
+    void updateRowViewActions();
 };
 
 #endif // QTBLEDITOR_H
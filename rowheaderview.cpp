@@ -0,0 +1,101 @@
+#include "rowheaderview.h"
+
+#include <QPainter>
+#include <QItemSelectionModel>
+
+
+RowHeaderView::RowHeaderView(QWidget *parent) : QHeaderView(Qt::Vertical, parent), _displayHex(false), _startsFrom1(true)
+{
+    // all rows have the same height, so changing it doesn't depend on the number of rows
+    setDefaultAlignment(Qt::AlignCenter);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    setSectionResizeMode
+#else
+    setResizeMode
+#endif
+        (QHeaderView::Fixed);
+}
+
+QString RowHeaderView::rowText(int row) const
+{
+    int number = row + _startsFrom1;
+    QString text = QString::number(number);
+    if (_displayHex)
+        text += QString(" (0x%1)").arg(number, 0, 16);
+#ifdef Q_OS_MAC
+    text += "  "; // fixes slight text truncation
+#endif
+    return text;
+}
+
+void RowHeaderView::setDisplayHex(bool isHex)
+{
+    _displayHex = isHex;
+    numberingChanged();
+}
+
+void RowHeaderView::setStartsFrom1(bool startsFrom1)
+{
+    _startsFrom1 = startsFrom1;
+    numberingChanged();
+}
+
+void RowHeaderView::numberingChanged()
+{
+    if (count())
+        headerDataChanged(orientation(), 0, 0); // invalidates cached size hint
+    viewport()->update();
+    emit geometriesChanged(); // header width may change
+}
+
+void RowHeaderView::sectionsRearranged()
+{
+    viewport()->update();
+    emit geometriesChanged(); // table updates its scroll bars
+}
+
+void RowHeaderView::paintSection(QPainter *painter, const QRect &rect, int logicalIndex) const
+{
+    if (!rect.isValid())
+        return;
+
+    QStyleOptionHeader opt;
+    initStyleOption(&opt);
+    opt.rect = rect;
+    opt.section = logicalIndex;
+    opt.text = rowText(logicalIndex);
+    opt.textAlignment = defaultAlignment();
+
+    if (isEnabled())
+        opt.state |= QStyle::State_Enabled;
+    if (window()->isActiveWindow())
+        opt.state |= QStyle::State_Active;
+    if (highlightSections() && selectionModel())
+    {
+        if (selectionModel()->rowIntersectsSelection(logicalIndex, rootIndex()))
+            opt.state |= QStyle::State_On;
+        if (selectionModel()->isRowSelected(logicalIndex, rootIndex()))
+            opt.state |= QStyle::State_Sunken;
+    }
+
+    int visual = visualIndex(logicalIndex), sectionsNumber = count();
+    if (sectionsNumber == 1)
+        opt.position = QStyleOptionHeader::OnlyOneSection;
+    else if (visual == 0)
+        opt.position = QStyleOptionHeader::Beginning;
+    else if (visual == sectionsNumber - 1)
+        opt.position = QStyleOptionHeader::End;
+    else
+        opt.position = QStyleOptionHeader::Middle;
+
+    style()->drawControl(QStyle::CE_Header, &opt, painter, this);
+}
+
+QSize RowHeaderView::sectionSizeFromContents(int logicalIndex) const
+{
+    QStyleOptionHeader opt;
+    initStyleOption(&opt);
+    opt.section = logicalIndex;
+    opt.text = rowText(logicalIndex);
+    return style()->sizeFromContents(QStyle::CT_HeaderSection, &opt, QSize(), this);
+}
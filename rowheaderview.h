@@ -0,0 +1,29 @@
+#ifndef ROWHEADERVIEW_H
+#define ROWHEADERVIEW_H
+
+#include <QHeaderView>
+
+
+class RowHeaderView : public QHeaderView // computes row numbers on demand instead of storing a label for every row
+{
+public:
+    explicit RowHeaderView(QWidget *parent = 0);
+    virtual ~RowHeaderView() {}
+
+    QString rowText(int row) const;
+
+    void setDisplayHex(bool isHex);
+    void setStartsFrom1(bool startsFrom1);
+    void sectionsRearranged(); // must be called after sections were moved or hidden with signals blocked
+
+protected:
+    virtual void paintSection(QPainter *painter, const QRect &rect, int logicalIndex) const;
+    virtual QSize sectionSizeFromContents(int logicalIndex) const;
+
+private:
+    bool _displayHex, _startsFrom1;
+
+    void numberingChanged();
+};
+
+#endif // ROWHEADERVIEW_H
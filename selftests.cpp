@@ -0,0 +1,552 @@
+#include "selftests.h"
+#include "tableuploader.h"
+#include "tablefile.h"
+#include "mpqarchive.h"
+
+#include <QTcpSocket>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QEventLoop>
+#include <QTimer>
+#include <QStringList>
+
+#include <cstdio>
+
+
+StandInHttpServer::StandInHttpServer(QObject *parent) : QTcpServer(parent), _failuresLeft(0)
+{
+    connect(this, SIGNAL(newConnection()), SLOT(acceptConnections()));
+}
+
+void StandInHttpServer::acceptConnections()
+{
+    while (QTcpSocket *socket = nextPendingConnection())
+    {
+        connect(socket, SIGNAL(readyRead()), SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void StandInHttpServer::readRequest()
+{
+    // request may come in several parts, received bytes are kept with the socket until the body is complete
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    QByteArray bytes = socket->property("receivedBytes").toByteArray() + socket->readAll();
+    socket->setProperty("receivedBytes", bytes);
+
+    int headerEnd = bytes.indexOf("\r\n\r\n");
+    if (headerEnd == -1)
+        return;
+
+    Request request;
+    QList<QByteArray> headerLines = bytes.left(headerEnd).split('\n');
+    request.Path = headerLines.value(0).split(' ').value(1);
+    int contentLength = 0;
+    foreach (const QByteArray &line, headerLines.mid(1))
+    {
+        int colonIndex = line.indexOf(':');
+        QByteArray name = line.left(colonIndex).trimmed().toLower(), value = line.mid(colonIndex + 1).trimmed();
+        if (name == "content-length")
+            contentLength = value.toInt();
+        else if (name == "content-encoding")
+            request.ContentEncoding = value;
+    }
+    if (bytes.size() < headerEnd + 4 + contentLength)
+        return;
+    request.Body = bytes.mid(headerEnd + 4, contentLength);
+    socket->setProperty("receivedBytes", QByteArray());
+
+    QByteArray status = "200 OK", response = "OK";
+    if (_failuresLeft > 0)
+    {
+        _failuresLeft--;
+        status = "503 Service Unavailable";
+        response = "try again later";
+    }
+    request.Status = status.left(3).toInt();
+    _requests += request;
+
+    socket->write("HTTP/1.1 " + status + "\r\nContent-Type: text/plain\r\nContent-Length: " + QByteArray::number(response.size()) +
+                  "\r\nConnection: close\r\n\r\n" + response);
+    socket->disconnectFromHost();
+}
+
+
+static QByteArray inflated(const QByteArray &deflated)
+{
+    // qUncompress() wants the size first, but it's only a hint: the buffer grows until the data fits
+    quint32 sizeHint = deflated.size() * 4;
+    QByteArray bytes;
+    for (int shift = 24; shift >= 0; shift -= 8)
+        bytes += char(sizeHint >> shift);
+    return qUncompress(bytes + deflated);
+}
+
+// --test-upload: a generated table is sent to StandInHttpServer in small compressed chunks with the first request
+// failing, and the server must get every chunk once, in order, ending with a whole line, and the same text as *.txt
+int testUpload()
+{
+    StandInHttpServer server;
+    if (!server.listen(QHostAddress::LocalHost))
+    {
+        fprintf(stderr, "upload test: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+    server.failNextRequests(1);
+
+    // 2- and 3-byte UTF-8 characters would be broken if a chunk ended in the middle of a row
+    KeyValuePairList entries;
+    for (int i = 0; i < 3000; i++)
+        entries += KeyValuePair(QString("key%1").arg(i), QString("value %1 ").arg(i) + QChar(0x0436) + QChar(0x20AC) + QString(i % 50, 'x'));
+    QByteArray expectedText = textFileBytes(entries, '\t', '\"');
+
+    TableUploader uploader;
+    TableUploader::Options options;
+    options.ChunkSize = 4096;
+    options.IsCompressed = true;
+    QEventLoop loop;
+    QObject::connect(&uploader, SIGNAL(finished(bool, const QString &)), &loop, SLOT(quit()));
+    QTimer::singleShot(60000, &loop, SLOT(quit()));
+    uploader.start(QString("http://127.0.0.1:%1/upload?name=test").arg(server.serverPort()), entries, options);
+    loop.exec();
+
+    QStringList errors;
+    if (uploader.isRunning())
+        errors += "upload hasn't finished in time";
+
+    const QList<StandInHttpServer::Request> &requests = server.requests();
+    if (requests.size() < 2 || requests.at(0).Status != 503 || requests.at(1).Path != requests.at(0).Path)
+        errors += "failed request wasn't retried";
+
+    QByteArray receivedText;
+    int chunkIndex = 0;
+    bool isLastReceived = false;
+    foreach (const StandInHttpServer::Request &request, requests)
+    {
+        if (request.Status != 200)
+            continue;
+
+        QList<QByteArray> queryItems = request.Path.split('&');
+        if (!queryItems.contains("chunk=" + QByteArray::number(chunkIndex)))
+            errors += QString("chunk %1 came as %2").arg(chunkIndex).arg(QString::fromLatin1(request.Path));
+        if (isLastReceived)
+            errors += "chunks came after the last one";
+        isLastReceived = queryItems.contains("last=1");
+
+        QByteArray text = request.ContentEncoding == "deflate" ? inflated(request.Body) : request.Body;
+        if (!text.isEmpty() && !text.endsWith('\n'))
+            errors += QString("chunk %1 doesn't end with a whole line").arg(chunkIndex);
+        receivedText += text;
+        chunkIndex++;
+    }
+    if (!isLastReceived)
+        errors += "last chunk wasn't marked";
+    if (receivedText != expectedText)
+        errors += QString("server got %1 bytes of text instead of %2 or they differ").arg(receivedText.size()).arg(expectedText.size());
+
+    if (!errors.isEmpty())
+    {
+        foreach (const QString &error, errors)
+            fprintf(stderr, "upload test: %s\n", qPrintable(error));
+        return 1;
+    }
+    printf("upload test passed: %d requests, %d chunks, %d bytes of text\n", requests.size(), chunkIndex, receivedText.size());
+    return 0;
+}
+
+
+// MPQ archives are written only for --test-mpq. The format is implemented here once more instead of sharing code with
+// MpqArchive, so that the reader isn't checked against itself
+
+static const DWORD kMpqHeaderId = 0x1A51504D, kMpqNoBlock = 0xFFFFFFFF;
+static const DWORD kMpqImplode = 0x00000100, kMpqCompress = 0x00000200, kMpqEncrypted = 0x00010000, kMpqFixKey = 0x00020000,
+                   kMpqSingleUnit = 0x01000000, kMpqExists = 0x80000000; // flags of block table entries
+static const char kMpqCompressionZlib = 0x02, kMpqCompressionPkware = 0x08;
+enum MpqHashType {MpqHashTableOffset, MpqHashNameA, MpqHashNameB, MpqHashFileKey};
+
+struct MpqCryptTable
+{
+    DWORD Values[0x500];
+
+    MpqCryptTable()
+    {
+        DWORD seed = 0x00100001;
+        for (int i = 0; i < 0x100; i++)
+        {
+            for (int j = i; j < 0x500; j += 0x100)
+            {
+                seed = (seed * 125 + 3) % 0x2AAAAB;
+                DWORD high = (seed & 0xFFFF) << 0x10;
+                seed = (seed * 125 + 3) % 0x2AAAAB;
+                Values[j] = high | (seed & 0xFFFF);
+            }
+        }
+    }
+};
+static const MpqCryptTable mpqCryptTable;
+
+static DWORD mpqHash(const QByteArray &s, MpqHashType type)
+{
+    DWORD seed1 = 0x7FED7FED, seed2 = 0xEEEEEEEE;
+    for (int i = 0; i < s.size(); i++)
+    {
+        uchar c = s.at(i);
+        if (c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        seed1 = mpqCryptTable.Values[type * 0x100 + c] ^ (seed1 + seed2);
+        seed2 = c + seed1 + seed2 + (seed2 << 5) + 3;
+    }
+    return seed1;
+}
+
+static void appendLittleEndian(QByteArray *data, DWORD value, int size)
+{
+    for (int i = 0; i < size; i++)
+        data->append(char(value >> (i * 8)));
+}
+
+static QByteArray mpqEncrypted(const QByteArray &data, DWORD key)
+{
+    QByteArray result;
+    DWORD seed = 0xEEEEEEEE;
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+    int i = 0;
+    for (; i + 4 <= data.size(); i += 4) // trailing bytes aren't encrypted
+    {
+        seed += mpqCryptTable.Values[0x400 + (key & 0xFF)];
+        DWORD value = p[i] | p[i + 1] << 8 | p[i + 2] << 16 | DWORD(p[i + 3]) << 24;
+        appendLittleEndian(&result, value ^ (key + seed), 4);
+        key = ((~key << 0x15) + 0x11111111) | (key >> 0x0B);
+        seed = value + seed + (seed << 5) + 3;
+    }
+    return result + data.mid(i);
+}
+
+
+// PKWare DCL stream with coded literals and a 4 KB dictionary. Matches are the nearest earlier 3 bytes, so compression is
+// poor, but every kind of code is used. Codes are canonical Huffman codes with inverted bits, as in blast.c by Mark Adler
+class DclImploder
+{
+public:
+    DclImploder() : _bitBuffer(0), _bitCount(0) {}
+
+    QByteArray implode(const QByteArray &input)
+    {
+        static const uchar literalLengths[] =
+        {
+            11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8, 9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
+            7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12, 8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
+            44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45, 44, 173
+        };
+        static const uchar lengthLengths[] = {2, 35, 36, 53, 38, 23};
+        static const uchar distanceLengths[] = {2, 20, 53, 230, 247, 151, 248};
+        static const Code literalCode(literalLengths, sizeof(literalLengths)), lengthCode(lengthLengths, sizeof(lengthLengths)),
+                          distanceCode(distanceLengths, sizeof(distanceLengths));
+        static const int kDictionaryBits = 6, kMaxDistance = 64 << kDictionaryBits, kEndLength = 519;
+
+        _output.clear();
+        putBits(1, 8); // literals are coded
+        putBits(kDictionaryBits, 8);
+
+        const uchar *in = reinterpret_cast<const uchar *>(input.constData());
+        QHash<int, int> lastPositions; // of 3-byte sequences
+        for (int i = 0, n = input.size(); i < n; )
+        {
+            int length = 0, distance = 0;
+            if (i + 3 <= n && lastPositions.contains(sequenceAt(in, i)) && i - lastPositions.value(sequenceAt(in, i)) <= kMaxDistance)
+            {
+                distance = i - lastPositions.value(sequenceAt(in, i));
+                while (i + length < n && length < kEndLength - 1 && in[i + length - distance] == in[i + length]) // regions can overlap
+                    length++;
+            }
+            if (length < 3)
+                length = 0;
+            for (int j = i, end = i + qMax(length, 1); j < end && j + 3 <= n; j++)
+                lastPositions[sequenceAt(in, j)] = j;
+
+            if (length)
+            {
+                putBits(1, 1);
+                putLength(lengthCode, length);
+                putCode(distanceCode, (distance - 1) >> kDictionaryBits);
+                putBits((distance - 1) & ((1 << kDictionaryBits) - 1), kDictionaryBits);
+                i += length;
+            }
+            else
+            {
+                putBits(0, 1);
+                putCode(literalCode, in[i++]);
+            }
+        }
+
+        putBits(1, 1);
+        putLength(lengthCode, kEndLength);
+        if (_bitCount)
+            _output += char(_bitBuffer);
+        return _output;
+    }
+
+private:
+    struct Code
+    {
+        int Codes[256], Lengths[256];
+
+        // lengths are run-length coded: low nibble is the length, high nibble + 1 is the number of symbols.
+        // Codes of each length follow the codes of shorter ones in order of symbols
+        Code(const uchar *lengths, int size)
+        {
+            int n = 0;
+            for (int i = 0; i < size; i++)
+                for (int repeats = (lengths[i] >> 4) + 1; repeats; repeats--)
+                    Lengths[n++] = lengths[i] & 15;
+            int code = 0;
+            for (int len = 1; len <= 13; len++, code <<= 1)
+                for (int symbol = 0; symbol < n; symbol++)
+                    if (Lengths[symbol] == len)
+                        Codes[symbol] = code++;
+        }
+    };
+
+    QByteArray _output;
+    int _bitBuffer, _bitCount;
+
+    static int sequenceAt(const uchar *in, int i) { return in[i] | in[i + 1] << 8 | in[i + 2] << 16; }
+
+    void putBits(int value, int count) // least significant bits first
+    {
+        _bitBuffer |= value << _bitCount;
+        for (_bitCount += count; _bitCount >= 8; _bitCount -= 8)
+        {
+            _output += char(_bitBuffer);
+            _bitBuffer >>= 8;
+        }
+    }
+
+    void putCode(const Code &code, int symbol) // the most significant bit first
+    {
+        for (int bit = code.Lengths[symbol] - 1; bit >= 0; bit--)
+            putBits(((code.Codes[symbol] >> bit) & 1) ^ 1, 1);
+    }
+
+    void putLength(const Code &lengthCode, int length) // length 2 isn't used, so lengths 3..519 are enough
+    {
+        static const short base[16] = {3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264};
+        static const char extraBits[16] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+        int symbol = 0;
+        if (length > 3)
+            for (symbol = 2; symbol < 15 && base[symbol + 1] <= length; symbol++) {}
+        putCode(lengthCode, symbol);
+        putBits(length - base[symbol], extraBits[symbol]);
+    }
+};
+
+struct MpqTestFile
+{
+    QString Name;
+    QByteArray Data;
+    DWORD Flags;
+    QByteArray StoredData; // single unit stored as is instead of compressing Data, for known compressed streams
+
+    MpqTestFile(const QString &name, const QByteArray &data, DWORD flags, const QByteArray &storedData = QByteArray()) :
+        Name(name), Data(data), Flags(flags), StoredData(storedData) {}
+};
+
+static QByteArray mpqCompressed(const QByteArray &data, DWORD flags)
+{
+    QByteArray compressed = flags & kMpqImplode ? DclImploder().implode(data) : kMpqCompressionZlib + qCompress(data).mid(4);
+    return compressed.size() < data.size() ? compressed : data; // sectors that aren't smaller are stored
+}
+
+// format version 0 with 4 KB sectors: header, data of files, hash table and block table
+static bool writeMpqArchive(const QString &fileName, const QList<MpqTestFile> &files, QString *errorString)
+{
+    static const DWORD kHeaderSize = 32, kSectorSizeShift = 3, kSectorSize = 512 << kSectorSizeShift;
+    DWORD hashTableSize = 16; // power of 2 with free entries that end the search
+    while (hashTableSize <= DWORD(files.size()))
+        hashTableSize *= 2;
+
+    QByteArray fileData;
+    QVector<DWORD> hashTable(hashTableSize * 4, kMpqNoBlock), blockTable;
+    for (int blockIndex = 0; blockIndex < files.size(); blockIndex++)
+    {
+        const MpqTestFile &file = files.at(blockIndex);
+        DWORD filePos = kHeaderSize + fileData.size(), fileSize = file.Data.size(), flags = file.Flags | kMpqExists, key = 0;
+        if (flags & kMpqEncrypted)
+        {
+            key = mpqHash(file.Name.section('\\', -1).toLatin1(), MpqHashFileKey);
+            if (flags & kMpqFixKey)
+                key = (key + filePos) ^ fileSize;
+        }
+
+        bool isCompressed = flags & (kMpqImplode | kMpqCompress);
+        QByteArray block;
+        if (flags & kMpqSingleUnit)
+        {
+            block = !file.StoredData.isEmpty() ? file.StoredData : isCompressed ? mpqCompressed(file.Data, flags) : file.Data;
+            if (flags & kMpqEncrypted)
+                block = mpqEncrypted(block, key);
+        }
+        else
+        {
+            // compressed sectors are preceded by the table of their offsets, encrypted with the previous key
+            int sectorsNumber = (fileSize + kSectorSize - 1) / kSectorSize;
+            QByteArray sectorOffsets, sectors;
+            for (int i = 0; i < sectorsNumber; i++)
+            {
+                QByteArray sector = file.Data.mid(i * kSectorSize, kSectorSize);
+                if (isCompressed)
+                    sector = mpqCompressed(sector, flags);
+                if (flags & kMpqEncrypted)
+                    sector = mpqEncrypted(sector, key + i);
+                appendLittleEndian(&sectorOffsets, (sectorsNumber + 1) * 4 + sectors.size(), 4);
+                sectors += sector;
+            }
+            appendLittleEndian(&sectorOffsets, (sectorsNumber + 1) * 4 + sectors.size(), 4);
+            if (flags & kMpqEncrypted)
+                sectorOffsets = mpqEncrypted(sectorOffsets, key - 1);
+            block = isCompressed ? sectorOffsets + sectors : sectors;
+        }
+        fileData += block;
+        blockTable << filePos << DWORD(block.size()) << fileSize << flags;
+
+        // neutral locale and platform
+        QByteArray name = file.Name.toLatin1();
+        DWORD i = mpqHash(name, MpqHashTableOffset) % hashTableSize;
+        while (hashTable.at(i * 4 + 3) != kMpqNoBlock)
+            i = (i + 1) % hashTableSize;
+        hashTable[i * 4] = mpqHash(name, MpqHashNameA);
+        hashTable[i * 4 + 1] = mpqHash(name, MpqHashNameB);
+        hashTable[i * 4 + 2] = 0;
+        hashTable[i * 4 + 3] = blockIndex;
+    }
+
+    QByteArray hashTableData, blockTableData;
+    foreach (DWORD value, hashTable)
+        appendLittleEndian(&hashTableData, value, 4);
+    foreach (DWORD value, blockTable)
+        appendLittleEndian(&blockTableData, value, 4);
+    hashTableData = mpqEncrypted(hashTableData, mpqHash("(hash table)", MpqHashFileKey));
+    blockTableData = mpqEncrypted(blockTableData, mpqHash("(block table)", MpqHashFileKey));
+
+    QByteArray header;
+    DWORD hashTablePos = kHeaderSize + fileData.size(), blockTablePos = hashTablePos + hashTableData.size();
+    appendLittleEndian(&header, kMpqHeaderId, 4);
+    appendLittleEndian(&header, kHeaderSize, 4);
+    appendLittleEndian(&header, blockTablePos + blockTableData.size(), 4);
+    appendLittleEndian(&header, 0, 2); // format version
+    appendLittleEndian(&header, kSectorSizeShift, 2);
+    appendLittleEndian(&header, hashTablePos, 4);
+    appendLittleEndian(&header, blockTablePos, 4);
+    appendLittleEndian(&header, hashTableSize, 4);
+    appendLittleEndian(&header, files.size(), 4);
+
+    QFile archive(fileName);
+    QByteArray archiveData = header + fileData + hashTableData + blockTableData;
+    if (!archive.open(QIODevice::WriteOnly | QIODevice::Truncate) || archive.write(archiveData) != archiveData.size())
+    {
+        *errorString = archive.errorString();
+        return false;
+    }
+    return true;
+}
+
+// --test-mpq [<dir>]: the same generated table is stored in test.mpq in every way that reading supports and must be
+// read back from each file, also as "<dir>/test.mpq/<path>" like --convert and the editor open it. The decoder of
+// PKWare DCL is also checked with a stream from blast.c, so that it isn't tested only with the imploder above.
+// The archive is left in dir if it's given, otherwise it's written to a temporary directory and removed
+int testMpqArchives(const QString &dirPath)
+{
+    // repeated text gives both compressors something to do, tables are longer than a sector
+    KeyValuePairList entries;
+    for (int i = 0; i < 500; i++)
+        entries += KeyValuePair(QString("key%1").arg(i), QString("value %1 ").arg(i) + QChar(0x0436) + QString(i % 30, 'x'));
+    QByteArray tblBytes;
+    QString errorString;
+    if (!tableFileBytes(entries, "string.tbl", TableFormatOptions(), &tblBytes, &errorString))
+    {
+        fprintf(stderr, "MPQ test: %s\n", qPrintable(errorString));
+        return 1;
+    }
+
+    struct StoredTable
+    {
+        const char *Language, *Storage;
+        DWORD Flags;
+    };
+    static const StoredTable storedTables[] =
+    {
+        {"eng", "uncompressed", 0},
+        {"deu", "zlib sectors", kMpqCompress},
+        {"fra", "PKWare implode", kMpqImplode},
+        {"ita", "encrypted zlib", kMpqCompress | kMpqEncrypted},
+        {"esp", "implode with fixed key", kMpqImplode | kMpqEncrypted | kMpqFixKey},
+        {"pol", "single unit zlib", kMpqSingleUnit | kMpqCompress},
+        {"rus", "single unit implode with fixed key", kMpqSingleUnit | kMpqImplode | kMpqEncrypted | kMpqFixKey},
+        {"kor", "single unit encrypted", kMpqSingleUnit | kMpqEncrypted},
+    };
+    static const int storedTablesNumber = sizeof(storedTables) / sizeof(storedTables[0]);
+
+    QList<MpqTestFile> files;
+    QStringList tableNames;
+    for (int i = 0; i < storedTablesNumber; i++)
+    {
+        tableNames += QString("data\\local\\lng\\%1\\string.tbl").arg(storedTables[i].Language);
+        files += MpqTestFile(tableNames.last(), tblBytes, storedTables[i].Flags);
+    }
+    files += MpqTestFile("(listfile)", tableNames.join("\r\n").toLatin1(), kMpqCompress | kMpqEncrypted);
+
+    // the example from blast.c, both as an imploded file and as PKWare method of a compressed one
+    static const char kBlastExample[] = "\x00\x04\x82\x24\x25\x8f\x80\x7f";
+    QByteArray blastStream(kBlastExample, sizeof(kBlastExample) - 1), blastText("AIAIAIAIAIAIA");
+    files += MpqTestFile("blast\\imploded.txt", blastText, kMpqSingleUnit | kMpqImplode, blastStream);
+    files += MpqTestFile("blast\\compressed.txt", blastText, kMpqSingleUnit | kMpqCompress, kMpqCompressionPkware + blastStream);
+
+    QString archiveFileName = QDir(dirPath.isEmpty() ? QDir::tempPath() : dirPath).absoluteFilePath("test.mpq");
+    if (!writeMpqArchive(archiveFileName, files, &errorString))
+    {
+        fprintf(stderr, "MPQ test: %s: %s\n", qPrintable(QDir::toNativeSeparators(archiveFileName)), qPrintable(errorString));
+        return 1;
+    }
+
+    QStringList errors, sortedTableNames = tableNames;
+    sortedTableNames.sort();
+    { // archive is closed before it's removed
+        MpqArchive archive;
+        bool isOpened = archive.open(archiveFileName);
+        if (!isOpened)
+            errors += archive.errorString();
+        else if (archive.tableFileNames() != sortedTableNames)
+            errors += QString("archive lists tables %1 instead of %2").arg(archive.tableFileNames().join(", "), sortedTableNames.join(", "));
+        for (int i = 0; i < files.size() && isOpened; i++)
+        {
+            const MpqTestFile &file = files.at(i);
+            QString storage = i < storedTablesNumber ? storedTables[i].Storage : "known stream";
+            QByteArray bytes = archive.read(file.Name);
+            if (bytes.isNull())
+                errors += QString("%1 (%2) isn't read: %3").arg(file.Name, storage, archive.errorString());
+            else if (bytes != file.Data)
+                errors += QString("%1 (%2) has different contents").arg(file.Name, storage);
+            if (i >= storedTablesNumber)
+                continue;
+
+            KeyValuePairList readEntries;
+            if (!readTableFile(MpqArchive::joinPath(archiveFileName, file.Name), &readEntries, &errorString))
+                errors += QString("%1 (%2) isn't opened: %3").arg(file.Name, storage, errorString);
+            else if (readEntries != entries)
+                errors += QString("%1 (%2) has different entries").arg(file.Name, storage);
+        }
+    }
+    if (dirPath.isEmpty())
+        QFile::remove(archiveFileName);
+
+    if (!errors.isEmpty())
+    {
+        foreach (const QString &error, errors)
+            fprintf(stderr, "MPQ test: %s\n", qPrintable(error));
+        return 1;
+    }
+    printf("MPQ test passed: %d tables of %d bytes and the blast.c example\n", storedTablesNumber, tblBytes.size());
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef SELFTESTS_H
+#define SELFTESTS_H
+
+#include <QTcpServer>
+#include <QList>
+
+
+// checks of parts that need a counterpart outside the editor, run from the command line without the window.
+// each returns the process exit code and prints what went wrong
+int testUpload();
+int testMpqArchives(const QString &dirPath); // archive is kept in dirPath if it isn't empty
+
+
+// HTTP server on localhost that records POST requests instead of a real upload server
+class StandInHttpServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    struct Request
+    {
+        QByteArray Path, ContentEncoding, Body;
+        int Status; // sent in response
+    };
+
+    explicit StandInHttpServer(QObject *parent = 0);
+
+    void failNextRequests(int count) { _failuresLeft = count; } // they get 503 Service Unavailable
+    const QList<Request> &requests() const { return _requests; }
+
+private slots:
+    void acceptConnections();
+    void readRequest();
+
+private:
+    QList<Request> _requests;
+    int _failuresLeft;
+};
+
+#endif // SELFTESTS_H
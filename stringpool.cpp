@@ -0,0 +1,29 @@
+#include "stringpool.h"
+
+
+QSet<QString> StringPool::_strings;
+
+QString StringPool::intern(const QString &s)
+{
+    if (s.isEmpty())
+        return QString(); // all empty strings already share the same data
+
+    QSet<QString>::const_iterator it = _strings.constFind(s);
+    if (it != _strings.constEnd())
+        return *it;
+    _strings.insert(s);
+    return s;
+}
+
+void StringPool::squeeze()
+{
+    // a string is referenced only by the pool when its data isn't shared with anyone
+    QSet<QString>::iterator it = _strings.begin();
+    while (it != _strings.end())
+    {
+        if (it->isDetached())
+            it = _strings.erase(it);
+        else
+            ++it;
+    }
+}
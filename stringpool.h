@@ -0,0 +1,21 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QSet>
+#include <QString>
+
+
+// one copy of identical keys and values for all opened tables.
+// QString is implicitly shared, so an edited string simply detaches from the pooled copy
+class StringPool
+{
+public:
+    static QString intern(const QString &s);
+    static void squeeze(); // forgets strings that aren't used by any table anymore
+    static int size() { return _strings.size(); }
+
+private:
+    static QSet<QString> _strings;
+};
+
+#endif // STRINGPOOL_H
@@ -0,0 +1,210 @@
+#include "tableedithistory.h"
+#include "d2stringtablewidget.h"
+
+
+TableEditHistory::TableEditHistory(D2StringTableWidget *tableWidget) : QObject(tableWidget), _tableWidget(tableWidget), _index(0), _groupDepth(0),
+    _cleanIndex(0), _memoryUsage(0), _memoryLimit(kDefaultMemoryLimit), _isEnabled(false), _isApplying(false)
+{
+    connect(tableWidget->model(), SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(rowsInserted(QModelIndex, int, int)));
+    connect(tableWidget->model(), SIGNAL(rowsAboutToBeRemoved(QModelIndex, int, int)), SLOT(rowsAboutToBeRemoved(QModelIndex, int, int)));
+}
+
+void TableEditHistory::setEnabled(bool isEnabled)
+{
+    _isEnabled = isEnabled;
+    clear();
+}
+
+void TableEditHistory::setMemoryLimit(qint64 bytes)
+{
+    _memoryLimit = bytes;
+    shrinkToMemoryLimit();
+    emit changed();
+}
+
+void TableEditHistory::clear()
+{
+    _commands.clear();
+    _pendingCommand = Command();
+    _index = _groupDepth = _cleanIndex = 0;
+    _memoryUsage = 0;
+    emit changed();
+}
+
+void TableEditHistory::endGroup()
+{
+    if (_groupDepth && !--_groupDepth && !_pendingCommand.Edits.isEmpty())
+    {
+        push(_pendingCommand);
+        _pendingCommand = Command();
+    }
+}
+
+void TableEditHistory::textChanged(int row, int column, const QString &oldText, const QString &newText)
+{
+    if (isRecording())
+    {
+        TableEdit edit(TableEdit::TextChange, row, column, 1);
+        edit.OldText = oldText;
+        edit.NewText = newText;
+        record(edit);
+    }
+}
+
+void TableEditHistory::rowsInserted(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    if (isRecording())
+        record(TableEdit(TableEdit::RowsInsertion, first, -1, last - first + 1));
+}
+
+void TableEditHistory::rowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    if (!isRecording())
+        return;
+
+    TableEdit edit(TableEdit::RowsRemoval, first, -1, last - first + 1);
+    for (int i = first; i <= last; ++i)
+        edit.RowsContents += _tableWidget->entry(i);
+    record(edit);
+}
+
+void TableEditHistory::record(const TableEdit &edit)
+{
+    if (!_groupDepth)
+    {
+        Command command;
+        command.Edits += edit;
+        push(command);
+        return;
+    }
+
+    // consecutive row insertions/removals (e.g. when deleting selected rows one by one) are stored as one edit
+    if (!_pendingCommand.Edits.isEmpty())
+    {
+        TableEdit &lastEdit = _pendingCommand.Edits.last();
+        if (lastEdit.EditType == edit.EditType)
+        {
+            if (edit.EditType == TableEdit::RowsInsertion && edit.Row == lastEdit.Row + lastEdit.RowCount)
+            {
+                lastEdit.RowCount += edit.RowCount;
+                return;
+            }
+            if (edit.EditType == TableEdit::RowsRemoval && edit.Row == lastEdit.Row)
+            {
+                lastEdit.RowCount += edit.RowCount;
+                lastEdit.RowsContents += edit.RowsContents;
+                return;
+            }
+        }
+    }
+    _pendingCommand.Edits += edit;
+}
+
+void TableEditHistory::push(const Command &command)
+{
+    // new command makes redo impossible
+    if (_cleanIndex > _index)
+        _cleanIndex = -1;
+    while (_commands.size() > _index)
+        _memoryUsage -= _commands.takeLast().Size;
+
+    _commands += command;
+    updateCommandSize(_commands.last());
+    _index = _commands.size();
+    shrinkToMemoryLimit();
+
+    emit changed();
+}
+
+void TableEditHistory::undo()
+{
+    if (!canUndo())
+        return;
+
+    Command &command = _commands[--_index];
+    _isApplying = true;
+    for (int i = command.Edits.size() - 1; i >= 0; --i)
+        apply(command.Edits[i], true);
+    _isApplying = false;
+    updateCommandSize(command);
+    shrinkToMemoryLimit();
+
+    emit changed();
+}
+
+void TableEditHistory::redo()
+{
+    if (!canRedo())
+        return;
+
+    Command &command = _commands[_index++];
+    _isApplying = true;
+    for (int i = 0; i < command.Edits.size(); ++i)
+        apply(command.Edits[i], false);
+    _isApplying = false;
+    updateCommandSize(command);
+
+    emit changed();
+}
+
+void TableEditHistory::apply(TableEdit &edit, bool isUndo)
+{
+    switch (edit.EditType)
+    {
+    case TableEdit::TextChange:
+        _tableWidget->item(edit.Row, edit.Column)->setText(isUndo ? edit.OldText : edit.NewText);
+        break;
+    case TableEdit::RowsInsertion:
+    case TableEdit::RowsRemoval:
+        if (isUndo == (edit.EditType == TableEdit::RowsInsertion)) // rows must be removed
+        {
+            if (edit.EditType == TableEdit::RowsInsertion) // remember contents to be able to redo
+            {
+                edit.RowsContents.clear();
+                for (int i = 0; i < edit.RowCount; ++i)
+                    edit.RowsContents += _tableWidget->entry(edit.Row + i);
+            }
+            _tableWidget->model()->removeRows(edit.Row, edit.RowCount);
+        }
+        else
+        {
+            _tableWidget->model()->insertRows(edit.Row, edit.RowCount);
+            for (int i = 0; i < edit.RowCount; ++i)
+                _tableWidget->setEntry(edit.Row + i, edit.RowsContents.at(i).first, edit.RowsContents.at(i).second);
+            if (edit.EditType == TableEdit::RowsInsertion) // contents are in the table again
+                edit.RowsContents.clear();
+        }
+        break;
+    }
+}
+
+void TableEditHistory::updateCommandSize(Command &command)
+{
+    _memoryUsage -= command.Size;
+    command.Size = sizeof(Command);
+    foreach (const TableEdit &edit, command.Edits)
+        command.Size += editSize(edit);
+    _memoryUsage += command.Size;
+}
+
+void TableEditHistory::shrinkToMemoryLimit()
+{
+    // the oldest commands are dropped first, but the last undoable one is always kept
+    while (_memoryUsage > _memoryLimit && _index > 1)
+    {
+        _memoryUsage -= _commands.takeFirst().Size;
+        _index--;
+        if (_cleanIndex != -1)
+            _cleanIndex--;
+    }
+}
+
+qint64 TableEditHistory::editSize(const TableEdit &edit)
+{
+    qint64 size = sizeof(TableEdit) + (edit.OldText.size() + edit.NewText.size()) * sizeof(QChar);
+    foreach (const KeyValuePair &rowContents, edit.RowsContents)
+        size += sizeof(KeyValuePair) + (rowContents.first.size() + rowContents.second.size()) * sizeof(QChar);
+    return size;
+}
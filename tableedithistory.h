@@ -0,0 +1,95 @@
+#ifndef TABLEEDITHISTORY_H
+#define TABLEEDITHISTORY_H
+
+#include "tblstructure.h"
+
+#include <QObject>
+#include <QModelIndex>
+
+
+struct TableEdit // the smallest reversible change of a table
+{
+    enum Type {TextChange, RowsInsertion, RowsRemoval};
+
+    Type EditType;
+    int Row, Column, RowCount;     // Column is used only by TextChange, RowCount - by the rest
+    QString OldText, NewText;      // TextChange only
+    KeyValuePairList RowsContents; // contents of removed rows or of inserted rows that were undone
+
+    TableEdit() {}
+    TableEdit(Type type, int row, int column, int rowCount) : EditType(type), Row(row), Column(column), RowCount(rowCount) {}
+};
+
+
+class D2StringTableWidget;
+
+class TableEditHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const qint64 kDefaultMemoryLimit = 64 * 1024 * 1024;
+
+    explicit TableEditHistory(D2StringTableWidget *tableWidget);
+
+    bool isEnabled() const { return _isEnabled; }
+    void setEnabled(bool isEnabled);
+
+    bool canUndo() const { return _index > 0; }
+    bool canRedo() const { return _index < _commands.size(); }
+
+    // clean state is the one the table had when it was loaded or saved last time
+    bool isClean() const { return _index == _cleanIndex && _pendingCommand.Edits.isEmpty(); }
+    void setClean() { _cleanIndex = _index; }
+    void resetClean() { _cleanIndex = -1; } // table was changed outside of the history, e.g. merged with the file
+
+    qint64 memoryUsage() const { return _memoryUsage; }
+    qint64 memoryLimit() const { return _memoryLimit; }
+    void setMemoryLimit(qint64 bytes);
+
+    // all edits between these calls are undone/redone as a single command, calls can be nested
+    void beginGroup() { _groupDepth++; }
+    void endGroup();
+
+    void textChanged(int row, int column, const QString &oldText, const QString &newText);
+
+public slots:
+    void undo();
+    void redo();
+    void clear();
+
+signals:
+    void changed();
+
+private slots:
+    void rowsInserted(const QModelIndex &parent, int first, int last);
+    void rowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+
+private:
+    struct Command
+    {
+        QList<TableEdit> Edits;
+        qint64 Size;
+
+        Command() : Size(0) {}
+    };
+
+    D2StringTableWidget *_tableWidget;
+    QList<Command> _commands;
+    Command _pendingCommand;
+    int _index, _groupDepth;
+    int _cleanIndex; // -1 if the clean state can't be reached by undo/redo
+    qint64 _memoryUsage, _memoryLimit;
+    bool _isEnabled, _isApplying;
+
+    bool isRecording() const { return _isEnabled && !_isApplying; }
+    void record(const TableEdit &edit);
+    void push(const Command &command);
+    void apply(TableEdit &edit, bool isUndo);
+    void updateCommandSize(Command &command);
+    void shrinkToMemoryLimit();
+
+    static qint64 editSize(const TableEdit &edit);
+};
+
+#endif // TABLEEDITHISTORY_H
@@ -0,0 +1,455 @@
+#include "tablefile.h"
+#include "timing.h"
+#include "texttablecache.h"
+#include "gzipdevice.h"
+#include "mpqarchive.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QDir>
+#include <QBuffer>
+#include <QTextStream>
+#include <QSettings>
+#include <QSet>
+
+
+extern QList<QChar> colorCodes;
+extern QStringList colorStrings;
+extern QString colorHeader;
+
+
+QString foldNewlines(const QString &s)
+{
+    return QString(s).replace(QLatin1String("\n"), QLatin1String("\\n"));
+}
+
+QString restoreNewlines(const QString &s)
+{
+    return QString(s).replace(QLatin1String("\\n"), QLatin1String("\n"));
+}
+
+void appendTextLine(QByteArray *bytes, const QString &key, const QString &val, char separator, char wrappingChar)
+{
+    QByteArray keyLatin1 = TblStructure::encodeKey(foldNewlines(key)), valUtf8 = foldNewlines(val).toUtf8();
+    if (wrappingChar)
+        bytes->append(wrappingChar);
+    bytes->append(keyLatin1);
+    if (wrappingChar)
+        bytes->append(wrappingChar);
+
+    bytes->append(separator);
+
+    if (wrappingChar)
+        bytes->append(wrappingChar);
+    bytes->append(valUtf8.constData()); // up to the first null character like in *.tbl
+    if (wrappingChar)
+        bytes->append(wrappingChar);
+
+    bytes->append('\n');
+}
+
+QByteArray textFileBytes(const KeyValuePairList &entries, char separator, char wrappingChar)
+{
+    QByteArray bytes;
+    foreach (const KeyValuePair &entry, entries)
+        appendTextLine(&bytes, entry.first, entry.second, separator, wrappingChar);
+    return bytes;
+}
+
+void tblHashTablePlacement(const QVector<DWORD> &hashIndices, QVector<int> *buckets, QVector<int> *probes)
+{
+    int n = hashIndices.size();
+    QVector<bool> isOccupied(n, false);
+    buckets->resize(n);
+    probes->resize(n);
+    for (int i = 0; i < n; ++i)
+    {
+        int hashIndex = hashIndices.at(i), collisions = 0;
+        while (isOccupied.at(hashIndex))
+        {
+            collisions++;
+            hashIndex = (hashIndex + 1) % n;
+        }
+        isOccupied[hashIndex] = true;
+        (*buckets)[i] = hashIndex;
+        (*probes)[i] = collisions;
+    }
+}
+
+QByteArray tblFileBytes(const KeyValuePairList &entries, const QVector<DWORD> &rawKeyHashes, bool shouldShareStrings, DWORD *sharedBytes)
+{
+    int entriesNumber = entries.size();
+    QList<QByteArray> keys, vals;
+    for (WORD i = 0; i < entriesNumber; i++)
+    {
+        QString currentVal = entries.at(i).second; // replacing user-readable colors with their internal form
+        for (int j = 0; j < colorStrings.size(); j++)
+        {
+            if (currentVal.contains(colorStrings.at(j)) && j)
+                currentVal.replace(colorStrings.at(j), colorHeader + colorCodes.at(j - 1));
+            else
+                currentVal.replace(colorStrings.at(j), colorHeader); // string "\color;" found
+        }
+        keys += TblStructure::encodeKey(entries.at(i).first);
+        vals += currentVal.toUtf8();
+    }
+
+    DWORD dataStartOffset = TblHeader::size + entriesNumber*sizeof(WORD) + entriesNumber*TblHashNode::size;
+    QVector<DWORD> hashValues(entriesNumber);
+    for (WORD i = 0; i < entriesNumber; i++)
+        hashValues[i] = (rawKeyHashes.isEmpty() ? TblStructure::rawHashValue(keys.at(i).constData()) : rawKeyHashes.at(i)) % entriesNumber;
+    QVector<WORD> indices(entriesNumber);
+    QVector<TblHashNode> nodes(entriesNumber);
+    QVector<int> hashIndices, collisionsNumbers;
+    tblHashTablePlacement(hashValues, &hashIndices, &collisionsNumbers);
+    DWORD currentOffset = dataStartOffset, maxCollisionsNumber = 0, savedBytes = 0;
+    // identical values are written once and all their nodes point to the same bytes, the game doesn't care
+    QHash<QByteArray, DWORD> valOffsets;
+    QVector<bool> isValWritten(entriesNumber, true);
+    for (WORD i = 0; i < entriesNumber; i++)
+    {
+        QByteArray currentVal = vals.at(i);
+        DWORD hashValue = hashValues.at(i), hashIndex = hashIndices.at(i), currentCollisionsNumber = collisionsNumbers.at(i);
+        if (currentCollisionsNumber > maxCollisionsNumber)
+            maxCollisionsNumber = currentCollisionsNumber;
+        indices[i] = hashIndex;
+
+        // we need the size of UTF-8 data, not QString
+        WORD currentKeyLength = qstrlen(keys.at(i).constData()) + 1, currentValLength = qstrlen(currentVal.constData()) + 1;
+        // convenient constructor instead of nodes[hashIndex].Active = 1; ...
+        DWORD valOffset = currentOffset + currentKeyLength;
+        if (shouldShareStrings)
+        {
+            currentVal.truncate(currentValLength - 1); // only the part that is written to the file matters
+            QHash<QByteArray, DWORD>::const_iterator it = valOffsets.constFind(currentVal);
+            if (it != valOffsets.constEnd())
+            {
+                valOffset = it.value();
+                isValWritten[i] = false;
+                savedBytes += currentValLength;
+            }
+            else
+                valOffsets.insert(currentVal, valOffset);
+        }
+        nodes[hashIndex] = TblHashNode(1, i, hashValue, currentOffset, valOffset, currentValLength);
+        currentOffset += currentKeyLength + (isValWritten.at(i) ? currentValLength : 0);
+    }
+
+    QByteArray bytes(TblHeader::size, 0); // header will be filled in the end, so we reserve bytes for it
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out.skipRawData(TblHeader::size); // current offset for writing = 0x15
+    for (WORD i = 0; i < entriesNumber; i++)
+        out << indices[i];
+
+    for (WORD i = 0; i < entriesNumber; i++)
+        out << nodes[i];
+
+    for (WORD i = 0; i < entriesNumber; i++)
+    {
+        out.writeRawData(keys.at(i).constData(), keys.at(i).size() + 1);
+        if (isValWritten.at(i))
+            out.writeRawData(vals.at(i).constData(), qstrlen(vals.at(i).constData()) + 1);
+    }
+
+    DWORD fileSize = bytes.size();
+    out.device()->reset(); // current offset for writing = 0x00 (to write the header)
+    out << TblHeader(TblStructure::getCRC(bytes.data() + dataStartOffset, fileSize - dataStartOffset), entriesNumber,
+        entriesNumber, 1, dataStartOffset, maxCollisionsNumber + 1, fileSize); // convenient constructor
+
+    if (sharedBytes)
+        *sharedBytes = savedBytes;
+    return bytes;
+}
+
+bool readTblFile(QIODevice *device, KeyValuePairList *entries, QString *errorString, QList<int> *invalidUtf8Rows)
+{
+    QDataStream in(device);
+    in.setByteOrder(QDataStream::LittleEndian);
+    TblStructure tbl;
+    tbl.fillHeader(in); // reading header
+    DWORD numElem = tbl.header().FileSize - TblHeader::size; // number of bytes to read without header
+
+    // files on disk are mapped and buffers are used in place, so the file isn't copied before decoding
+    QByteArray table;
+    const char *tableData = 0;
+    DWORD tableSize = 0;
+    {
+        TimingSpan span("check tbl size");
+        QFile *file = qobject_cast<QFile *>(device);
+        QBuffer *buffer = qobject_cast<QBuffer *>(device);
+        if (file && numElem && file->size() >= qint64(TblHeader::size) + numElem)
+            tableData = reinterpret_cast<const char *>(file->map(TblHeader::size, numElem));
+        else if (buffer && buffer->data().size() >= qint64(TblHeader::size) + numElem)
+            tableData = buffer->data().constData() + TblHeader::size;
+
+        if (tableData)
+            tableSize = numElem;
+        else // compressed files
+        {
+            table = device->read(numElem);
+            tableData = table.constData();
+            tableSize = table.size();
+        }
+    }
+    if (tableSize != numElem)
+    {
+        device->close();
+        // messages are translated in the context of the main window where they used to live
+        *errorString = QCoreApplication::translate("QTblEditor", "Couldn't read entire file, read only %n byte(s) after header.\n"
+                                                   "Probably file is corrupted or wrong file format.", 0,
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+                                                   QCoreApplication::CodecForTr,
+#endif
+                                                   tableSize);
+        return false;
+    }
+
+    tbl.getStringTable(tableData, tableSize, entries);
+    device->close(); // also unmaps the file
+    if (invalidUtf8Rows)
+        *invalidUtf8Rows = tbl.invalidUtf8Rows();
+    return true;
+}
+
+bool readTxtOrCsvFile(QIODevice *device, bool isCsv, KeyValuePairList *entries, QString *errorString)
+{
+    QList<QByteArray> lines;
+    {
+        TimingSpan span("read text");
+        lines = device->readAll().split('\n'); // TODO: maybe read line by line to improve performance
+        device->close();
+    }
+    TimingSpan span("parse text");
+    if (lines.isEmpty())
+        return true;
+
+    int rows = lines.size() - 1; // don't include last empty line
+    QByteArray currentLine = lines.at(0).trimmed();
+    char separator = '\t', wrappingCharKey = '\"', wrappingCharValue = '\"';
+    if (isCsv || currentLine.contains("\",\"") || currentLine.contains("\";\""))
+    {
+        int secondDoubleQuoteIndex = currentLine.indexOf('\"', 1);
+        if (secondDoubleQuoteIndex == -1)
+        {
+            *errorString = QCoreApplication::translate("QTblEditor", "Wrong file format - all strings in *.csv should be wrapped in double quotes");
+            return false;
+        }
+        separator = currentLine.at(secondDoubleQuoteIndex + 1);
+    }
+    else
+    {
+        QList<QByteArray> s = currentLine.split(separator);
+        QByteArray currentKey = s.at(0), currentValue = s.value(1);
+        if (!currentKey.startsWith(wrappingCharKey) || !currentKey.endsWith(wrappingCharKey))
+            wrappingCharKey = 0;
+        if (!currentValue.startsWith(wrappingCharValue) || !currentValue.endsWith(wrappingCharValue))
+            wrappingCharValue = 0;
+    }
+
+    QByteArray keyValueSeparator(1, separator);
+    if (wrappingCharKey)
+        keyValueSeparator.prepend(wrappingCharKey);
+    if (wrappingCharValue)
+        keyValueSeparator.append(wrappingCharValue);
+
+    QString wrappingCharKeyString = wrappingCharKey ? QChar(wrappingCharKey) : QString(), wrappingCharValueString = wrappingCharValue ? QChar(wrappingCharValue) : QString();
+    QString utf8TblEditHeaderString = QString("%1Key%1%2%3Value%3").arg(wrappingCharKeyString, QChar(separator), wrappingCharValueString);
+    QString afj666HeaderString = QString("%1String Index%1%2%3Text%3").arg(wrappingCharKeyString, QChar(separator), wrappingCharValueString);
+    int i = 0;
+    if (currentLine == utf8TblEditHeaderString || currentLine == afj666HeaderString)
+    {
+        if (!rows)
+            return true;
+        currentLine = lines.at(++i);
+    }
+
+    entries->reserve(rows - i);
+    for (; i < rows; currentLine = lines.at(++i))
+    {
+        currentLine = currentLine.trimmed();
+        if (wrappingCharKey)
+            currentLine = currentLine.mid(1); // remove leading wrappingCharKeyString
+        if (wrappingCharValue)
+            currentLine.chop(1); // remove trailing wrappingCharValueString
+
+        int separatorIndex = currentLine.indexOf(keyValueSeparator);
+        if (separatorIndex == -1)
+        {
+            *errorString = QCoreApplication::translate("QTblEditor", "Wrong file format - separator is absent at line %1").arg(i + 1);
+            return false;
+        }
+
+        entries->append(KeyValuePair(restoreNewlines(TblStructure::decodeKey(currentLine.left(separatorIndex))),
+                                     restoreNewlines(QString::fromUtf8(currentLine.mid(separatorIndex + keyValueSeparator.length())))));
+    }
+    return true;
+}
+
+TableFormatOptions TableFormatOptions::fromSettings()
+{
+    QSettings settings;
+    settings.beginGroup("options");
+    TableFormatOptions options;
+    options.CsvSeparator = settings.value("isCsvSeparatorComma", true).toBool() ? ',' : ';';
+    options.TxtWrappingChar = settings.value("wrapTxtStrings", true).toBool() ? '\"' : 0;
+    options.ShouldShareStrings = settings.value("shareIdenticalTblStrings").toBool();
+    settings.endGroup();
+    return options;
+}
+
+bool tableFileBytes(const KeyValuePairList &entries, const QString &fileName, const TableFormatOptions &options, QByteArray *bytes, QString *errorString)
+{
+    QString extension = tableFileExtension(fileName);
+    if (extension == ".tbl")
+        *bytes = tblFileBytes(entries, QVector<DWORD>(), options.ShouldShareStrings);
+    else if (extension == ".txt")
+        *bytes = textFileBytes(entries, '\t', options.TxtWrappingChar);
+    else if (extension == ".csv")
+        *bytes = textFileBytes(entries, options.CsvSeparator, '\"');
+    else
+    {
+        *errorString = QCoreApplication::translate("QTblEditor", "Unknown format of file \"%1\"").arg(QDir::toNativeSeparators(fileName));
+        return false;
+    }
+    return true;
+}
+
+bool isCompressedTableFile(const QString &fileName)
+{
+    return fileName.endsWith(QLatin1String(".gz"), Qt::CaseInsensitive);
+}
+
+QString tableFileExtension(const QString &fileName)
+{
+    QString name = isCompressedTableFile(fileName) ? fileName.left(fileName.length() - 3) : fileName;
+    return name.right(4).toLower();
+}
+
+bool readTableFile(const QString &fileName, KeyValuePairList *entries, QString *errorString, QList<int> *invalidUtf8Rows)
+{
+    QString extension = tableFileExtension(fileName);
+    bool isText = extension == ".txt" || extension == ".csv";
+    if (isText && TextTableCache::read(fileName, entries))
+        return true;
+
+    QFile inputFile(fileName);
+    QBuffer archivedInput; // tables from MPQ are decompressed into memory
+    QIODevice *input = &inputFile;
+    QString archiveFileName, archivedFileName;
+    if (MpqArchive::splitPath(fileName, &archiveFileName, &archivedFileName))
+    {
+        MpqArchive archive;
+        QByteArray data;
+        if (archive.open(archiveFileName))
+            data = archive.read(archivedFileName);
+        if (data.isNull())
+        {
+            *errorString = QCoreApplication::translate("QTblEditor", "Error opening file \"%1\"\nReason: %2").arg(fileName, archive.errorString());
+            return false;
+        }
+        archivedInput.setData(data);
+        archivedInput.open(QIODevice::ReadOnly);
+        input = &archivedInput;
+    }
+    else if (!inputFile.open(QIODevice::ReadOnly))
+    {
+        *errorString = QCoreApplication::translate("QTblEditor", "Error opening file \"%1\"\nReason: %2").arg(fileName, inputFile.errorString());
+        return false;
+    }
+    GzipDevice compressedInput(input);
+    if (isCompressedTableFile(fileName))
+    {
+        if (!compressedInput.open(QIODevice::ReadOnly))
+        {
+            *errorString = QCoreApplication::translate("QTblEditor", "Error opening file \"%1\"\nReason: %2").arg(fileName, compressedInput.errorString());
+            return false;
+        }
+        input = &compressedInput;
+    }
+
+    if (extension == ".tbl")
+        return readTblFile(input, entries, errorString, invalidUtf8Rows);
+    if (isText)
+    {
+        if (!readTxtOrCsvFile(input, extension == ".csv", entries, errorString))
+            return false;
+        TextTableCache::write(fileName, *entries);
+        return true;
+    }
+
+    // arbitrary file opened
+    QTextStream in(input);
+    in.readLine();
+    QString secondLine = in.readLine(); // it should equal "X" if it's tbl file
+    input->reset();
+    if (secondLine.contains('\t') || secondLine.contains(';') || secondLine.contains(',')) // text format
+        return readTxtOrCsvFile(input, false, entries, errorString);
+    return readTblFile(input, entries, errorString, invalidUtf8Rows);
+}
+
+bool writeTableFile(const QString &fileName, const QByteArray &bytes, QString *errorString)
+{
+    QFile output(fileName);
+    if (!output.open(QIODevice::WriteOnly))
+    {
+        *errorString = QCoreApplication::translate("QTblEditor", "Error creating file \"%1\"\nReason: %2").arg(QDir::toNativeSeparators(fileName), output.errorString());
+        return false;
+    }
+
+    TimingSpan span("write to disk");
+    bool isWritten;
+    QString writeError;
+    if (isCompressedTableFile(fileName))
+    {
+        GzipDevice compressedOutput(&output);
+        isWritten = compressedOutput.open(QIODevice::WriteOnly) && compressedOutput.write(bytes) == bytes.size() && compressedOutput.finish();
+        writeError = compressedOutput.errorString();
+    }
+    else
+    {
+        isWritten = output.write(bytes) == bytes.size();
+        writeError = output.errorString();
+    }
+    isWritten = output.flush() && isWritten;
+    if (!isWritten)
+        *errorString = QCoreApplication::translate("QTblEditor", "Error writing file \"%1\"\nReason: %2").arg(QDir::toNativeSeparators(fileName), writeError);
+    return isWritten;
+}
+
+int stringMemoryUsage(const QString &s)
+{
+    const int kStringHeaderSize = 3 * sizeof(int) + sizeof(void *); // reference count, size, capacity and data offset
+    return s.isEmpty() ? 0 : kStringHeaderSize + (s.capacity() + 1) * sizeof(QChar);
+}
+
+qint64 entriesMemoryUsage(const KeyValuePairList &entries)
+{
+    // QList allocates each pair separately and keeps pointers to them
+    qint64 bytes = entries.size() * qint64(sizeof(KeyValuePair) + sizeof(void *));
+    QSet<const QChar *> countedData;
+    foreach (const KeyValuePair &entry, entries)
+    {
+        if (!countedData.contains(entry.first.constData()))
+        {
+            countedData.insert(entry.first.constData());
+            bytes += stringMemoryUsage(entry.first);
+        }
+        if (!countedData.contains(entry.second.constData()))
+        {
+            countedData.insert(entry.second.constData());
+            bytes += stringMemoryUsage(entry.second);
+        }
+    }
+    return bytes;
+}
+
+LoadedTable loadTableFile(const QString &fileName)
+{
+    TimingSpan span("load file");
+    LoadedTable table;
+    table.FileName = fileName;
+    table.IsLoaded = readTableFile(fileName, &table.Entries, &table.ErrorString, &table.InvalidUtf8Rows);
+    return table;
+}
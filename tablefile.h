@@ -0,0 +1,67 @@
+#ifndef TABLEFILE_H
+#define TABLEFILE_H
+
+#include "tblstructure.h"
+
+#include <QVector>
+
+
+class QIODevice;
+
+// table files are parsed without touching widgets, so several files can be read in worker threads at once
+
+QString foldNewlines(const QString &s);
+QString restoreNewlines(const QString &s);
+
+bool readTblFile(QIODevice *device, KeyValuePairList *entries, QString *errorString, QList<int> *invalidUtf8Rows = 0);
+bool readTxtOrCsvFile(QIODevice *device, bool isCsv, KeyValuePairList *entries, QString *errorString);
+// format is detected by extension or contents, invalidUtf8Rows are filled only for *.tbl
+bool readTableFile(const QString &fileName, KeyValuePairList *entries, QString *errorString, QList<int> *invalidUtf8Rows = 0);
+bool writeTableFile(const QString &fileName, const QByteArray &bytes, QString *errorString);
+
+// *.tbl.gz, *.txt.gz and *.csv.gz are read and written through gzip
+bool isCompressedTableFile(const QString &fileName);
+QString tableFileExtension(const QString &fileName); // lowercase extension of uncompressed file, e.g. ".tbl"
+
+// format: [wrapper]key[wrapper]<separator>[wrapper]value[wrapper]<newline>, no wrapper if wrappingChar is 0
+void appendTextLine(QByteArray *bytes, const QString &key, const QString &val, char separator, char wrappingChar);
+QByteArray textFileBytes(const KeyValuePairList &entries, char separator, char wrappingChar);
+
+// places keys in the hash table the same way as the game does: a key takes the next free bucket after its hash index
+void tblHashTablePlacement(const QVector<DWORD> &hashIndices, QVector<int> *buckets, QVector<int> *probes);
+// values have user-readable colors, rawKeyHashes are TblStructure::rawHashValue() of keys (computed if empty).
+// Identical values are written once if shouldShareStrings is set
+QByteArray tblFileBytes(const KeyValuePairList &entries, const QVector<DWORD> &rawKeyHashes, bool shouldShareStrings, DWORD *sharedBytes = 0);
+
+struct TableFormatOptions // how files are written when there's no window to ask
+{
+    char CsvSeparator, TxtWrappingChar;
+    bool ShouldShareStrings;
+
+    TableFormatOptions() : CsvSeparator(','), TxtWrappingChar('\"'), ShouldShareStrings(false) {}
+    static TableFormatOptions fromSettings(); // the same options as in the editor
+};
+
+// format is chosen by extension of fileName, returns false for unknown formats
+bool tableFileBytes(const KeyValuePairList &entries, const QString &fileName, const TableFormatOptions &options, QByteArray *bytes, QString *errorString);
+
+
+// approximate heap size, data of strings shared between entries is counted once
+int stringMemoryUsage(const QString &s); // 0 for empty strings, they use static data
+qint64 entriesMemoryUsage(const KeyValuePairList &entries);
+
+
+struct LoadedTable // result of reading a file in a worker thread
+{
+    QString FileName;
+    KeyValuePairList Entries;
+    QString ErrorString;
+    QList<int> InvalidUtf8Rows; // values in these rows were decoded with replacement characters
+    bool IsLoaded;
+
+    LoadedTable() : IsLoaded(false) {}
+};
+
+LoadedTable loadTableFile(const QString &fileName);
+
+#endif // TABLEFILE_H
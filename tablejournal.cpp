@@ -0,0 +1,267 @@
+#include "tablejournal.h"
+#include "d2stringtablewidget.h"
+#include "tableedithistory.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTimer>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
+
+
+static const quint32 kJournalMagic = 0x51544A31; // "QTJ1"
+static const int kFlushDelay = 1000; // ms
+
+QSet<QString> TableJournal::_openedJournalFileNames;
+
+TableJournal::TableJournal(D2StringTableWidget *tableWidget) : QObject(tableWidget), _tableWidget(tableWidget),
+    _flushTimer(new QTimer(this))
+{
+    _flushTimer->setSingleShot(true);
+    _flushTimer->setInterval(kFlushDelay);
+    connect(_flushTimer, SIGNAL(timeout()), SLOT(flush()));
+
+    // setItem() doesn't go through D2StringTableItem::setData(), but both emit dataChanged()
+    connect(tableWidget->model(), SIGNAL(dataChanged(QModelIndex, QModelIndex)), SLOT(dataChanged(QModelIndex, QModelIndex)));
+    connect(tableWidget->model(), SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(rowsInserted(QModelIndex, int, int)));
+    connect(tableWidget->model(), SIGNAL(rowsRemoved(QModelIndex, int, int)), SLOT(rowsRemoved(QModelIndex, int, int)));
+}
+
+TableJournal::~TableJournal()
+{
+    flush();
+    if (isOpened())
+        _openedJournalFileNames.remove(_file.fileName());
+}
+
+void TableJournal::open(const QString &tableFileName)
+{
+    close();
+
+    // panels with the same file take the first numbers that aren't used by other panels
+    int number = 1;
+    while (_openedJournalFileNames.contains(journalFileName(tableFileName, number)))
+        number++;
+    QDir().mkpath(journalsDirPath());
+    _file.setFileName(journalFileName(tableFileName, number));
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return; // editing works without the journal
+    _openedJournalFileNames.insert(_file.fileName());
+
+    QDataStream out(&_file);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << kJournalMagic << QDir::toNativeSeparators(tableFileName);
+}
+
+void TableJournal::close()
+{
+    if (!isOpened())
+        return;
+
+    _flushTimer->stop();
+    _pendingRecords.clear();
+    _file.close();
+    _file.remove();
+    _openedJournalFileNames.remove(_file.fileName());
+}
+
+void TableJournal::flush()
+{
+    _flushTimer->stop();
+    if (isOpened() && !_pendingRecords.isEmpty())
+    {
+        _file.write(_pendingRecords);
+        _file.flush();
+    }
+    _pendingRecords.clear();
+}
+
+void TableJournal::appendRecord(RecordType type, int row, int columnOrCount, const QString &text)
+{
+    if (!isOpened())
+        return;
+
+    QDataStream out(&_pendingRecords, QIODevice::Append);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << quint8(type) << qint32(row) << qint32(columnOrCount);
+    if (type == TextChange)
+        out << text;
+
+    if (!_flushTimer->isActive())
+        _flushTimer->start();
+}
+
+void TableJournal::recordSnapshot()
+{
+    if (!isOpened())
+        return;
+
+    QDataStream out(&_pendingRecords, QIODevice::Append);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << quint8(TableSnapshot) << qint32(_tableWidget->rowCount()) << qint32(0);
+    for (int i = 0, n = _tableWidget->rowCount(); i < n; ++i)
+    {
+        KeyValuePair entry = _tableWidget->entry(i);
+        out << entry.first << entry.second;
+    }
+    flush();
+}
+
+void TableJournal::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    if (!isOpened())
+        return;
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+    {
+        for (int column = topLeft.column(); column <= bottomRight.column(); ++column)
+        {
+            QTableWidgetItem *item = _tableWidget->item(row, column);
+            appendRecord(TextChange, row, column, item ? item->text() : QString());
+        }
+    }
+}
+
+void TableJournal::rowsInserted(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    appendRecord(RowsInsertion, first, last - first + 1);
+}
+
+void TableJournal::rowsRemoved(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    appendRecord(RowsRemoval, first, last - first + 1);
+}
+
+bool TableJournal::replay(const QByteArray &journal)
+{
+    QDataStream in(journal);
+    in.setVersion(QDataStream::Qt_4_6);
+    quint32 magic;
+    QString tableFileName;
+    in >> magic >> tableFileName;
+    if (in.status() != QDataStream::Ok || magic != kJournalMagic)
+        return false;
+
+    // replayed changes are recorded by this journal again, so that it stays valid if it crashes once more
+    _tableWidget->editHistory()->beginGroup();
+    while (!in.atEnd())
+    {
+        quint8 type;
+        qint32 row, columnOrCount;
+        QString text;
+        KeyValuePairList entries;
+        in >> type >> row >> columnOrCount;
+        if (type == TextChange)
+            in >> text;
+        else if (type == TableSnapshot)
+        {
+            for (int i = 0; i < row && in.status() == QDataStream::Ok; ++i)
+            {
+                KeyValuePair entry;
+                in >> entry.first >> entry.second;
+                entries += entry;
+            }
+        }
+        if (in.status() != QDataStream::Ok)
+            break; // the last record can be incomplete if the crash happened while writing it
+
+        switch (type)
+        {
+        case TextChange:
+            if (row < _tableWidget->rowCount())
+            {
+                if (QTableWidgetItem *item = _tableWidget->item(row, columnOrCount))
+                    item->setText(text);
+            }
+            break;
+        case RowsInsertion:
+            _tableWidget->model()->insertRows(row, columnOrCount);
+            for (int i = row; i < row + columnOrCount; ++i)
+                _tableWidget->setEntry(i, QString(), QString());
+            break;
+        case RowsRemoval:
+            _tableWidget->model()->removeRows(row, columnOrCount);
+            break;
+        case TableSnapshot: // row is the number of rows here
+            _tableWidget->setRowCount(0);
+            _tableWidget->insertEntries(0, entries);
+            break;
+        }
+    }
+    _tableWidget->editHistory()->endGroup();
+    return true;
+}
+
+QStringList TableJournal::abandonedJournals()
+{
+    QStringList journalFileNames;
+    QDir journalsDir(journalsDirPath());
+    foreach (const QString &fileName, journalsDir.entryList(QStringList("*.journal"), QDir::Files))
+    {
+        QFile journal(journalsDir.filePath(fileName));
+        if (!journal.open(QIODevice::ReadOnly))
+            continue;
+
+        QDataStream in(&journal);
+        in.setVersion(QDataStream::Qt_4_6);
+        quint32 magic;
+        QString tableFileName;
+        in >> magic >> tableFileName;
+        if (in.status() == QDataStream::Ok && magic == kJournalMagic && !in.atEnd()) // journals without changes are useless
+            journalFileNames += journal.fileName();
+        else
+        {
+            journal.close();
+            journal.remove();
+        }
+    }
+    return journalFileNames;
+}
+
+QByteArray TableJournal::journalContents(const QString &journalFileName)
+{
+    QFile journal(journalFileName);
+    return journal.open(QIODevice::ReadOnly) ? journal.readAll() : QByteArray();
+}
+
+QString TableJournal::tableFileNameOf(const QByteArray &journal)
+{
+    QDataStream in(journal);
+    in.setVersion(QDataStream::Qt_4_6);
+    quint32 magic;
+    QString tableFileName;
+    in >> magic >> tableFileName;
+    return in.status() == QDataStream::Ok && magic == kJournalMagic ? tableFileName : QString();
+}
+
+void TableJournal::removeAbandonedJournal(const QString &journalFileName)
+{
+    // tables restored from the last session may have started new journals with the same names
+    if (!_openedJournalFileNames.contains(journalFileName))
+        QFile::remove(journalFileName);
+}
+
+QString TableJournal::journalsDirPath()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QString dataPath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
+#else
+    QString dataPath = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+#endif
+    return dataPath + "/journals";
+}
+
+QString TableJournal::journalFileName(const QString &tableFileName, int number)
+{
+    // name doesn't depend on the way the path is written, number tells apart panels with the same file
+    QByteArray pathHash = QCryptographicHash::hash(QDir::cleanPath(QFileInfo(tableFileName).absoluteFilePath()).toUtf8(), QCryptographicHash::Md5);
+    return QString("%1/%2-%3.journal").arg(journalsDirPath(), QString(pathHash.toHex())).arg(number);
+}
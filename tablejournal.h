@@ -0,0 +1,61 @@
+#ifndef TABLEJOURNAL_H
+#define TABLEJOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QModelIndex>
+#include <QStringList>
+#include <QSet>
+
+
+class D2StringTableWidget;
+class QTimer;
+
+// every change of a table since it was loaded or saved is appended to a small journal file,
+// so unsaved edits can be replayed over the file after a crash. The journal is removed when it's not needed anymore.
+// Each table widget has its own journal, even if the same file is opened in several panels
+class TableJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TableJournal(D2StringTableWidget *tableWidget);
+    virtual ~TableJournal();
+
+    void open(const QString &tableFileName); // starts an empty journal, the table must be equal to the file
+    void close(); // removes the journal: table was closed or all changes were discarded
+    bool isOpened() const { return _file.isOpen(); }
+    void recordSnapshot(); // whole table, when it can't be described by changes of the file
+
+    bool replay(const QByteArray &journal); // applies changes as one undoable edit, returns false if the journal is damaged
+
+    static QStringList abandonedJournals(); // journal files left by a crashed session, a table can have several
+    static QByteArray journalContents(const QString &journalFileName);
+    static QString tableFileNameOf(const QByteArray &journal); // empty if the journal is damaged
+    static void removeAbandonedJournal(const QString &journalFileName); // unless an opened table has taken its name
+
+public slots:
+    void flush();
+
+private slots:
+    void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void rowsInserted(const QModelIndex &parent, int first, int last);
+    void rowsRemoved(const QModelIndex &parent, int first, int last);
+
+private:
+    enum RecordType {TextChange, RowsInsertion, RowsRemoval, TableSnapshot};
+
+    D2StringTableWidget *_tableWidget;
+    QFile _file;
+    QByteArray _pendingRecords; // written to the file in background after a short delay
+    QTimer *_flushTimer;
+
+    static QSet<QString> _openedJournalFileNames; // of all table widgets
+
+    void appendRecord(RecordType type, int row, int columnOrCount, const QString &text = QString());
+
+    static QString journalsDirPath();
+    static QString journalFileName(const QString &tableFileName, int number);
+};
+
+#endif // TABLEJOURNAL_H
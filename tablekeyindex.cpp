@@ -0,0 +1,48 @@
+#include "tablekeyindex.h"
+#include "d2stringtablewidget.h"
+
+
+void TableKeyIndex::addTable(D2StringTableWidget *tableWidget)
+{
+    _tables += tableWidget;
+    invalidate();
+
+    // the index is rebuilt lazily on the next lookup after any change
+    connect(tableWidget, SIGNAL(itemChanged(QTableWidgetItem *)), SLOT(invalidate()));
+    connect(tableWidget->model(), SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(invalidate()));
+    connect(tableWidget->model(), SIGNAL(rowsRemoved(QModelIndex, int, int)), SLOT(invalidate()));
+}
+
+int TableKeyIndex::rowOfKey(const QString &key, D2StringTableWidget *tableWidget)
+{
+    int tableIndex = _tables.indexOf(tableWidget);
+    if (tableIndex == -1)
+        return -1;
+
+    if (_isDirty)
+        rebuild();
+    QHash<QString, QVector<int> >::const_iterator it = _rows.constFind(key);
+    return it != _rows.constEnd() ? it.value().at(tableIndex) : -1;
+}
+
+void TableKeyIndex::rebuild()
+{
+    _rows.clear();
+    for (int t = 0, tables = _tables.size(); t < tables; ++t)
+    {
+        D2StringTableWidget *tableWidget = _tables.at(t);
+        for (int i = 0, n = tableWidget->rowCount(); i < n; ++i)
+        {
+            QTableWidgetItem *keyItem = tableWidget->item(i, 0);
+            if (!keyItem)
+                continue;
+
+            QVector<int> &rows = _rows[keyItem->text()];
+            if (rows.isEmpty())
+                rows.fill(-1, tables);
+            if (rows.at(t) == -1)
+                rows[t] = i;
+        }
+    }
+    _isDirty = false;
+}
@@ -0,0 +1,32 @@
+#ifndef TABLEKEYINDEX_H
+#define TABLEKEYINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+
+
+class D2StringTableWidget;
+
+class TableKeyIndex : public QObject // one index of keys for all opened tables, used to navigate between tables by key
+{
+    Q_OBJECT
+
+public:
+    explicit TableKeyIndex(QObject *parent = 0) : QObject(parent), _isDirty(true) {}
+
+    void addTable(D2StringTableWidget *tableWidget);
+    int rowOfKey(const QString &key, D2StringTableWidget *tableWidget); // first row with the key or -1
+
+public slots:
+    void invalidate() { _isDirty = true; }
+
+private:
+    QList<D2StringTableWidget *> _tables;
+    QHash<QString, QVector<int> > _rows; // row in each table from _tables, -1 if the key is absent
+    bool _isDirty;
+
+    void rebuild();
+};
+
+#endif // TABLEKEYINDEX_H
@@ -0,0 +1,309 @@
+#include "tablelint.h"
+#include "d2stringtablewidget.h"
+#include "coloredtext.h"
+#include "tablefile.h"
+#include "timing.h"
+
+#include <QTimer>
+#include <QtConcurrentMap>
+
+
+extern QStringList colorStrings;
+
+// each rule appends descriptions of found issues, strings are never empty and never equal
+typedef void (*LintRule)(const QString &source, const QString &translation, QStringList *issues);
+
+static QString quoted(const QString &s)
+{
+    return QString("\"%1\"").arg(foldNewlines(s));
+}
+
+static QString joinedOrNone(const QStringList &list, const QString &separator)
+{
+    return list.isEmpty() ? TableLint::tr("none") : list.join(separator);
+}
+
+
+static QStringList genderTags(const QString &text)
+{
+    QStringList tags;
+    for (int i = text.indexOf('['); i != -1; i = text.indexOf('[', i + 1))
+        if (isGenderTagAt(text, i))
+            tags += text.mid(i, kGenderTagLength);
+    return tags;
+}
+
+// text as displayed in game, without colors and gender tags
+static QString displayedText(const QString &text)
+{
+    QString displayed;
+    foreach (const ColoredTextRun &run, splitIntoColoredRuns(text))
+        displayed += run.Text;
+    for (int i = displayed.indexOf('['); i != -1; i = displayed.indexOf('[', i))
+    {
+        if (isGenderTagAt(displayed, i))
+            displayed.remove(i, kGenderTagLength);
+        else
+            i++;
+    }
+    return displayed;
+}
+
+static bool isPlaceholderType(QChar c)
+{
+    return c == 'd' || c == 's' || c == 'i' || c == 'u';
+}
+
+// %d, %s, %+d, numbered %0...%9 and the like; %% is an escaped percent sign
+static QStringList placeholders(const QString &text)
+{
+    QStringList result;
+    for (int i = text.indexOf('%'), n = text.length(); i != -1; i = text.indexOf('%', i))
+    {
+        int end = i + 1;
+        if (end < n && text.at(end) == '%')
+        {
+            i = end + 1;
+            continue;
+        }
+
+        if (end < n && (text.at(end) == '+' || text.at(end) == '-'))
+            end++;
+        int digitsStart = end;
+        while (end < n && text.at(end).isDigit())
+            end++;
+        if (end < n && isPlaceholderType(text.at(end)))
+            end++;
+        else if (end == digitsStart) // e.g. "50% chance"
+        {
+            i++;
+            continue;
+        }
+
+        result += text.mid(i, end - i);
+        i = end;
+    }
+    return result;
+}
+
+
+static void checkSurroundingCharacters(const QString &source, const QString &translation, QStringList *issues)
+{
+    QString sourceText = displayedText(source), translationText = displayedText(translation);
+    if (sourceText.isEmpty() || translationText.isEmpty())
+        return;
+
+    // suffix is searched only after prefix, so a string without letters has only prefix
+    int sourcePrefix = 0, translationPrefix = 0;
+    while (sourcePrefix < sourceText.length() && !sourceText.at(sourcePrefix).isLetterOrNumber())
+        sourcePrefix++;
+    while (translationPrefix < translationText.length() && !translationText.at(translationPrefix).isLetterOrNumber())
+        translationPrefix++;
+
+    int sourceSuffix = 0, translationSuffix = 0;
+    while (sourceSuffix < sourceText.length() - sourcePrefix && !sourceText.at(sourceText.length() - 1 - sourceSuffix).isLetterOrNumber())
+        sourceSuffix++;
+    while (translationSuffix < translationText.length() - translationPrefix && !translationText.at(translationText.length() - 1 - translationSuffix).isLetterOrNumber())
+        translationSuffix++;
+
+    QString sourceStart = sourceText.left(sourcePrefix), translationStart = translationText.left(translationPrefix);
+    if (sourceStart != translationStart)
+        issues->append(TableLint::tr("starts with %1 instead of %2").arg(quoted(translationStart), quoted(sourceStart)));
+    QString sourceEnd = sourceText.right(sourceSuffix), translationEnd = translationText.right(translationSuffix);
+    if (sourceEnd != translationEnd)
+        issues->append(TableLint::tr("ends with %1 instead of %2").arg(quoted(translationEnd), quoted(sourceEnd)));
+}
+
+static void checkPlaceholders(const QString &source, const QString &translation, QStringList *issues)
+{
+    QStringList sourcePlaceholders = placeholders(source), translationPlaceholders = placeholders(translation);
+    if (sourcePlaceholders == translationPlaceholders)
+        return;
+
+    // the game substitutes arguments in order, so swapped placeholders are as bad as missing ones
+    QStringList sortedSource = sourcePlaceholders, sortedTranslation = translationPlaceholders;
+    qSort(sortedSource);
+    qSort(sortedTranslation);
+    if (sortedSource == sortedTranslation)
+        issues->append(TableLint::tr("placeholders in order %1 instead of %2").arg(translationPlaceholders.join(" "), sourcePlaceholders.join(" ")));
+    else
+        issues->append(TableLint::tr("placeholders %1 instead of %2").arg(joinedOrNone(translationPlaceholders, " "), joinedOrNone(sourcePlaceholders, " ")));
+}
+
+static void checkColors(const QString &source, const QString &translation, QStringList *issues)
+{
+    // order of colors may change with order of words, but the same colors must be used the same number of times
+    QList<int> sourceColors = colorIndexes(source), translationColors = colorIndexes(translation);
+    qSort(sourceColors);
+    qSort(translationColors);
+    if (sourceColors == translationColors)
+        return;
+
+    QStringList sourceNames, translationNames;
+    foreach (int colorIndex, sourceColors)
+        sourceNames += colorStrings.at(colorIndex + 1);
+    foreach (int colorIndex, translationColors)
+        translationNames += colorStrings.at(colorIndex + 1);
+    issues->append(TableLint::tr("colors %1 instead of %2").arg(joinedOrNone(translationNames, QString()), joinedOrNone(sourceNames, QString())));
+}
+
+static void checkGenderTags(const QString &source, const QString &translation, QStringList *issues)
+{
+    // languages without genders (e.g. English) have no tags at all, so only two tagged strings are compared
+    QStringList sourceTags = genderTags(source), translationTags = genderTags(translation);
+    if (sourceTags.isEmpty() || translationTags.isEmpty() || sourceTags == translationTags)
+        return;
+    issues->append(TableLint::tr("gender tags %1 instead of %2").arg(translationTags.join(QString()), sourceTags.join(QString())));
+}
+
+static void checkNewlines(const QString &source, const QString &translation, QStringList *issues)
+{
+    int sourceLines = source.count('\n') + 1, translationLines = translation.count('\n') + 1;
+    if (sourceLines != translationLines)
+        issues->append(TableLint::tr("%1 lines instead of %2").arg(translationLines).arg(sourceLines));
+}
+
+static const LintRule kLintRules[] = {checkSurroundingCharacters, checkPlaceholders, checkColors, checkGenderTags, checkNewlines};
+
+
+TableLint::TableLint(QObject *parent) : QObject(parent), _sourceTable(0), _translationTable(0), _isFullLintNeeded(false)
+{
+    _lintTimer = new QTimer(this);
+    _lintTimer->setSingleShot(true);
+    _lintTimer->setInterval(0); // rows changed at once (Replace all, paste, undo) are checked together
+    connect(_lintTimer, SIGNAL(timeout()), SLOT(lintDirtyRows()));
+}
+
+QStringList TableLint::checkStrings(const QString &source, const QString &translation)
+{
+    QStringList issues;
+    if (source.isEmpty() || translation.isEmpty() || source == translation) // not translated yet
+        return issues;
+
+    for (size_t i = 0; i < sizeof(kLintRules) / sizeof(kLintRules[0]); ++i)
+        kLintRules[i](source, translation, &issues);
+    return issues;
+}
+
+void TableLint::setTables(D2StringTableWidget *sourceTable, D2StringTableWidget *translationTable)
+{
+    if (sourceTable == _sourceTable && translationTable == _translationTable)
+        return;
+
+    watchTable(_sourceTable, false);
+    watchTable(_translationTable, false);
+    _sourceTable = sourceTable;
+    _translationTable = translationTable;
+    watchTable(_sourceTable, true);
+    watchTable(_translationTable, true);
+    relintAll();
+}
+
+QStringList TableLint::issueRows() const
+{
+    QStringList rows;
+    for (int i = 0, n = _issues.size(); i < n; ++i)
+        if (!_issues.at(i).isEmpty())
+            rows.append(QString("%1 (0x%2): %3").arg(i + 1).arg(i + 1, 0, 16).arg(_issues.at(i).join("; ")));
+    return rows;
+}
+
+int TableLint::issuesCount() const
+{
+    int count = 0;
+    foreach (const QStringList &issues, _issues)
+        count += issues.size();
+    return count;
+}
+
+void TableLint::relintAll()
+{
+    _lintTimer->stop();
+    _dirtyRows.clear();
+    _isFullLintNeeded = false;
+
+    int rowCount = _sourceTable && _translationTable ? qMin(_sourceTable->rowCount(), _translationTable->rowCount()) : 0;
+    _issues = QVector<QStringList>(rowCount);
+    QList<int> rows;
+    for (int i = 0; i < rowCount; ++i)
+        rows += i;
+    lintRows(rows);
+    emit issuesChanged();
+}
+
+void TableLint::scheduleRelintAll()
+{
+    // rows are shifted, and right after insertion they have no items yet
+    _isFullLintNeeded = true;
+    _lintTimer->start();
+}
+
+void TableLint::itemChanged(QTableWidgetItem *item)
+{
+    if (item->column() != 1 || _isFullLintNeeded)
+        return;
+    _dirtyRows.insert(item->row());
+    _lintTimer->start();
+}
+
+void TableLint::lintDirtyRows()
+{
+    if (_isFullLintNeeded)
+    {
+        relintAll();
+        return;
+    }
+
+    QList<int> rows;
+    foreach (int row, _dirtyRows)
+        if (row < _issues.size())
+            rows += row;
+    _dirtyRows.clear();
+    if (rows.isEmpty())
+        return;
+
+    lintRows(rows);
+    emit issuesChanged();
+}
+
+static QString cellText(D2StringTableWidget *tableWidget, int row)
+{
+    QTableWidgetItem *item = tableWidget->item(row, 1);
+    return item ? item->text() : QString();
+}
+
+void TableLint::lintRows(const QList<int> &rows)
+{
+    if (rows.isEmpty())
+        return;
+
+    TimingSpan span("lint tables");
+    // items can be touched only in GUI thread, so workers get copies of strings
+    QVector<LintedRow> lintedRows(rows.size());
+    for (int i = 0, n = rows.size(); i < n; ++i)
+    {
+        lintedRows[i].Source = cellText(_sourceTable, rows.at(i));
+        lintedRows[i].Translation = cellText(_translationTable, rows.at(i));
+    }
+    QtConcurrent::blockingMap(lintedRows, TableLint::lintRow);
+    for (int i = 0, n = rows.size(); i < n; ++i)
+        _issues[rows.at(i)] = lintedRows.at(i).Issues;
+}
+
+void TableLint::watchTable(D2StringTableWidget *tableWidget, bool shouldWatch)
+{
+    if (!tableWidget)
+        return;
+
+    if (shouldWatch)
+    {
+        connect(tableWidget, SIGNAL(itemChanged(QTableWidgetItem *)), SLOT(itemChanged(QTableWidgetItem *)));
+        connect(tableWidget->model(), SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(scheduleRelintAll()));
+        connect(tableWidget->model(), SIGNAL(rowsRemoved(QModelIndex, int, int)), SLOT(scheduleRelintAll()));
+    }
+    else
+    {
+        tableWidget->disconnect(this);
+        tableWidget->model()->disconnect(this);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef TABLELINT_H
+#define TABLELINT_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+
+class QTimer;
+class QTableWidgetItem;
+class D2StringTableWidget;
+
+struct LintedRow // strings of one row in both tables and issues found in them
+{
+    QString Source, Translation;
+    QStringList Issues;
+};
+
+// checks that translation keeps technical parts of the source string: surrounding punctuation, placeholders,
+// colors, gender tags and line breaks. Rows with the same index are compared like in Tables > Differences
+class TableLint : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TableLint(QObject *parent = 0);
+
+    static QStringList checkStrings(const QString &source, const QString &translation); // runs all rules
+    static void lintRow(LintedRow &row) { row.Issues = checkStrings(row.Source, row.Translation); } // for QtConcurrent
+
+    void setTables(D2StringTableWidget *sourceTable, D2StringTableWidget *translationTable);
+    QStringList issueRows() const; // "row (0xrow): issue; issue" with 1-based rows, like in differences widget
+    int issuesCount() const;
+
+signals:
+    void issuesChanged();
+
+public slots:
+    void relintAll();
+
+private slots:
+    void scheduleRelintAll();
+    void itemChanged(QTableWidgetItem *item);
+    void lintDirtyRows();
+
+private:
+    D2StringTableWidget *_sourceTable, *_translationTable;
+    QVector<QStringList> _issues; // for each row of the shorter table
+    QSet<int> _dirtyRows;         // edited since the last check
+    bool _isFullLintNeeded;       // rows were inserted or removed
+    QTimer *_lintTimer;
+
+    void lintRows(const QList<int> &rows);
+    void watchTable(D2StringTableWidget *tableWidget, bool shouldWatch);
+};
+
+#endif // TABLELINT_H
@@ -0,0 +1,99 @@
+#include "tablemimedata.h"
+
+#include <QDataStream>
+
+
+// format: "key"<tab>"value" or "text" per line, newlines inside strings are folded to \n
+static void appendQuotedFoldedString(QString &out, const QString &s)
+{
+    out += '\"';
+    int start = 0, newlinePos;
+    while ((newlinePos = s.indexOf('\n', start)) != -1)
+    {
+        out += s.midRef(start, newlinePos - start);
+        out += QLatin1String("\\n");
+        start = newlinePos + 1;
+    }
+    out += s.midRef(start);
+    out += '\"';
+}
+
+
+const QString TableMimeData::kRowsMimeType("application/x-qtbleditor-rows");
+
+QStringList TableMimeData::formats() const
+{
+    return QStringList() << kRowsMimeType << "text/plain";
+}
+
+QVariant TableMimeData::retrieveData(const QString &mimeType, QVariant::Type type) const
+{
+    if (mimeType == kRowsMimeType)
+        return binaryData();
+    if (mimeType == "text/plain")
+        return text();
+    return QMimeData::retrieveData(mimeType, type);
+}
+
+QString TableMimeData::text() const
+{
+    if (_text.isNull() && !_records.isEmpty())
+    {
+        int length = 0;
+        foreach (const Record &r, _records)
+            length += r.Key.size() + r.Val.size() + 6;
+        _text.reserve(length);
+
+        for (int i = 0; i < _records.size(); ++i)
+        {
+            const Record &r = _records.at(i);
+            if (i)
+                _text += '\n';
+            if (r.Column != 1)
+                appendQuotedFoldedString(_text, r.Key);
+            if (r.Column == -1)
+                _text += '\t';
+            if (r.Column != 0)
+                appendQuotedFoldedString(_text, r.Val);
+        }
+    }
+    return _text;
+}
+
+QByteArray TableMimeData::binaryData() const
+{
+    if (_binaryData.isNull())
+    {
+        QDataStream out(&_binaryData, QIODevice::WriteOnly);
+        out << static_cast<quint32>(_records.size());
+        foreach (const Record &r, _records)
+            out << r.Column << r.Key << r.Val;
+    }
+    return _binaryData;
+}
+
+bool TableMimeData::readRecords(const QMimeData *data, QList<Record> *records)
+{
+    // copied in this instance - no decoding needed
+    if (const TableMimeData *tableData = qobject_cast<const TableMimeData *>(data))
+    {
+        *records = tableData->_records;
+        return true;
+    }
+
+    if (!data->hasFormat(kRowsMimeType))
+        return false;
+
+    QByteArray binaryData = data->data(kRowsMimeType);
+    QDataStream in(binaryData);
+    quint32 n;
+    in >> n;
+    records->clear();
+    for (quint32 i = 0; i < n && in.status() == QDataStream::Ok; ++i)
+    {
+        Record r;
+        in >> r.Column >> r.Key >> r.Val;
+        records->append(r);
+    }
+    return in.status() == QDataStream::Ok;
+}
@@ -0,0 +1,44 @@
+#ifndef TABLEMIMEDATA_H
+#define TABLEMIMEDATA_H
+
+#include <QMimeData>
+#include <QStringList>
+
+
+class TableMimeData : public QMimeData // renders copied rows only when clipboard consumer asks for them
+{
+    Q_OBJECT
+
+public:
+    struct Record
+    {
+        QString Key, Val;
+        qint8 Column; // -1 if both key and value were copied, otherwise index of the copied column
+
+        Record() : Column(-1) {}
+        Record(const QString &key, const QString &val, qint8 column) : Key(key), Val(val), Column(column) {}
+    };
+
+    static const QString kRowsMimeType;
+
+    explicit TableMimeData(const QList<Record> &records) : QMimeData(), _records(records) {}
+
+    virtual QStringList formats() const;
+    virtual bool hasFormat(const QString &mimeType) const { return formats().contains(mimeType); }
+
+    // reads rows copied by this or another QTblEditor instance, returns false if there are none
+    static bool readRecords(const QMimeData *data, QList<Record> *records);
+
+protected:
+    virtual QVariant retrieveData(const QString &mimeType, QVariant::Type type) const;
+
+private:
+    QList<Record> _records;
+    mutable QString _text;
+    mutable QByteArray _binaryData;
+
+    QString text() const;
+    QByteArray binaryData() const;
+};
+
+#endif // TABLEMIMEDATA_H
@@ -61,6 +61,9 @@ void TablePanelWidget::setWindowModified(bool isModified)
 
 void TablePanelWidget::updateRowCountLabel()
 {
-    int rows = ui.tableWidget->rowCount();
-    ui.rowCountLabel->setText(QString("%1 (0x%2)").arg(rows).arg(rows, 0, 16));
+    int rows = ui.tableWidget->rowCount(), visibleRows = ui.tableWidget->rowView()->visibleRowsCount();
+    if (visibleRows == rows)
+        ui.rowCountLabel->setText(QString("%1 (0x%2)").arg(rows).arg(rows, 0, 16));
+    else
+        ui.rowCountLabel->setText(tr("%1 of %2 (0x%3)").arg(visibleRows).arg(rows).arg(rows, 0, 16));
 }
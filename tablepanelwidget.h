@@ -19,6 +19,8 @@ public:
     QString absoluteFileName() const;
     QString fileName() const { return QFileInfo(absoluteFileName()).fileName(); }
     QString fileDirPath() const { return QFileInfo(absoluteFileName()).canonicalPath(); }
+    bool isOpened() const { return !absoluteFileName().isEmpty(); }
+    bool isSynced() const { return ui.syncCheckBox->isChecked(); }
 
     void setFilePath(const QString &newFilePath);
     void setActive(bool isActive);
@@ -0,0 +1,182 @@
+#include "tablerowview.h"
+#include "d2stringtablewidget.h"
+#include "rowheaderview.h"
+#include "timing.h"
+
+#include <algorithm>
+
+
+template <typename T>
+struct RowLessThan // rows with equal sort keys stay in file order regardless of direction
+{
+    const QVector<T> &Keys;
+    bool IsDescending;
+
+    RowLessThan(const QVector<T> &keys, bool isDescending) : Keys(keys), IsDescending(isDescending) {}
+
+    bool operator()(int a, int b) const
+    {
+        const T &keyA = Keys.at(a), &keyB = Keys.at(b);
+        if (keyA < keyB)
+            return !IsDescending;
+        if (keyB < keyA)
+            return IsDescending;
+        return a < b;
+    }
+};
+
+template <typename T>
+static void sortRowsByKeys(const QVector<T> &keys, bool isDescending, QVector<int> *rows)
+{
+    qSort(rows->begin(), rows->end(), RowLessThan<T>(keys, isDescending));
+}
+
+
+int TableRowView::visibleRowsCount() const
+{
+    QHeaderView *header = _tableWidget->verticalHeader();
+    return header->count() - header->hiddenSectionCount();
+}
+
+void TableRowView::setSortOrder(SortOrder order, bool isDescending)
+{
+    TimingSpan span("sort rows");
+    _sortOrder = order;
+    _isDescending = isDescending;
+    applyOrder(sortedRows(order, isDescending));
+}
+
+void TableRowView::setFilter(Filter filter)
+{
+    TimingSpan span("filter rows");
+    _filter = filter;
+    applyFilter(filteredRows(filter));
+}
+
+void TableRowView::reset()
+{
+    if (!isFileOrder())
+    {
+        setFilter(AllRows);
+        setSortOrder(FileOrder);
+    }
+}
+
+QVector<int> TableRowView::sortedRows(SortOrder order, bool isDescending) const
+{
+    int rowCount = _tableWidget->rowCount();
+    QVector<int> rows(rowCount);
+    for (int i = 0; i < rowCount; ++i)
+        rows[i] = i;
+    if (order == FileOrder)
+    {
+        if (isDescending)
+            std::reverse(rows.begin(), rows.end());
+        return rows;
+    }
+
+    // sort keys are taken once per row, strings are shared with items
+    if (order == ByKey || order == ByString)
+    {
+        QVector<QString> keys(rowCount);
+        for (int i = 0; i < rowCount; ++i)
+        {
+            QTableWidgetItem *item = _tableWidget->item(i, order == ByKey ? 0 : 1);
+            if (item)
+                keys[i] = item->text();
+        }
+        sortRowsByKeys(keys, isDescending, &rows);
+    }
+    else
+    {
+        QVector<quint32> keys(rowCount);
+        for (int i = 0; i < rowCount; ++i)
+        {
+            if (order == ByStringLength)
+            {
+                QTableWidgetItem *item = _tableWidget->item(i, 1);
+                keys[i] = item ? coloredTextLength(item->text()) : 0;
+            }
+            else if (order == ByKeyHash)
+                keys[i] = _tableWidget->keyHash(i);
+            else // ModifiedFirst
+                keys[i] = _tableWidget->isCellModified(i, 0) || _tableWidget->isCellModified(i, 1) ? 0 : 1;
+        }
+        sortRowsByKeys(keys, isDescending, &rows);
+    }
+    return rows;
+}
+
+QBitArray TableRowView::filteredRows(Filter filter) const
+{
+    int rowCount = _tableWidget->rowCount();
+    QBitArray visibleRows(rowCount, filter == AllRows);
+    if (filter == AllRows)
+        return visibleRows;
+
+    for (int i = 0; i < rowCount; ++i)
+    {
+        bool isVisible;
+        if (filter == ModifiedRows)
+            isVisible = _tableWidget->isCellModified(i, 0) || _tableWidget->isCellModified(i, 1);
+        else if (filter == EmptyStrings)
+        {
+            QTableWidgetItem *item = _tableWidget->item(i, 1);
+            isVisible = !item || item->text().isEmpty();
+        }
+        else // TooLongStrings
+            isVisible = _tableWidget->isRowTooLong(i);
+        if (isVisible)
+            visibleRows.setBit(i);
+    }
+    return visibleRows;
+}
+
+void TableRowView::applyOrder(const QVector<int> &rows)
+{
+    // moveSection() shifts every section between the old and the new place, which makes a whole permutation quadratic.
+    // A swap puts one row to its place for good and both places are found in the header's index maps, so the cost
+    // is at most one swap per row, and rows that are already in place cost nothing
+    QHeaderView *header = _tableWidget->verticalHeader();
+    bool wereSignalsBlocked = beginHeaderChanges();
+    for (int visual = 0, n = rows.size(); visual < n; ++visual)
+    {
+        int row = rows.at(visual);
+        if (header->logicalIndex(visual) != row)
+            header->swapSections(visual, header->visualIndex(row));
+    }
+    endHeaderChanges(wereSignalsBlocked);
+}
+
+void TableRowView::applyFilter(const QBitArray &visibleRows)
+{
+    // only rows that change visibility are touched, switching between filters doesn't depend on the table size.
+    // Sections are hidden in the header directly: with its updates disabled, hiding only records the size,
+    // positions of sections are recalculated once when the table relayouts
+    QHeaderView *header = _tableWidget->verticalHeader();
+    bool wereSignalsBlocked = beginHeaderChanges();
+    for (int i = 0, n = qMin(visibleRows.size(), header->count()); i < n; ++i)
+        if (header->isSectionHidden(i) == visibleRows.testBit(i))
+            header->setSectionHidden(i, !visibleRows.testBit(i));
+    endHeaderChanges(wereSignalsBlocked);
+}
+
+bool TableRowView::beginHeaderChanges()
+{
+    // header recalculates positions of all sections after each change and repaints the table, so it's done once
+    QHeaderView *header = _tableWidget->verticalHeader();
+    header->setUpdatesEnabled(false);
+    return header->blockSignals(true);
+}
+
+void TableRowView::endHeaderChanges(bool wereSignalsBlocked)
+{
+    QHeaderView *header = _tableWidget->verticalHeader();
+    header->blockSignals(wereSignalsBlocked);
+    header->setUpdatesEnabled(true);
+    _tableWidget->rowHeader()->sectionsRearranged();
+    _tableWidget->viewport()->update();
+    if (QTableWidgetItem *item = _tableWidget->currentItem())
+        if (!_tableWidget->isRowHidden(item->row()))
+            _tableWidget->scrollToItem(item);
+}
@@ -0,0 +1,45 @@
+#ifndef TABLEROWVIEW_H
+#define TABLEROWVIEW_H
+
+#include <QVector>
+#include <QBitArray>
+
+
+class D2StringTableWidget;
+
+// order and visibility of rows on screen. Rows are only moved and hidden in the vertical header, so the model
+// keeps file order: saving, edit history, row numbers and comparison with other tables aren't affected
+class TableRowView
+{
+public:
+    enum SortOrder {FileOrder, ByKey, ByString, ByStringLength, ByKeyHash, ModifiedFirst};
+    enum Filter {AllRows, ModifiedRows, EmptyStrings, TooLongStrings};
+
+    explicit TableRowView(D2StringTableWidget *tableWidget) : _tableWidget(tableWidget), _sortOrder(FileOrder), _isDescending(false), _filter(AllRows) {}
+
+    SortOrder sortOrder() const { return _sortOrder; }
+    bool isDescending() const { return _isDescending; }
+    Filter filter() const { return _filter; }
+    bool isFileOrder() const { return _sortOrder == FileOrder && !_isDescending && _filter == AllRows; }
+    int visibleRowsCount() const;
+
+    void setSortOrder(SortOrder order, bool isDescending = false);
+    void setFilter(Filter filter);
+    void reset(); // file order, all rows are visible
+
+    QVector<int> sortedRows(SortOrder order, bool isDescending) const; // logical rows in visual order
+    QBitArray filteredRows(Filter filter) const;                      // bit is set for visible rows
+
+private:
+    D2StringTableWidget *_tableWidget;
+    SortOrder _sortOrder;
+    bool _isDescending;
+    Filter _filter;
+
+    void applyOrder(const QVector<int> &rows);
+    void applyFilter(const QBitArray &visibleRows);
+    bool beginHeaderChanges();
+    void endHeaderChanges(bool wereSignalsBlocked);
+};
+
+#endif // TABLEROWVIEW_H
@@ -11,14 +11,39 @@ TablesDifferencesWidget::TablesDifferencesWidget(QWidget *parent, DiffType diffT
         setWindowTitle(tr("Different keys"));
     else if (diffType == TablesDifferencesWidget::Strings)
         setWindowTitle(tr("Different strings"));
+    else if (diffType == TablesDifferencesWidget::TooLongStrings)
+        setWindowTitle(tr("Too long strings"));
+    else if (diffType == TablesDifferencesWidget::TranslationIssues)
+        setWindowTitle(tr("Translation issues"));
     else
         setWindowTitle(tr("Different keys & strings"));
 
     connect(ui.refreshButton, SIGNAL(clicked()), SLOT(refreshButtonClicked()));
 }
 
-void TablesDifferencesWidget::addRows(const QStringList &rowStrings)
+void TablesDifferencesWidget::setRows(const QStringList &rowStrings)
 {
-    ui.rowsListWidget->addItems(rowStrings);
+    replaceListedRows(ui.rowsListWidget, rowStrings);
     ui.rowsListWidget->setToolTip(QString("%1 items").arg(rowStrings.size()));
 }
+
+void TablesDifferencesWidget::replaceListedRows(QListWidget *listWidget, const QStringList &rowStrings)
+{
+    // clear() emits currentTextChanged("") which would move the table cursor to nowhere
+    QListWidgetItem *currentItem = listWidget->currentItem();
+    QString currentRowPrefix = currentItem ? currentItem->text().section(' ', 0, 0) + " (" : QString();
+
+    bool wereSignalsBlocked = listWidget->blockSignals(true);
+    listWidget->clear();
+    listWidget->addItems(rowStrings);
+    if (!currentRowPrefix.isEmpty())
+    {
+        QList<QListWidgetItem *> items = listWidget->findItems(currentRowPrefix, Qt::MatchStartsWith);
+        if (!items.isEmpty())
+        {
+            listWidget->setCurrentItem(items.first());
+            listWidget->scrollToItem(items.first());
+        }
+    }
+    listWidget->blockSignals(wereSignalsBlocked);
+}
@@ -9,15 +9,18 @@ class TablesDifferencesWidget : public QWidget
     Q_OBJECT
 
 public:
-    enum DiffType {Keys, Strings, KeysOrStrings, SameStrings};
+    enum DiffType {Keys, Strings, KeysOrStrings, SameStrings, TooLongStrings, TranslationIssues};
 
     explicit TablesDifferencesWidget(QWidget *parent, DiffType diffType);
 
     DiffType diffType() const { return _diffType; }
     QListWidget *listWidget() const { return ui.rowsListWidget; }
 
-    void clear() { ui.rowsListWidget->clear(); }
-    void addRows(const QStringList &rowStrings);
+    void setRows(const QStringList &rowStrings);
+
+    // rows start with their number, the row that was current stays current. The list is refilled without emitting
+    // currentTextChanged(), which is connected to the navigation in table
+    static void replaceListedRows(QListWidget *listWidget, const QStringList &rowStrings);
 
 signals:
     void refreshRequested(TablesDifferencesWidget *w);
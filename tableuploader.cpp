@@ -0,0 +1,166 @@
+#include "tableuploader.h"
+#include "tablefile.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QUrl>
+
+
+static const int kRowsPerSerializationStep = 2000;
+
+TableUploader::TableUploader(QObject *parent) : QObject(parent), _networkManager(new QNetworkAccessManager(this)), _reply(0),
+    _serializationTimer(new QTimer(this)), _retryTimer(new QTimer(this)), _isRunning(false), _nextRow(-1), _isCurrentChunkLast(false),
+    _chunkIndex(0), _retriesCount(0), _sentBytes(0), _totalBytes(-1)
+{
+    _serializationTimer->setInterval(0); // next rows are serialized when the event loop is idle
+    connect(_serializationTimer, SIGNAL(timeout()), SLOT(serializeNextRows()));
+
+    _retryTimer->setSingleShot(true);
+    connect(_retryTimer, SIGNAL(timeout()), SLOT(postChunk()));
+}
+
+void TableUploader::start(const QString &url, const KeyValuePairList &entries, const Options &options)
+{
+    abort();
+
+    _url = url;
+    _entries = entries;
+    _options = options;
+    _isRunning = true;
+    _nextRow = 0;
+    _chunkIndex = _retriesCount = 0;
+    _sentBytes = 0;
+    _totalBytes = -1;
+    _serializationTimer->start();
+}
+
+void TableUploader::abort()
+{
+    _serializationTimer->stop();
+    _retryTimer->stop(); // otherwise it would resend the old chunk in the next upload
+    if (_reply)
+    {
+        _reply->disconnect(this);
+        _reply->abort();
+        _reply->deleteLater();
+        _reply = 0;
+    }
+
+    _isRunning = false;
+    _entries.clear();
+    _pendingText.clear();
+    _readyChunks.clear();
+    _currentChunk.clear();
+}
+
+void TableUploader::serializeNextRows()
+{
+    int lastRow = qMin(_nextRow + kRowsPerSerializationStep, _entries.size());
+    for (int i = _nextRow; i < lastRow; ++i)
+    {
+        appendTextLine(&_pendingText, _entries.at(i).first, _entries.at(i).second, '\t', '\"');
+        // chunk ends with a whole line, so neither rows nor UTF-8 sequences are split between requests
+        if (_options.ChunkSize > 0 && _pendingText.size() >= _options.ChunkSize)
+        {
+            _readyChunks += _pendingText;
+            _pendingText.clear();
+        }
+    }
+    _nextRow = lastRow;
+
+    if (_nextRow == _entries.size())
+    {
+        _serializationTimer->stop();
+        _totalBytes = _sentBytes + _pendingText.size() + _currentChunk.size();
+        foreach (const QByteArray &chunk, _readyChunks)
+            _totalBytes += chunk.size();
+
+        // the last chunk is sent even if it's empty to tell the server that the table is complete
+        if (_options.ChunkSize <= 0 || !_pendingText.isEmpty() || _readyChunks.isEmpty())
+            _readyChunks += _pendingText;
+        _pendingText.clear();
+        _entries.clear();
+        _nextRow = -1;
+    }
+    sendNextChunk();
+}
+
+void TableUploader::sendNextChunk()
+{
+    if (_reply || _retryTimer->isActive() || _readyChunks.isEmpty()) // current chunk isn't sent yet
+        return;
+
+    _currentChunk = _readyChunks.takeFirst();
+    _isCurrentChunkLast = _nextRow == -1 && _readyChunks.isEmpty();
+    _retriesCount = 0;
+    postChunk();
+}
+
+void TableUploader::postChunk()
+{
+    QString url = _url;
+    if (_options.ChunkSize > 0)
+    {
+        url += QString("&chunk=%1").arg(_chunkIndex);
+        if (_isCurrentChunkLast)
+            url += "&last=1";
+    }
+
+    QNetworkRequest request((QUrl(url)));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+    QByteArray body = _currentChunk;
+    if (_options.IsCompressed)
+    {
+        body = qCompress(body).mid(4); // zlib stream without Qt's size prefix is what HTTP calls deflate
+        request.setRawHeader("Content-Encoding", "deflate");
+    }
+
+    _reply = _networkManager->post(request, body);
+    connect(_reply, SIGNAL(finished()), SLOT(requestFinished()));
+    connect(_reply, SIGNAL(uploadProgress(qint64, qint64)), SLOT(requestProgress(qint64, qint64)));
+}
+
+void TableUploader::requestProgress(qint64 bytesSent, qint64 bytesTotal)
+{
+    if (bytesTotal > 0) // sent part of the compressed body is mapped onto the text
+        emit progressChanged(_sentBytes + _currentChunk.size() * bytesSent / bytesTotal, _totalBytes);
+}
+
+void TableUploader::requestFinished()
+{
+    QNetworkReply *reply = _reply;
+    _reply = 0;
+    reply->deleteLater();
+
+    if (reply->error() != QNetworkReply::NoError)
+    {
+        int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        bool isTemporary = httpStatus == 0 || httpStatus >= 500; // no response or server error
+        if (isTemporary && _retriesCount < _options.MaxRetries)
+        {
+            _retriesCount++;
+            _retryTimer->start(1000 * _retriesCount);
+        }
+        else
+            finish(false, reply->errorString());
+        return;
+    }
+
+    _sentBytes += _currentChunk.size();
+    _currentChunk.clear(); // it's counted in sent bytes now, total of the rest must not include it again
+    _chunkIndex++;
+    emit progressChanged(_sentBytes, _totalBytes);
+
+    if (_isCurrentChunkLast)
+        finish(true, QString::fromUtf8(reply->readAll()));
+    else
+        sendNextChunk();
+}
+
+void TableUploader::finish(bool isSuccess, const QString &response)
+{
+    abort();
+    emit finished(isSuccess, response);
+}
@@ -0,0 +1,71 @@
+#ifndef TABLEUPLOADER_H
+#define TABLEUPLOADER_H
+
+#include "tblstructure.h"
+
+#include <QObject>
+#include <QStringList>
+
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+// sends a table as quoted tab-delimited text without blocking the editor.
+// text is produced in batches of rows from a snapshot of entries, so the table can be edited meanwhile.
+// with chunk size set, every chunk is posted as soon as it's ready with "&chunk=N" appended to the URL
+// and "&last=1" for the final one; otherwise the whole table is sent in one request like before
+class TableUploader : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        int ChunkSize;     // bytes of uncompressed text in one request (rounded up to a whole line), 0 - don't split
+        bool IsCompressed; // body is deflated with "Content-Encoding: deflate"
+        int MaxRetries;    // for each request on network errors and 5xx responses
+
+        Options() : ChunkSize(0), IsCompressed(false), MaxRetries(3) {}
+    };
+
+    explicit TableUploader(QObject *parent = 0);
+
+    bool isRunning() const { return _isRunning; }
+    void start(const QString &url, const KeyValuePairList &entries, const Options &options = Options());
+    void abort();
+
+signals:
+    void progressChanged(qint64 sentBytes, qint64 totalBytes); // totalBytes is -1 while text is still being produced
+    void finished(bool isSuccess, const QString &response); // response text or error description
+
+private slots:
+    void serializeNextRows();
+    void requestFinished();
+    void requestProgress(qint64 bytesSent, qint64 bytesTotal);
+    void postChunk();
+
+private:
+    QNetworkAccessManager *_networkManager;
+    QNetworkReply *_reply;
+    QTimer *_serializationTimer;
+    QTimer *_retryTimer;
+
+    QString _url;
+    KeyValuePairList _entries;
+    Options _options;
+    bool _isRunning;
+
+    int _nextRow;                 // first row that isn't serialized yet, -1 when all rows are
+    QByteArray _pendingText;      // serialized, but not enough for a chunk yet
+    QList<QByteArray> _readyChunks;
+    QByteArray _currentChunk;     // being sent, kept uncompressed for retries and progress
+    bool _isCurrentChunkLast;
+    int _chunkIndex, _retriesCount;
+    qint64 _sentBytes, _totalBytes;
+
+    void sendNextChunk();
+    void finish(bool isSuccess, const QString &response);
+};
+
+#endif // TABLEUPLOADER_H
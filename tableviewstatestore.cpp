@@ -0,0 +1,74 @@
+#include "tableviewstatestore.h"
+
+#include <QSettings>
+#include <QDir>
+
+
+void TableViewStateStore::insert(const QString &fileName, const TableViewState &state)
+{
+    QString k = key(fileName);
+    _fileNames.removeOne(k);
+    _fileNames.prepend(k);
+    _states.insert(k, state);
+    while (_fileNames.size() > _capacity)
+        _states.remove(_fileNames.takeLast());
+    _isModified = true;
+}
+
+void TableViewStateStore::read(QSettings &settings)
+{
+    _fileNames.clear();
+    _states.clear();
+
+    int size = settings.beginReadArray("tableViewStates");
+    for (int i = 0; i < size && i < _capacity; ++i)
+    {
+        settings.setArrayIndex(i);
+        QString k = settings.value("file").toString();
+        _fileNames += k;
+        _states.insert(k, TableViewState(settings.value("row").toInt(), settings.value("column", 1).toInt(), settings.value("scroll", -1).toInt()));
+    }
+    settings.endArray();
+
+    // rows of all files ever opened were stored by older versions, they're imported once
+    if (settings.contains("lastSelectedRowsHash"))
+    {
+        QHash<QString, QVariant> lastSelectedRows = settings.value("lastSelectedRowsHash").toHash();
+        for (QHash<QString, QVariant>::const_iterator it = lastSelectedRows.constBegin(); it != lastSelectedRows.constEnd() && _fileNames.size() < _capacity; ++it)
+        {
+            QString k = key(it.key());
+            if (!_states.contains(k))
+            {
+                _fileNames += k;
+                _states.insert(k, TableViewState(it.value().toInt(), 1, -1));
+            }
+        }
+        settings.remove("lastSelectedRowsHash");
+        _isModified = true;
+    }
+}
+
+void TableViewStateStore::write(QSettings &settings)
+{
+    if (!_isModified)
+        return;
+
+    settings.remove("tableViewStates");
+    settings.beginWriteArray("tableViewStates", _fileNames.size());
+    for (int i = 0; i < _fileNames.size(); ++i)
+    {
+        const TableViewState &state = _states[_fileNames.at(i)];
+        settings.setArrayIndex(i);
+        settings.setValue("file", _fileNames.at(i));
+        settings.setValue("row", state.Row);
+        settings.setValue("column", state.Column);
+        settings.setValue("scroll", state.ScrollValue);
+    }
+    settings.endArray();
+    _isModified = false;
+}
+
+QString TableViewStateStore::key(const QString &fileName)
+{
+    return QDir::toNativeSeparators(fileName);
+}
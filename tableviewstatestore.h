@@ -0,0 +1,41 @@
+#ifndef TABLEVIEWSTATESTORE_H
+#define TABLEVIEWSTATESTORE_H
+
+#include <QHash>
+#include <QStringList>
+
+
+class QSettings;
+
+struct TableViewState // where user was in a table when it was closed
+{
+    int Row, Column, ScrollValue;
+
+    TableViewState() : Row(0), Column(1), ScrollValue(-1) {} // -1 - scroll to the row
+    TableViewState(int row, int column, int scrollValue) : Row(row), Column(column), ScrollValue(scrollValue) {}
+};
+
+// view states of recently closed tables, the least recently used one is forgotten when there's no more room
+class TableViewStateStore
+{
+public:
+    static const int kDefaultCapacity = 100;
+
+    explicit TableViewStateStore(int capacity = kDefaultCapacity) : _capacity(capacity), _isModified(false) {}
+
+    TableViewState value(const QString &fileName) const { return _states.value(key(fileName)); }
+    void insert(const QString &fileName, const TableViewState &state);
+
+    void read(QSettings &settings);
+    void write(QSettings &settings); // writes only if something has changed since reading
+
+private:
+    QStringList _fileNames; // the most recently used first
+    QHash<QString, TableViewState> _states;
+    int _capacity;
+    bool _isModified;
+
+    static QString key(const QString &fileName);
+};
+
+#endif // TABLEVIEWSTATESTORE_H
@@ -1,8 +1,13 @@
 #include "tblstructure.h"
+#include "timing.h"
 
 #include <QStringList>
-#include <QTextCodec>
+#include <QVector>
 #include <QtAlgorithms>
+#include <QtEndian>
+#include <QTextCodec>
+
+#include <cstring>
 
 
 //global auxiliary functions
@@ -12,14 +17,80 @@ QDataStream &operator >>(QDataStream &in, TblHeader &th)
     return in >> th.CRC >> th.NodesNumber >> th.HashTableSize >> th.Version >> th.DataStartOffset >> th.HashMaxTries >> th.FileSize;
 }
 
-QDataStream &operator >>(QDataStream &in, TblHashNode &tn)
+// almost all keys and most values are ASCII, so they're checked 8 bytes (or 4 UTF-16 units) at a time and converted by Qt's Latin-1 routines
+static bool isAscii(const char *s, int size)
 {
-    return in >> tn.Active >> tn.Index >> tn.HashValue >> tn.StringKeyOffset >> tn.StringValOffset >> tn.StringValLength;
+    int i = 0;
+    for (quint64 word; i + 8 <= size; i += 8)
+    {
+        std::memcpy(&word, s + i, 8);
+        if (word & Q_UINT64_C(0x8080808080808080))
+            return false;
+    }
+    for (; i < size; i++)
+        if (s[i] & 0x80)
+            return false;
+    return true;
 }
 
-bool DataNodeLessThan(const DataNode &a, const DataNode &b) // predicate for sorting the string table
+static bool isAscii(const ushort *s, int size)
 {
-    return a.Index < b.Index;
+    int i = 0;
+    for (quint64 word; i + 4 <= size; i += 4)
+    {
+        std::memcpy(&word, s + i, 8);
+        if (word & Q_UINT64_C(0xFF80FF80FF80FF80))
+            return false;
+    }
+    for (; i < size; i++)
+        if (s[i] & 0xFF80)
+            return false;
+    return true;
+}
+
+// rejects overlong forms, surrogates and code points above U+10FFFF like the UTF-8 RFC
+static bool isValidUtf8(const uchar *s, int size)
+{
+    for (int i = 0; i < size;)
+    {
+        uchar c = s[i];
+        if (c < 0x80)
+        {
+            i++;
+            continue;
+        }
+
+        int length;
+        uchar min = 0x80, max = 0xBF; // allowed range of the second byte
+        if (c >= 0xC2 && c <= 0xDF)
+            length = 2;
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            length = 3;
+            if (c == 0xE0)
+                min = 0xA0;
+            else if (c == 0xED)
+                max = 0x9F;
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            length = 4;
+            if (c == 0xF0)
+                min = 0x90;
+            else if (c == 0xF4)
+                max = 0x8F;
+        }
+        else
+            return false;
+
+        if (i + length > size || s[i + 1] < min || s[i + 1] > max)
+            return false;
+        for (int j = 2; j < length; j++)
+            if ((s[i + j] & 0xC0) != 0x80)
+                return false;
+        i += length;
+    }
+    return true;
 }
 
 
@@ -42,52 +113,98 @@ extern QStringList colorStrings;
 extern QString colorHeader;
 extern int colorHeaderSize;
 
-void TblStructure::getStringTable(QDataStream &in)
+// replaces color codes with user-readable color strings
+static void transcodeColors(QString &val)
 {
-    in.skipRawData(_header.NodesNumber * sizeof(WORD)); // we don't need indices
+    if (val == colorHeader)
+        return;
 
-    QList<TblHashNode> hashNodes;
-    for (DWORD i = 0; i < _header.HashTableSize; i++)
+    int colorOccurNum = val.count(colorHeader);
+    for (int i = 0; i < colorOccurNum; i++)
     {
-        TblHashNode currentNode;
-        in >> currentNode;
-        hashNodes += currentNode;
+        int beginReplacePos = val.indexOf(colorHeader); // position of current colorHeader
+        int index = indexOfColor(val.at(beginReplacePos + colorHeaderSize)); // index in colorStrings array
+        val.replace(beginReplacePos, colorHeaderSize + 1, colorStrings.at(index)); // replacing with user-readable color string
     }
+}
 
-    QByteArray byteArray = in.device()->readAll();
-    const char *buf = byteArray.constData();
-    for (WORD i = 0; i < _header.HashTableSize; i++)
+void TblStructure::getStringTable(const char *data, DWORD size, KeyValuePairList *entries)
+{
+    // strings are decoded straight from the file bytes into entries, without lists of nodes or a copy of the string region,
+    // so at peak there's only the file and the final strings
+    const DWORD nodesOffset = _header.NodesNumber * sizeof(WORD); // we don't need indices
+    DWORD hashTableSize = nodesOffset <= size ? qMin<DWORD>(_header.HashTableSize, (size - nodesOffset) / TblHashNode::size) : 0;
+    const uchar *nodes = reinterpret_cast<const uchar *>(data) + nodesOffset;
+    DWORD dataOffset = qMin<DWORD>(_header.DataStartOffset - TblHeader::size, size);
+    const char *buf = data + dataOffset;
+    int bufSize = size - dataOffset;
+
+    QVector<QPair<DWORD, DWORD> > rows; // <string key offset, hash node index>, rows are ordered by key offset
     {
-        if (!hashNodes.at(i).Active) // current entry is not used, i.e. it's deleted
-            continue;
+        TimingSpan span("read tbl");
+        rows.reserve(hashTableSize);
+        for (DWORD i = 0; i < hashTableSize; i++)
+        {
+            const uchar *node = nodes + i * TblHashNode::size;
+            if (node[0]) // current entry is used, i.e. it's not deleted
+                rows += qMakePair(qFromLittleEndian<quint32>(node + 0x07), i);
+        }
+    }
+    {
+        TimingSpan span("sort entries");
+        qSort(rows.begin(), rows.end());
+        if (rows.size() > _header.NodesNumber)
+            rows.resize(_header.NodesNumber);
+    }
 
-        DWORD stringOffset = hashNodes.at(i).StringValOffset - _header.DataStartOffset;
+    TimingSpan span("decode strings");
+    // the whole string region is checked at once, tables of English text don't need UTF-8 decoding at all
+    bool isAllAscii = isAscii(buf, bufSize);
+    _invalidUtf8Rows.clear();
+    entries->reserve(entries->size() + rows.size());
+    for (int row = 0; row < rows.size(); row++)
+    {
+        const uchar *node = nodes + rows.at(row).second * TblHashNode::size;
+        DWORD stringValOffset = qFromLittleEndian<quint32>(node + 0x0B);
+        WORD stringValLength = qFromLittleEndian<quint16>(node + 0x0F);
+
+        // value ends at the first null like in the game and in the writer, even if the node length (which includes
+        // terminating null) is longer. Data is scanned up to its end only if there's no null within the node length
+        DWORD stringOffset = stringValOffset - _header.DataStartOffset;
+        int valLength = 0;
+        if (stringOffset < DWORD(bufSize))
+        {
+            const char *valStart = buf + stringOffset;
+            DWORD availableSize = bufSize - stringOffset;
+            const void *terminator = stringValLength ? memchr(valStart, 0, qMin<DWORD>(stringValLength, availableSize)) : 0;
+            valLength = terminator ? static_cast<const char *>(terminator) - valStart : qstrnlen(valStart, availableSize);
+        }
+
+        // there can be values without text at all, e.g. key Eskillname0 in string.txt
+        const char *valData = buf + stringOffset;
         QString val;
-        if (buf + stringOffset) // there can be values without text at all, e.g. key Eskillname0 in string.txt
-            val = QString::fromUtf8(buf + stringOffset);
-        if (val != colorHeader)
+        if (isAllAscii || isAscii(valData, valLength))
+            val = QString::fromLatin1(valData, valLength);
+        else
         {
-            int colorOccurNum = val.count(colorHeader);
-            for (int i = 0; i < colorOccurNum; i++)
-            {
-                int beginReplacePos = val.indexOf(colorHeader); // position of current colorHeader
-                int index = indexOfColor(val.at(beginReplacePos + colorHeaderSize)); // index in colorStrings array
-                val.replace(beginReplacePos, colorHeaderSize + 1, colorStrings.at(index)); // replacing with user-readable color string
-            }
+            if (!isValidUtf8(reinterpret_cast<const uchar *>(valData), valLength))
+                _invalidUtf8Rows += row;
+            val = QString::fromUtf8(valData, valLength);
         }
+        transcodeColors(val);
 
-        DWORD keyOffset = hashNodes.at(i).StringKeyOffset - _header.DataStartOffset;
-        _data += DataNode(keyOffset, TblStructure::decodeKey(buf + keyOffset), val);
+        DWORD keyOffset = rows.at(row).first - _header.DataStartOffset;
+        QByteArray key;
+        if (keyOffset < DWORD(bufSize))
+            key = QByteArray::fromRawData(buf + keyOffset, qstrnlen(buf + keyOffset, bufSize - keyOffset));
+        entries->append(KeyValuePair(TblStructure::decodeKey(key), val));
     }
-    qSort(_data.begin(), _data.end(), DataNodeLessThan);
-    for (WORD i = 0; i < _header.NodesNumber; i++)
-        _data[i].Index = i;
 }
 
-DWORD TblStructure::hashValue(char *key, int hashTableSize)
+DWORD TblStructure::rawHashValue(const char *key)
 {
     char currentChar;
-    char *ptKeyStringChar = key;
+    const char *ptKeyStringChar = key;
     DWORD hashValue = 0;
     while ((currentChar = *ptKeyStringChar++) != '\0')
     {
@@ -101,7 +218,7 @@ DWORD TblStructure::hashValue(char *key, int hashTableSize)
             hashValue ^= tempValue;
         }
     }
-    return hashValue % hashTableSize;
+    return hashValue;
 }
 
 WORD TblStructure::getCRC(const char *stringData, DWORD size)
@@ -135,14 +252,80 @@ WORD TblStructure::getCRC(const char *stringData, DWORD size)
 }
 
 
-const QTextCodec *TblStructure::keyCodec = QTextCodec::codecForName("Windows-1252");
+// Windows-1252 equals Latin-1 except 0x80-0x9F, undefined bytes are decoded to U+FFFD like Qt's own codec does
+static const ushort kCp1252Controls[32] =
+{
+    0x20AC, 0xFFFD, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0xFFFD, 0x017D, 0xFFFD,
+    0xFFFD, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0xFFFD, 0x017E, 0x0178
+};
 
 QByteArray TblStructure::encodeKey(const QString &key)
 {
-    return keyCodec->fromUnicode(key);
+    if (isAscii(key.utf16(), key.size()))
+        return key.toLatin1();
+
+    QByteArray bytes(key.size(), 0);
+    for (int i = 0; i < key.size(); i++)
+    {
+        ushort c = key.at(i).unicode();
+        char byte = '?'; // unmappable characters are replaced as QTextCodec does
+        if (c < 0x80 || (c >= 0xA0 && c <= 0xFF))
+            byte = char(c);
+        else if (c != 0xFFFD)
+        {
+            for (int j = 0; j < 32; j++)
+            {
+                if (kCp1252Controls[j] == c)
+                {
+                    byte = char(0x80 + j);
+                    break;
+                }
+            }
+        }
+        bytes[i] = byte;
+    }
+    return bytes;
 }
 
 QString TblStructure::decodeKey(const QByteArray &key)
 {
-    return keyCodec->toUnicode(key);
+    QString s = QString::fromLatin1(key.constData(), key.size());
+    if (isAscii(key.constData(), key.size()))
+        return s;
+
+    for (int i = 0; i < key.size(); i++)
+    {
+        uchar byte = key.at(i);
+        if (byte >= 0x80 && byte < 0xA0)
+            s[i] = QChar(kCp1252Controls[byte - 0x80]);
+    }
+    return s;
+}
+
+bool TblStructure::isKeyCodecCorrect()
+{
+    const QTextCodec *codec = QTextCodec::codecForName("Windows-1252");
+    if (!codec)
+        return true; // nothing to compare with
+
+    bool isCorrect = true;
+    for (int i = 0; i < 256; i++)
+    {
+        QByteArray byte(1, char(i));
+        if (decodeKey(byte) != codec->toUnicode(byte))
+        {
+            qWarning("key codec: byte 0x%02X is decoded differently from QTextCodec", i);
+            isCorrect = false;
+        }
+    }
+    for (int i = 0; i < 0x10000; i++)
+    {
+        QString c(QChar(ushort(i)));
+        if (encodeKey(c) != codec->fromUnicode(c))
+        {
+            qWarning("key codec: U+%04X is encoded differently from QTextCodec", i);
+            isCorrect = false;
+        }
+    }
+    return isCorrect;
 }
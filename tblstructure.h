@@ -51,41 +51,34 @@ struct TblHashNode // node of the hash table in string *.tbl file
 #pragma pack()
 
 
-struct DataNode // my node of the string table in string *.tbl file
-{
-    DWORD Index; // string key offset
-    QString Key; // current string key
-    QString Val; // current string value
-
-    DataNode() {}
-    DataNode(DWORD i, QString k, QString v) : Index(i), Key(k), Val(v) {}
-};
+typedef QPair<QString, QString> KeyValuePair; // <key, value>
+typedef QList<KeyValuePair> KeyValuePairList;
 
 
 QDataStream &operator >>(QDataStream &in, TblHeader &th);
 
-class QTextCodec;
-
 class TblStructure
 {
 public:
     const TblHeader &header() const { return _header; }
-    QPair<QString, QString> dataStrings(WORD i) const { return QPair<QString, QString>(_data.at(i).Key, _data.at(i).Val); }
 
     void fillHeader(QDataStream &in) { in >> _header; }
-    void getStringTable(QDataStream &in);
+    // data starts right after the header, entries are appended in the order of keys in the file
+    void getStringTable(const char *data, DWORD size, KeyValuePairList *entries);
+    const QList<int> &invalidUtf8Rows() const { return _invalidUtf8Rows; } // values decoded with replacement characters
 
-    static DWORD hashValue(char *key, int hashTableSize);
+    static DWORD hashValue(const char *key, int hashTableSize) { return rawHashValue(key) % hashTableSize; }
+    static DWORD rawHashValue(const char *key); // doesn't depend on table size, so it can be cached
     static WORD getCRC(const char *stringData, DWORD size);
 
+    // keys are in Windows-1252
     static QByteArray encodeKey(const QString &key);
     static QString decodeKey(const QByteArray &key);
+    static bool isKeyCodecCorrect(); // compares all bytes and UTF-16 units with QTextCodec, used by --check-key-codec
 
 private:
     TblHeader _header;
-    QList<DataNode> _data;
-
-    static const QTextCodec *keyCodec;
+    QList<int> _invalidUtf8Rows;
 };
 
 #endif // TBLSTRUCTURE_H
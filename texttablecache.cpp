@@ -0,0 +1,161 @@
+#include "texttablecache.h"
+#include "timing.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QCryptographicHash>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
+
+#include <cstring>
+
+
+#pragma pack(1)
+struct TextTableCacheHeader
+{
+    char    Magic[4];         // +0x00 - "QTBC"
+    quint16 Version;          // +0x04
+    quint16 ByteOrderMark;    // +0x06 - strings are stored in native byte order
+    qint64  SourceSize;       // +0x08
+    qint64  SourceModified;   // +0x10 - ms since epoch
+    char    SourceMd5[16];    // +0x18
+    quint32 EntriesNumber;    // +0x28
+    // entries follow: quint32 key length, quint32 value length (in UTF-16 units), key, value
+
+    static const int size = 0x2C;
+};
+#pragma pack()
+
+static const char kCacheMagic[4] = {'Q', 'T', 'B', 'C'};
+static const quint16 kCacheVersion = 1, kByteOrderMark = 0xFEFF;
+
+bool TextTableCache::_isEnabled = false;
+
+
+static QByteArray sourceMd5(QFile *source)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    if (uchar *data = source->map(0, source->size()))
+    {
+        hash.addData(reinterpret_cast<const char *>(data), source->size());
+        source->unmap(data);
+    }
+    else
+        hash.addData(source->readAll());
+    return hash.result();
+}
+
+bool TextTableCache::read(const QString &fileName, KeyValuePairList *entries)
+{
+    if (!_isEnabled)
+        return false;
+
+    TimingSpan span("read text cache");
+    QFile cache(cacheFileName(fileName));
+    if (!cache.open(QIODevice::ReadOnly) || cache.size() < TextTableCacheHeader::size)
+        return false;
+
+    QByteArray cacheBytes;
+    const char *data = reinterpret_cast<const char *>(cache.map(0, cache.size()));
+    if (!data)
+    {
+        cacheBytes = cache.readAll();
+        data = cacheBytes.constData();
+    }
+    const char *end = data + cache.size();
+
+    // cheap checks go first, the source is hashed only if they pass
+    TextTableCacheHeader header;
+    std::memcpy(&header, data, TextTableCacheHeader::size);
+    QFileInfo sourceInfo(fileName);
+    if (std::memcmp(header.Magic, kCacheMagic, 4) || header.Version != kCacheVersion || header.ByteOrderMark != kByteOrderMark ||
+        header.SourceSize != sourceInfo.size() || header.SourceModified != sourceInfo.lastModified().toMSecsSinceEpoch())
+        return false;
+
+    QFile source(fileName);
+    if (!source.open(QIODevice::ReadOnly) || sourceMd5(&source) != QByteArray(header.SourceMd5, 16))
+        return false;
+
+    KeyValuePairList result;
+    result.reserve(header.EntriesNumber);
+    const char *p = data + TextTableCacheHeader::size;
+    for (quint32 i = 0; i < header.EntriesNumber; ++i)
+    {
+        quint32 lengths[2];
+        if (end - p < qint64(sizeof(lengths)))
+            return false;
+        std::memcpy(lengths, p, sizeof(lengths));
+        p += sizeof(lengths);
+        if (quint64(end - p) < (quint64(lengths[0]) + lengths[1]) * sizeof(QChar))
+            return false;
+
+        QString key(reinterpret_cast<const QChar *>(p), lengths[0]);
+        p += lengths[0] * sizeof(QChar);
+        QString val(reinterpret_cast<const QChar *>(p), lengths[1]);
+        p += lengths[1] * sizeof(QChar);
+        result += KeyValuePair(key, val);
+    }
+
+    *entries = result;
+    return true;
+}
+
+void TextTableCache::write(const QString &fileName, const KeyValuePairList &entries)
+{
+    if (!_isEnabled)
+        return;
+
+    TimingSpan span("write text cache");
+    QFile source(fileName);
+    if (!source.open(QIODevice::ReadOnly))
+        return;
+
+    QFileInfo sourceInfo(fileName);
+    TextTableCacheHeader header;
+    std::memcpy(header.Magic, kCacheMagic, 4);
+    header.Version = kCacheVersion;
+    header.ByteOrderMark = kByteOrderMark;
+    header.SourceSize = sourceInfo.size();
+    header.SourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+    std::memcpy(header.SourceMd5, sourceMd5(&source).constData(), 16);
+    header.EntriesNumber = entries.size();
+
+    QByteArray bytes(reinterpret_cast<const char *>(&header), TextTableCacheHeader::size);
+    foreach (const KeyValuePair &entry, entries)
+    {
+        quint32 lengths[2] = {quint32(entry.first.size()), quint32(entry.second.size())};
+        bytes.append(reinterpret_cast<const char *>(lengths), sizeof(lengths));
+        bytes.append(reinterpret_cast<const char *>(entry.first.constData()), entry.first.size() * sizeof(QChar));
+        bytes.append(reinterpret_cast<const char *>(entry.second.constData()), entry.second.size() * sizeof(QChar));
+    }
+
+    // written under a temporary name, so a reader in another thread never sees a half-written cache
+    QString cachePath = cacheFileName(fileName), temporaryPath = cachePath + ".tmp";
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+    QFile cache(temporaryPath);
+    if (cache.open(QIODevice::WriteOnly) && cache.write(bytes) == bytes.size())
+    {
+        cache.close();
+        QFile::remove(cachePath);
+        QFile::rename(temporaryPath, cachePath);
+    }
+    else
+        QFile::remove(temporaryPath);
+}
+
+QString TextTableCache::cacheFileName(const QString &fileName)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    QString cachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    QString cachePath = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+    QByteArray pathHash = QCryptographicHash::hash(QDir::cleanPath(QFileInfo(fileName).absoluteFilePath()).toUtf8(), QCryptographicHash::Md5);
+    return cachePath + "/tables/" + pathHash.toHex() + ".qtbc";
+}
@@ -0,0 +1,25 @@
+#ifndef TEXTTABLECACHE_H
+#define TEXTTABLECACHE_H
+
+#include "tblstructure.h"
+
+
+// parsed *.txt and *.csv tables are stored in the cache directory as arrays of UTF-16 strings with their lengths,
+// so reading an unchanged table doesn't parse anything. The cache is valid while source's size, time and MD5 are the same.
+// all functions can be called from worker threads
+class TextTableCache
+{
+public:
+    static bool isEnabled() { return _isEnabled; }
+    static void setEnabled(bool isEnabled) { _isEnabled = isEnabled; }
+
+    static bool read(const QString &fileName, KeyValuePairList *entries);
+    static void write(const QString &fileName, const KeyValuePairList &entries);
+
+private:
+    static bool _isEnabled;
+
+    static QString cacheFileName(const QString &fileName);
+};
+
+#endif // TEXTTABLECACHE_H
@@ -0,0 +1,109 @@
+#include "timing.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+
+
+bool Timing::_isEnabled = false;
+int Timing::_mainThreadDepth = 0;
+
+static QElapsedTimer elapsedTimer;
+static QMutex spansMutex; // parsing of files is measured in worker threads too
+static QList<Timing::Span> spans;
+static int operationFirstSpan = 0; // first span of the current outermost span
+
+static const int kMaxSpans = 1000000; // about 24 MB, recording stops after that
+
+
+Timing *Timing::instance()
+{
+    static Timing *timing = new Timing;
+    return timing;
+}
+
+void Timing::setEnabled(bool isEnabled)
+{
+    if (isEnabled && !elapsedTimer.isValid())
+        elapsedTimer.start();
+    _isEnabled = isEnabled;
+}
+
+qint64 Timing::now()
+{
+    return elapsedTimer.nsecsElapsed() / 1000;
+}
+
+bool Timing::isMainThread()
+{
+    return QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread();
+}
+
+void Timing::addSpan(const char *name, qint64 start, bool isOutermost)
+{
+    Span span = {name, start, now() - start, reinterpret_cast<quintptr>(QThread::currentThreadId())};
+    QString summary;
+    {
+        QMutexLocker locker(&spansMutex);
+        if (spans.size() < kMaxSpans)
+            spans += span;
+        if (!isMainThread())
+            return;
+
+        _mainThreadDepth--;
+        if (!isOutermost)
+            return;
+
+        // nested spans end before the outermost one, so they're already recorded
+        summary = QString("%1 %2 ms").arg(name).arg(span.Duration / 1000.0, 0, 'f', 1);
+        QStringList phases;
+        for (int i = operationFirstSpan; i < spans.size() - 1; ++i)
+            phases += QString("%1 %2").arg(spans.at(i).Name).arg(spans.at(i).Duration / 1000.0, 0, 'f', 1);
+        if (!phases.isEmpty())
+            summary += ": " + phases.join(", ");
+        operationFirstSpan = spans.size();
+    }
+    emit instance()->operationTimed(summary);
+}
+
+void Timing::addCompletedSpan(const char *name, qint64 duration)
+{
+    if (!_isEnabled)
+        return;
+
+    Span span = {name, qMax(Q_INT64_C(0), now() - duration), duration, reinterpret_cast<quintptr>(QThread::currentThreadId())};
+    QMutexLocker locker(&spansMutex);
+    if (spans.size() < kMaxSpans)
+        spans += span;
+}
+
+void Timing::clear()
+{
+    QMutexLocker locker(&spansMutex);
+    spans.clear();
+    operationFirstSpan = 0;
+}
+
+bool Timing::writeChromeTrace(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QMutexLocker locker(&spansMutex);
+    QTextStream out(&file);
+    out << "{\"traceEvents\":[\n";
+    for (int i = 0; i < spans.size(); ++i)
+    {
+        const Span &span = spans.at(i);
+        out << QString("{\"name\":\"%1\",\"cat\":\"QTblEditor\",\"ph\":\"X\",\"ts\":%2,\"dur\":%3,\"pid\":1,\"tid\":%4}")
+               .arg(QString::fromLatin1(span.Name)).arg(span.Start).arg(span.Duration).arg(qulonglong(span.ThreadId));
+        out << (i + 1 < spans.size() ? ",\n" : "\n");
+    }
+    out << "],\"displayTimeUnit\":\"ms\"}\n";
+    return out.status() == QTextStream::Ok;
+}
@@ -0,0 +1,73 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <QObject>
+#include <QList>
+
+
+// phases of long operations are measured with TimingSpan objects on the stack:
+//     TimingSpan span("parse");
+// when timing is disabled, a span costs one check of a boolean
+class Timing : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Span
+    {
+        const char *Name; // must be a literal
+        qint64 Start, Duration; // microseconds since timing was enabled
+        quintptr ThreadId;
+    };
+
+    static Timing *instance();
+
+    static bool isEnabled() { return _isEnabled; }
+    static void setEnabled(bool isEnabled);
+
+    static qint64 now();
+    static void addSpan(const char *name, qint64 start, bool isOutermost);
+    static void addCompletedSpan(const char *name, qint64 duration); // for spans that began before they could be measured
+    static bool isMainThread();
+
+    static void clear();
+    static bool writeChromeTrace(const QString &fileName); // format of chrome://tracing and Perfetto
+
+signals:
+    void operationTimed(const QString &summary); // emitted in the main thread after each outermost span, e.g. "load 120 ms: parse 80, populate 30"
+
+private:
+    static bool _isEnabled;
+    static int _mainThreadDepth;
+
+    Timing() {}
+
+    friend class TimingSpan;
+};
+
+class TimingSpan
+{
+public:
+    explicit TimingSpan(const char *name) : _name(Timing::isEnabled() ? name : 0)
+    {
+        if (_name)
+        {
+            _isOutermost = Timing::isMainThread() && !Timing::_mainThreadDepth++;
+            _start = Timing::now();
+        }
+    }
+    ~TimingSpan()
+    {
+        if (_name)
+            Timing::addSpan(_name, _start, _isOutermost);
+    }
+
+private:
+    const char *_name;
+    qint64 _start;
+    bool _isOutermost;
+
+    Q_DISABLE_COPY(TimingSpan)
+};
+
+#endif // TIMING_H